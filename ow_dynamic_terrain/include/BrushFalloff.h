@@ -0,0 +1,89 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#ifndef BRUSH_FALLOFF_H
+#define BRUSH_FALLOFF_H
+
+#include <cmath>
+#include "SIMD_Util.h"
+
+// Falloff policies used by TerrainBrush. A policy maps the normalized distance t between the inner boundary (t = 0)
+// and the outer boundary (t = 1) of a brush to a weight in [0, 1]. evaluate is a template so that the same policy is
+// used for scalar and vectorized evaluation.
+// requires_distance is false for policies that only need to know whether a pixel lies within the outer boundary,
+// which lets the brush shapes skip square roots altogether.
+
+namespace ow_dynamic_terrain
+{
+namespace falloff
+{
+struct Quadratic
+{
+  static constexpr bool requires_distance = true;
+
+  template <typename T>
+  static T evaluate(const T& t)
+  {
+    return T(1.0f) - t * t;
+  }
+};
+
+struct Linear
+{
+  static constexpr bool requires_distance = true;
+
+  template <typename T>
+  static T evaluate(const T& t)
+  {
+    return T(1.0f) - t;
+  }
+};
+
+// raised cosine: 0.5 * (1 + cos(pi * t))
+struct Cosine
+{
+  static constexpr bool requires_distance = true;
+
+  template <typename T>
+  static T evaluate(const T& t)
+  {
+    return simd::map(t, [](float x) {
+      constexpr auto pi = 3.14159265358979f;
+      return 0.5f * (1.0f + std::cos(pi * x));
+    });
+  }
+};
+
+// gaussian with the outer boundary placed at three standard deviations, rescaled such that the weight reaches zero
+// at the outer boundary
+struct Gaussian
+{
+  static constexpr bool requires_distance = true;
+
+  template <typename T>
+  static T evaluate(const T& t)
+  {
+    return simd::map(t, [](float x) {
+      constexpr auto k = 4.5f;  // 1 / (2 * sigma^2) with sigma = 1/3
+      const auto tail = std::exp(-k);
+      return (std::exp(-k * x * x) - tail) / (1.0f - tail);
+    });
+  }
+};
+
+// full weight everywhere within the outer boundary
+struct HardEdge
+{
+  static constexpr bool requires_distance = false;
+
+  template <typename T>
+  static T evaluate(const T& t)
+  {
+    return simd::select(simd::lessThan(t, T(1.0f)), T(1.0f), T(0.0f));
+  }
+};
+}  // namespace falloff
+}  // namespace ow_dynamic_terrain
+
+#endif  // BRUSH_FALLOFF_H
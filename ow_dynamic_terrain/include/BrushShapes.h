@@ -0,0 +1,151 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#ifndef BRUSH_SHAPES_H
+#define BRUSH_SHAPES_H
+
+#include <cmath>
+#include "SIMD_Util.h"
+
+// Brush shapes used by TerrainBrush. A shape defines the size of the brush image, its center and the normalized
+// falloff parameter t of a pixel: 0 within the inner boundary, 1 at or beyond the outer boundary and the relative
+// position between the two boundaries elsewhere. parameter is evaluated for a horizontal run of pixels at once (dx
+// is either a float or a simd::float4) such that rows of the brush can be generated with vector instructions.
+
+namespace ow_dynamic_terrain
+{
+class CircleShape
+{
+public:
+  CircleShape(float outer_radius, float inner_radius)
+    : m_i_outer_radius{ static_cast<int>(std::ceil(outer_radius)) }
+    , m_outer_radius_sq{ outer_radius * outer_radius }
+    , m_inner_radius{ inner_radius }
+    , m_inv_band{ outer_radius > inner_radius ? 1.0f / (outer_radius - inner_radius) : 0.0f }
+  {
+  }
+
+  int rows() const
+  {
+    return 2 * m_i_outer_radius;
+  }
+
+  int cols() const
+  {
+    return 2 * m_i_outer_radius;
+  }
+
+  int centerX() const
+  {
+    return m_i_outer_radius;
+  }
+
+  int centerY() const
+  {
+    return m_i_outer_radius;
+  }
+
+  template <typename Falloff, typename T>
+  T parameter(const T& dx, float dy) const
+  {
+    auto dist_sq = dx * dx + T(dy * dy);
+
+    // only the outer boundary matters, compare squared distances
+    if (!Falloff::requires_distance || m_inv_band == 0.0f)
+      return simd::select(simd::lessThan(dist_sq, T(m_outer_radius_sq)), T(0.0f), T(1.0f));
+
+    auto t = (simd::sqrt(dist_sq) - T(m_inner_radius)) * T(m_inv_band);
+    return simd::clamp(t, T(0.0f), T(1.0f));
+  }
+
+private:
+  int m_i_outer_radius;
+  float m_outer_radius_sq;
+  float m_inner_radius;
+  float m_inv_band;  // reciprocal of the distance between the inner and outer radii
+};
+
+// The falloff parameter of an ellipse is measured along the ray from the center through the pixel. With rho_in and
+// rho_out being the elliptic radii of a pixel relative to the inner and outer ellipses (rho = 1 on the ellipse), the
+// parameter is t = (1 - 1/rho_in) / (1/rho_out - 1/rho_in). Elliptic radii are kept scaled by a^2 * b^2 to test for
+// the boundaries without square roots. An inner ellipse with a zero radius is taken to be its center point, from
+// which t = rho_out.
+class EllipseShape
+{
+public:
+  EllipseShape(float outer_radius_a, float inner_radius_a, float outer_radius_b, float inner_radius_b)
+    : m_i_outer_radius_a{ static_cast<int>(std::ceil(outer_radius_a)) }
+    , m_i_outer_radius_b{ static_cast<int>(std::ceil(outer_radius_b)) }
+    , m_outer_a_sq{ outer_radius_a * outer_radius_a }
+    , m_outer_b_sq{ outer_radius_b * outer_radius_b }
+    , m_outer_ab{ outer_radius_a * outer_radius_b }
+    , m_inner_a_sq{ inner_radius_a * inner_radius_a }
+    , m_inner_b_sq{ inner_radius_b * inner_radius_b }
+    , m_inner_ab{ inner_radius_a * inner_radius_b }
+  {
+  }
+
+  int rows() const
+  {
+    return 2 * m_i_outer_radius_b;
+  }
+
+  int cols() const
+  {
+    return 2 * m_i_outer_radius_a;
+  }
+
+  int centerX() const
+  {
+    return m_i_outer_radius_a;
+  }
+
+  int centerY() const
+  {
+    return m_i_outer_radius_b;
+  }
+
+  template <typename Falloff, typename T>
+  T parameter(const T& dx, float dy) const
+  {
+    auto dx_sq = dx * dx;
+    auto dy_sq = dy * dy;
+
+    auto outer_q = T(m_outer_b_sq) * dx_sq + T(m_outer_a_sq * dy_sq);
+    auto within_outer = simd::lessThan(outer_q, T(m_outer_ab * m_outer_ab));
+
+    if (!Falloff::requires_distance)
+      return simd::select(within_outer, T(0.0f), T(1.0f));
+
+    if (m_inner_ab <= 0.0f)
+    {
+      auto rho_outer = simd::sqrt(outer_q) / T(m_outer_ab);
+      return simd::select(within_outer, simd::clamp(rho_outer, T(0.0f), T(1.0f)), T(1.0f));
+    }
+
+    auto inner_q = T(m_inner_b_sq) * dx_sq + T(m_inner_a_sq * dy_sq);
+    auto within_inner = simd::lessEqual(inner_q, T(m_inner_ab * m_inner_ab));
+
+    // lanes on the center or on degenerate rings produce NaNs here, they are masked out below
+    auto inv_rho_inner = T(m_inner_ab) / simd::sqrt(inner_q);
+    auto inv_rho_outer = T(m_outer_ab) / simd::sqrt(outer_q);
+    auto t = (T(1.0f) - inv_rho_inner) / (inv_rho_outer - inv_rho_inner);
+    t = simd::clamp(t, T(0.0f), T(1.0f));
+    t = simd::select(within_outer, t, T(1.0f));
+    return simd::select(within_inner, T(0.0f), t);
+  }
+
+private:
+  int m_i_outer_radius_a;
+  int m_i_outer_radius_b;
+  float m_outer_a_sq;
+  float m_outer_b_sq;
+  float m_outer_ab;
+  float m_inner_a_sq;
+  float m_inner_b_sq;
+  float m_inner_ab;
+};
+}  // namespace ow_dynamic_terrain
+
+#endif  // BRUSH_SHAPES_H
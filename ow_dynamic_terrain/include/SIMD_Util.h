@@ -0,0 +1,198 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#ifndef SIMD_UTIL_H
+#define SIMD_UTIL_H
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define OW_DYNAMIC_TERRAIN_USE_SSE2
+#endif
+
+// A minimal four lane float type used by the terrain kernels. Kernels are written once as templates over the value
+// type and instantiated for both float (scalar tails) and float4 (SSE2 when available, a plain array otherwise).
+
+namespace ow_dynamic_terrain
+{
+namespace simd
+{
+struct float4
+{
+#ifdef OW_DYNAMIC_TERRAIN_USE_SSE2
+  __m128 v;
+
+  float4() = default;
+  float4(__m128 value) : v(value)
+  {
+  }
+  float4(float value) : v(_mm_set1_ps(value))
+  {
+  }
+
+  static float4 load(const float* p)
+  {
+    return _mm_loadu_ps(p);
+  }
+
+  void store(float* p) const
+  {
+    _mm_storeu_ps(p, v);
+  }
+
+  // returns { start, start + 1, start + 2, start + 3 }
+  static float4 ramp(float start)
+  {
+    return _mm_add_ps(_mm_set1_ps(start), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+  }
+#else
+  float v[4];
+
+  float4() = default;
+  float4(float value) : v{ value, value, value, value }
+  {
+  }
+
+  static float4 load(const float* p)
+  {
+    float4 r;
+    std::copy(p, p + 4, r.v);
+    return r;
+  }
+
+  void store(float* p) const
+  {
+    std::copy(v, v + 4, p);
+  }
+
+  static float4 ramp(float start)
+  {
+    float4 r;
+    for (auto i = 0; i < 4; ++i)
+      r.v[i] = start + i;
+    return r;
+  }
+#endif
+};
+
+#ifdef OW_DYNAMIC_TERRAIN_USE_SSE2
+
+// comparisons return a lane mask to be consumed by select
+inline float4 operator+(const float4& a, const float4& b) { return _mm_add_ps(a.v, b.v); }
+inline float4 operator-(const float4& a, const float4& b) { return _mm_sub_ps(a.v, b.v); }
+inline float4 operator*(const float4& a, const float4& b) { return _mm_mul_ps(a.v, b.v); }
+inline float4 operator/(const float4& a, const float4& b) { return _mm_div_ps(a.v, b.v); }
+inline float4 min(const float4& a, const float4& b) { return _mm_min_ps(a.v, b.v); }
+inline float4 max(const float4& a, const float4& b) { return _mm_max_ps(a.v, b.v); }
+inline float4 sqrt(const float4& a) { return _mm_sqrt_ps(a.v); }
+inline float4 lessThan(const float4& a, const float4& b) { return _mm_cmplt_ps(a.v, b.v); }
+inline float4 lessEqual(const float4& a, const float4& b) { return _mm_cmple_ps(a.v, b.v); }
+inline float4 select(const float4& mask, const float4& a, const float4& b)
+{
+  return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+}
+
+#else
+
+template <typename F>
+inline float4 lanewise(const float4& a, const float4& b, F f)
+{
+  float4 r;
+  for (auto i = 0; i < 4; ++i)
+    r.v[i] = f(a.v[i], b.v[i]);
+  return r;
+}
+
+inline float4 operator+(const float4& a, const float4& b)
+{
+  return lanewise(a, b, [](float x, float y) { return x + y; });
+}
+
+inline float4 operator-(const float4& a, const float4& b)
+{
+  return lanewise(a, b, [](float x, float y) { return x - y; });
+}
+
+inline float4 operator*(const float4& a, const float4& b)
+{
+  return lanewise(a, b, [](float x, float y) { return x * y; });
+}
+
+inline float4 operator/(const float4& a, const float4& b)
+{
+  return lanewise(a, b, [](float x, float y) { return x / y; });
+}
+
+inline float4 min(const float4& a, const float4& b)
+{
+  return lanewise(a, b, [](float x, float y) { return y < x ? y : x; });
+}
+
+inline float4 max(const float4& a, const float4& b)
+{
+  return lanewise(a, b, [](float x, float y) { return x < y ? y : x; });
+}
+
+inline float4 sqrt(const float4& a)
+{
+  return lanewise(a, a, [](float x, float) { return std::sqrt(x); });
+}
+
+// masks hold 1.0f for true lanes and 0.0f for false lanes
+inline float4 lessThan(const float4& a, const float4& b)
+{
+  return lanewise(a, b, [](float x, float y) { return x < y ? 1.0f : 0.0f; });
+}
+
+inline float4 lessEqual(const float4& a, const float4& b)
+{
+  return lanewise(a, b, [](float x, float y) { return x <= y ? 1.0f : 0.0f; });
+}
+
+inline float4 select(const float4& mask, const float4& a, const float4& b)
+{
+  float4 r;
+  for (auto i = 0; i < 4; ++i)
+    r.v[i] = mask.v[i] != 0.0f ? a.v[i] : b.v[i];
+  return r;
+}
+
+#endif
+
+// applies a scalar function to each lane, used for operations with no vector instruction (e.g. cos, exp)
+template <typename F>
+inline float4 map(const float4& a, F f)
+{
+  float lanes[4];
+  a.store(lanes);
+  for (auto& lane : lanes)
+    lane = f(lane);
+  return float4::load(lanes);
+}
+
+// scalar counterparts that allow kernels to be instantiated with float
+inline float min(float a, float b) { return std::min(a, b); }
+inline float max(float a, float b) { return std::max(a, b); }
+inline float sqrt(float a) { return std::sqrt(a); }
+inline bool lessThan(float a, float b) { return a < b; }
+inline bool lessEqual(float a, float b) { return a <= b; }
+inline float select(bool mask, float a, float b) { return mask ? a : b; }
+
+template <typename F>
+inline float map(float a, F f)
+{
+  return f(a);
+}
+
+template <typename T>
+inline T clamp(const T& value, const T& lower, const T& upper)
+{
+  return min(max(value, lower), upper);
+}
+}  // namespace simd
+}  // namespace ow_dynamic_terrain
+
+#endif  // SIMD_UTIL_H
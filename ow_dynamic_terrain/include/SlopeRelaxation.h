@@ -0,0 +1,95 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#ifndef SLOPE_RELAXATION_H
+#define SLOPE_RELAXATION_H
+
+#include <functional>
+#include <vector>
+
+namespace ow_dynamic_terrain
+{
+// An incremental angle of repose solver. Regions of the heightmap that were recently modified are activated, and each
+// call to update relaxes the active regions by moving material from cells whose slope to a neighboring cell exceeds
+// the angle of repose towards that neighbor (a cellular avalanching scheme that conserves volume). Work is bounded by
+// a maximum number of cell updates per call; regions that have not settled yet carry over to the next call, and grow
+// when material reaches their border, up to a fixed margin around the modified region such that steep terrain that
+// was never modified doesn't slump indefinitely. Regions that have settled are retired.
+class SlopeRelaxation
+{
+public:
+  // fraction of the excess height difference moved across an edge per iteration; with four neighbors a cell never
+  // gives away more than half of its excess which keeps the scheme from oscillating.
+  static constexpr float RELAXATION_RATE = 0.125f;
+  // regions are retired once the largest slope excess drops below this fraction of the allowed height difference
+  static constexpr float TOLERANCE = 0.01f;
+
+  // a rectangular range of cells in heightmap image coordinates
+  struct Region
+  {
+    int x, y, width, height;
+  };
+
+  // the change in height (row-major, width * height values) applied to a region by a call to update
+  struct RegionDiff
+  {
+    Region region;
+    std::vector<float> diff;
+    std::vector<float> heights;  // heights of the region after the update
+  };
+
+  // param angle_of_repose: maximum stable slope of the terrain in degrees
+  // param max_cells_per_update: upper bound on the number of cell updates performed by a call to update
+  // param max_spread: the number of cells an active region may grow by beyond each side of the activated region
+  // param max_region_size: the largest width or height an active region may grow to
+  SlopeRelaxation(float angle_of_repose, int max_cells_per_update, int max_spread = 32, int max_region_size = 256);
+
+  // marks a region that was modified as needing relaxation
+  void activate(const Region& region);
+
+  bool isActive() const
+  {
+    return !m_regions.empty();
+  }
+
+  // Relaxes the active regions within the per call budget.
+  // param heightmap_size: number of cells along each side of the heightmap
+  // param cell_size: horizontal distance between two adjacent cells in world units
+  // param get_height_value: a lambda function to retrive the height value from the heightmap
+  // param set_height_value: a lambda function to set back the height value on the heightmap.
+  // param out_diffs: receives the changes applied to each relaxed region
+  // return: true if there was a change made to the heightmap, false otherwise
+  bool update(int heightmap_size, float cell_size, const std::function<float(int, int)>& get_height_value,
+              const std::function<void(int, int, float)>& set_height_value, std::vector<RegionDiff>& out_diffs);
+
+  // Performs one relaxation iteration over a row-major window of heights. Exposed for testing.
+  // param delta: scratch buffer of the same size as heights, holds the change applied by this iteration on return
+  // return: the largest amount by which a height difference between neighbors exceeded max_height_difference
+  static float relaxIteration(std::vector<float>& heights, int width, int height, float max_height_difference,
+                              std::vector<float>& delta);
+
+private:
+  struct ActiveRegion
+  {
+    Region region;
+    Region bounds;  // the region may not grow past these bounds
+  };
+
+  // adds a region to the active set, merging it with any active region it overlaps or touches
+  void insert(const ActiveRegion& active_region);
+
+  float m_tan_angle_of_repose;
+  int m_max_cells_per_update;
+  int m_max_spread;
+  int m_max_region_size;
+  std::vector<ActiveRegion> m_regions;
+
+  // scratch buffers reused across calls
+  std::vector<float> m_heights;
+  std::vector<float> m_original;
+  std::vector<float> m_delta;
+};
+}  // namespace ow_dynamic_terrain
+
+#endif  // SLOPE_RELAXATION_H
@@ -5,7 +5,12 @@
 #ifndef TERRAIN_BRUSH_H
 #define TERRAIN_BRUSH_H
 
+#include <optional>
+#include <string>
+#include <unordered_map>
 #include <opencv2/opencv.hpp>
+#include "BrushFalloff.h"
+#include "BrushShapes.h"
 
 // TODO (optimization): provide an option to restrict computations to a rectangular window.
 
@@ -15,19 +20,66 @@ class TerrainBrush
 {
 public:
   // returns an opencv matrix with CV_32FC1 type
-  static cv::Mat circle(float outer_radius, float inner_radius, float weight);
+  template <typename Falloff = falloff::Quadratic>
+  static cv::Mat circle(float outer_radius, float inner_radius, float weight)
+  {
+    return generate<Falloff>(CircleShape(outer_radius, inner_radius), weight);
+  }
 
   // returns an opencv matrix with CV_32FC1 type
+  template <typename Falloff = falloff::Quadratic>
   static cv::Mat ellipse(float outer_radius_a, float inner_radius_a, float outer_radius_b, float inner_radius_b,
-                         float weight);
-  
+                         float weight)
+  {
+    return generate<Falloff>(EllipseShape(outer_radius_a, inner_radius_a, outer_radius_b, inner_radius_b), weight);
+  }
+
+  // Generates a brush of the given shape (see BrushShapes.h) weighted by the given falloff policy (see
+  // BrushFalloff.h). Rows are evaluated four pixels at a time with a scalar tail.
+  // returns an opencv matrix with CV_32FC1 type
+  template <typename Falloff, typename Shape>
+  static cv::Mat generate(const Shape& shape, float weight)
+  {
+    auto result = cv::Mat(shape.rows(), shape.cols(), CV_32FC1);
+    const auto weight4 = simd::float4(weight);
+
+    for (auto row = 0; row < result.rows; ++row)
+    {
+      auto dy = static_cast<float>(row - shape.centerY());
+      auto pixels = result.ptr<float>(row);
+
+      auto col = 0;
+      for (; col + 4 <= result.cols; col += 4)
+      {
+        auto dx = simd::float4::ramp(static_cast<float>(col - shape.centerX()));
+        auto t = shape.template parameter<Falloff>(dx, dy);
+        (weight4 * Falloff::evaluate(t)).store(pixels + col);
+      }
+
+      for (; col < result.cols; ++col)
+      {
+        auto dx = static_cast<float>(col - shape.centerX());
+        auto t = shape.template parameter<Falloff>(dx, dy);
+        pixels[col] = weight * Falloff::evaluate(t);
+      }
+    }
+
+    return result;
+  }
+
+  // Brush generators of a given falloff policy, used to select the falloff by name at run time
+  struct FalloffMethod
+  {
+    cv::Mat (*circle)(float outer_radius, float inner_radius, float weight);
+    cv::Mat (*ellipse)(float outer_radius_a, float inner_radius_a, float outer_radius_b, float inner_radius_b,
+                       float weight);
+  };
+
+  // available choices: quadratic, linear, cosine, gaussian and hard
+  static std::optional<FalloffMethod> falloffMethodFromString(const std::string& falloff_name);
+
 private:
-  // solves for x the intersection of a ellipse and a line (where the line passes through the ellipse center)
-  // for y value simply multiply by m
-  // param a: radius a of the ellipse
-  // param b: radius b of the ellipse
-  // param m: line slope
-  static float intersectEllipseLineX(float a, float b, float m);
+  static const std::unordered_map<std::string, FalloffMethod> m_falloff_method_map;
 };
 }  // namespace ow_dynamic_terrain
 
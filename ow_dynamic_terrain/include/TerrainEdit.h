@@ -0,0 +1,41 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#ifndef TERRAIN_EDIT_H
+#define TERRAIN_EDIT_H
+
+#include <mutex>
+#include <string>
+#include <geometry_msgs/Point32.h>
+#include <opencv2/core/mat.hpp>
+#include "MergeMethods.h"
+#include "ow_dynamic_terrain/modified_terrain_diff.h"
+
+namespace ow_dynamic_terrain
+{
+// A modify terrain operation resolved against a heightmap. An edit is prepared once per message and can then be
+// applied to each aspect of the terrain (visual and collision) without rebuilding the brush.
+struct TerrainEdit
+{
+  std::string op_name;                      // name of the operation used in logs (circle, ellipse or patch)
+  geometry_msgs::Point32 position;          // position of the operation in world coordinates
+  float h_scale = 1.0f;                     // horizontal scale factor (heightmap samples per world unit)
+  cv::Point2i center;                       // center of the operation in heightmap image coordinates
+  cv::Mat image;                            // heights (CV_32FC1) generated by the brush or supplied by the patch
+  MergeMethods::MergeMethod merge_method;   // merges image values with current height values
+
+  // Result of the first application of this edit. A later application to a terrain aspect that starts from the same
+  // heights can write new_heights directly instead of merging again.
+  bool merged = false;
+  bool changed = false;
+  cv::Mat old_heights;                      // heights sampled before the merge, same size as image
+  cv::Mat new_heights;                      // heights written by the merge, same size as image
+  modified_terrain_diff diff_msg;
+
+  // serializes applications of the edit by different plugins
+  std::mutex mutex;
+};
+}  // namespace ow_dynamic_terrain
+
+#endif  // TERRAIN_EDIT_H
@@ -0,0 +1,55 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#ifndef TERRAIN_EDIT_BROKER_H
+#define TERRAIN_EDIT_BROKER_H
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <boost/shared_ptr.hpp>
+#include "TerrainEdit.h"
+
+namespace ow_dynamic_terrain
+{
+// An in-process broker that lets the terrain plugins share a single computed edit for messages received on the common
+// modify_terrain_* topics. roscpp hands the same message instance to every in-process subscriber of a topic, so the
+// message pointer identifies the operation. The first plugin to receive a message prepares the edit, the remaining
+// registered plugins pick it up from the broker.
+class TerrainEditBroker
+{
+public:
+  static TerrainEditBroker& instance();
+
+  // plugins that consume edits from the broker register themselves such that the broker knows when every consumer
+  // has picked up an edit and it can be released.
+  void registerConsumer();
+  void unregisterConsumer();
+
+  // returns the edit associated with msg, invoking prepare_edit if no other consumer has prepared it yet.
+  // returns nullptr if the edit could not be prepared.
+  std::shared_ptr<TerrainEdit> acquire(const boost::shared_ptr<const void>& msg,
+                                       const std::function<bool(TerrainEdit&)>& prepare_edit);
+
+private:
+  TerrainEditBroker() = default;
+
+  struct Entry
+  {
+    boost::shared_ptr<const void> msg;  // holding the message keeps its address from being reused while cached
+    std::shared_ptr<TerrainEdit> edit;
+    int pending_consumers;
+  };
+
+  // upper bound on cached edits in case a consumer fails to pick up an edit (e.g. heightmap was not available)
+  static constexpr size_t MAX_ENTRIES = 8;
+
+  std::mutex m_mutex;
+  int m_consumers = 0;
+  std::deque<Entry> m_entries;
+};
+}  // namespace ow_dynamic_terrain
+
+#endif  // TERRAIN_EDIT_BROKER_H
@@ -0,0 +1,54 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#ifndef TERRAIN_EDIT_BUILDER_H
+#define TERRAIN_EDIT_BUILDER_H
+
+#include <functional>
+#include <string>
+#include <opencv2/core/core.hpp>
+#include "ow_dynamic_terrain/modify_terrain_circle.h"
+#include "ow_dynamic_terrain/modify_terrain_ellipse.h"
+#include "ow_dynamic_terrain/modify_terrain_patch.h"
+#include "TerrainEdit.h"
+
+namespace ow_dynamic_terrain
+{
+// The parts of a modify terrain operation that do not depend on Gazebo: building the edit image of a message and
+// merging it with the heights of a square heightmap. TerrainModifier uses these to modify the terrain in the
+// simulation and the terrain_replay tool uses them to reproduce the same modifications offline.
+class TerrainEditBuilder
+{
+public:
+  // Validates a modify message and builds its edit image and merge method. The center of the edit is left to the
+  // caller as it depends on how the heightmap is placed in the world.
+  // param h_scale: horizontal scale factor of the heightmap (samples per world unit)
+  // param out_error: receives the reason a message was rejected
+  // return: true if the message is valid and out_edit was filled, false otherwise
+  static bool buildCircle(const modify_terrain_circle& msg, float h_scale, TerrainEdit& out_edit,
+                          std::string& out_error);
+
+  static bool buildEllipse(const modify_terrain_ellipse& msg, float h_scale, TerrainEdit& out_edit,
+                           std::string& out_error);
+
+  static bool buildPatch(const modify_terrain_patch& msg, float h_scale, TerrainEdit& out_edit,
+                         std::string& out_error);
+
+  // computes the range of cells of a square heightmap covered by the image of an edit
+  static cv::Rect getEditRegion(int heightmap_size, const TerrainEdit& edit);
+
+  // Merges the image of an edit with the current heights of a square heightmap.
+  // param heightmap_size: number of cells along each side of the heightmap
+  // param edit: the edit holding the image, its center and merge method. The old and new heights are recorded in
+  //   the edit for reuse by later applications.
+  // param get_height_value: a lambda function to retrive the height value from the heightmap
+  // param set_height_value: a lambda function to set back the height value on the heightmap.
+  // param out_diff: an image that stores the change in heightmap around the tool
+  // return: true if there was a change made to the heightmap, false otherwise
+  static bool mergeEdit(int heightmap_size, TerrainEdit& edit, const std::function<float(int, int)>& get_height_value,
+                        const std::function<void(int, int, float)>& set_height_value, cv::Mat& out_diff);
+};
+}  // namespace ow_dynamic_terrain
+
+#endif  // TERRAIN_EDIT_BUILDER_H
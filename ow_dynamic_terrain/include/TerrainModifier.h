@@ -12,6 +12,8 @@
 #include "ow_dynamic_terrain/modify_terrain_ellipse.h"
 #include "ow_dynamic_terrain/modify_terrain_patch.h"
 #include "ow_dynamic_terrain/modified_terrain_diff.h"
+#include "SlopeRelaxation.h"
+#include "TerrainEdit.h"
 
 namespace ow_dynamic_terrain
 {
@@ -36,6 +38,58 @@ public:
                           const std::function<void(int, int, float)>& set_height_value,
                           ow_dynamic_terrain::modified_terrain_diff& out_diff_msg);
 
+  // Validates a modify message and resolves it into an edit (brush image, target position and merge method) that
+  // can be applied to one or more aspects of the terrain through applyEdit.
+  // return: true if the message is valid and out_edit was filled, false otherwise
+  static bool prepareCircle(gazebo::rendering::Heightmap* heightmap,
+                            const ow_dynamic_terrain::modify_terrain_circle::ConstPtr& msg, TerrainEdit& out_edit);
+
+  static bool prepareEllipse(gazebo::rendering::Heightmap* heightmap,
+                             const ow_dynamic_terrain::modify_terrain_ellipse::ConstPtr& msg, TerrainEdit& out_edit);
+
+  static bool preparePatch(gazebo::rendering::Heightmap* heightmap,
+                           const ow_dynamic_terrain::modify_terrain_patch::ConstPtr& msg, TerrainEdit& out_edit);
+
+  // Applies a prepared edit to a heightmap. The first application merges the edit image with the terrain and stores
+  // the merged heights in the edit; subsequent applications that find the same heights under the edit reuse them.
+  // param heightmap: reference heightmap that the edit was prepared against.
+  // param edit: an edit obtained from one of the prepare methods.
+  // param get_height_value: a lambda function to retrive the height value from the heightmap
+  // param set_height_value: a lambda function to set back the height value on the heightmap.
+  // param out_diff_msg: stores the change in heightmap around the tool
+  // return: true if there was a change made to the heightmap, false otherwise
+  static bool applyEdit(gazebo::rendering::Heightmap* heightmap, TerrainEdit& edit,
+                        const std::function<float(int, int)>& get_height_value,
+                        const std::function<void(int, int, float)>& set_height_value,
+                        ow_dynamic_terrain::modified_terrain_diff& out_diff_msg);
+
+  // Relaxes the slopes of the recently modified regions of a heightmap within the per update budget of the solver.
+  // param heightmap: reference heightmap that defines the size and the resolution of the terrain.
+  // param slope_relaxation: the solver holding the regions that are yet to settle.
+  // param get_height_value: a lambda function to retrive the height value from the heightmap
+  // param set_height_value: a lambda function to set back the height value on the heightmap.
+  // param out_region_diffs: receives the changes applied to each relaxed region
+  // param out_diff_msgs: receives a differential message for each relaxed region
+  // return: true if there was a change made to the heightmap, false otherwise
+  static bool relaxSlopes(gazebo::rendering::Heightmap* heightmap, SlopeRelaxation& slope_relaxation,
+                          const std::function<float(int, int)>& get_height_value,
+                          const std::function<void(int, int, float)>& set_height_value,
+                          std::vector<SlopeRelaxation::RegionDiff>& out_region_diffs,
+                          std::vector<ow_dynamic_terrain::modified_terrain_diff>& out_diff_msgs);
+
+  // Combines the differentials produced by one update of a terrain aspect. Differentials whose images overlap or touch
+  // are summed into a single message covering all of them, such that an edit and the relaxation of the slopes around
+  // it reach subscribers as one change. A differential that touches no other one is passed through unchanged.
+  // param heightmap: reference heightmap that the differentials were computed against.
+  // param diff_msgs: the differentials of the update in the order they were applied
+  // param out_diff_msgs: receives one differential message per group of touching differentials
+  static void mergeDiffMsgs(gazebo::rendering::Heightmap* heightmap,
+                            const std::vector<ow_dynamic_terrain::modified_terrain_diff>& diff_msgs,
+                            std::vector<ow_dynamic_terrain::modified_terrain_diff>& out_diff_msgs);
+
+  // computes the range of heightmap cells covered by the image of an edit
+  static cv::Rect getEditRegion(gazebo::rendering::Heightmap* heightmap, const TerrainEdit& edit);
+
 private:
   // converts a world position to a heightmap position in heightmap image coordiantes.
   // param heightmap: reference heightmap used for the conversion.
@@ -43,27 +97,28 @@ private:
   static cv::Point2i getHeightmapPosition(gazebo::rendering::Heightmap* heightmap,
                                           const geometry_msgs::Point32& position);
 
-  // Imports an OpenCV Matrix object from a sensor_msgs::Image object through cv_bridge
-  static cv_bridge::CvImageConstPtr importImageToOpenCV(const ow_dynamic_terrain::modify_terrain_patch::ConstPtr& msg);
-
-  // Applies the an OpenCV image to a heightmap at a given position
+  // Applies the image of an edit to a heightmap by merging it with current heights of the terrain.
   // param heightmap: heightmap to merge the image with
-  // param center: absolute position within the heightmap where the image will be applied
-  // param z_bias: a value that will be applied as an offset to height values retrieved from the image.
-  // param image: a 2D matrix containing the height values (given as 32-bit floats) to be applied/merged.
-  // param skip_zeros: if true, pixels in image that are equal to zero will be skipped over.
+  // param edit: the edit holding the image, its position and merge method. The old and new heights are recorded in
+  //   the edit for reuse by later applications.
   // param get_height_value: a lambda function to retrive the height value from the heightmap
   // param set_height_value: a lambda function to set back the height value on the heightmap.
-  // param merge_method: Choices are keep, replace, add, sub, min, max and avg.
   // param out_diff_image: an image that stores the change in heightmap around the tool
   // return: true if there was a change made to the heightmap, false otherwise
-  static bool applyImageToHeightmap(gazebo::rendering::Heightmap* heightmap,
-                                    const cv::Point2i& center, float z_bias,
-                                    const cv::Mat& image, bool skip_zeros,
+  static bool applyImageToHeightmap(gazebo::rendering::Heightmap* heightmap, TerrainEdit& edit,
                                     const std::function<float(int, int)>& get_height_value,
                                     const std::function<void(int, int, float)>& set_height_value,
-                                    const std::function<float(float, float)>& merge_method,
                                     cv_bridge::CvImage& out_diff_image);
+
+  // Writes the merged heights of a previously applied edit to a heightmap if the heights found under the edit are
+  // identical to the ones the edit was merged with.
+  // return: true if the merged heights were reused, false if the edit has to be merged again
+  static bool reuseMergedHeights(gazebo::rendering::Heightmap* heightmap, const TerrainEdit& edit,
+                                 const std::function<float(int, int)>& get_height_value,
+                                 const std::function<void(int, int, float)>& set_height_value);
+
+  // converts a heightmap position in heightmap image coordinates to a world position.
+  static geometry_msgs::Point32 getWorldPosition(gazebo::rendering::Heightmap* heightmap, const cv::Point2i& position);
 };
 }  // namespace ow_dynamic_terrain
 
@@ -0,0 +1,137 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#ifndef TERRAIN_OPERATION_LOG_H
+#define TERRAIN_OPERATION_LOG_H
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <ros/serialization.h>
+
+// A compact binary log of the operations accepted by a terrain plugin, sufficient to reproduce the terrain of that
+// aspect offline without Gazebo (see terrain_replay). The log opens with the heights of the terrain before the first
+// operation, followed by one record per operation:
+//
+//   header:  "OWTL" | uint32 version | int32 heightmap_size | float32 heights[heightmap_size * heightmap_size]
+//   record:  uint8 type | float64 sim_time | int32 center_x | int32 center_y | float32 h_scale |
+//            uint32 payload_size | payload
+//
+// Heights are world heights in heightmap image coordinates (row-major). The payload of a modify operation is the ROS
+// serialized modify_terrain_* message; the payload of a relax operation is a ROS serialized 32FC1 sensor_msgs/Image
+// holding the heights of the relaxed region after relaxation. All values are written in host byte order.
+
+namespace ow_dynamic_terrain
+{
+enum class TerrainOperationType : uint8_t
+{
+  Circle = 1,
+  Ellipse = 2,
+  Patch = 3,
+  Relax = 4
+};
+
+struct TerrainOperationRecord
+{
+  TerrainOperationType type;
+  double sim_time;
+  cv::Point2i center;  // center of the operation in heightmap image coordinates
+  float h_scale;       // horizontal scale factor of the heightmap the operation was resolved against
+  std::vector<uint8_t> payload;
+
+  // deserializes the payload into a message of the type matching the record type
+  template <typename M>
+  void decode(M& msg) const
+  {
+    ros::serialization::IStream stream(const_cast<uint8_t*>(payload.data()), static_cast<uint32_t>(payload.size()));
+    ros::serialization::deserialize(stream, msg);
+  }
+};
+
+class TerrainOperationLogWriter
+{
+public:
+  // Creates the log file and writes the current heights of the terrain as the starting point of the replay.
+  // return: true if the log was created, false otherwise
+  bool open(const std::string& path, int heightmap_size, const std::function<float(int, int)>& get_height_value);
+
+  bool isOpen() const
+  {
+    return m_stream.is_open();
+  }
+
+  // appends an operation and flushes it to disk, such that the log remains usable if the simulation is killed
+  template <typename M>
+  void append(TerrainOperationType type, double sim_time, const cv::Point2i& center, float h_scale, const M& msg)
+  {
+    auto payload_size = ros::serialization::serializationLength(msg);
+    m_payload.resize(payload_size);
+    ros::serialization::OStream stream(m_payload.data(), payload_size);
+    ros::serialization::serialize(stream, msg);
+    writeRecord(type, sim_time, center, h_scale);
+  }
+
+private:
+  void writeRecord(TerrainOperationType type, double sim_time, const cv::Point2i& center, float h_scale);
+
+  std::ofstream m_stream;
+  std::vector<uint8_t> m_payload;
+};
+
+class TerrainOperationLogReader
+{
+public:
+  // opens a log and reads the heights the terrain started with
+  // return: true if the file is a valid terrain operation log, false otherwise
+  bool open(const std::string& path, std::string& out_error);
+
+  int heightmapSize() const
+  {
+    return m_heightmap_size;
+  }
+
+  const std::vector<float>& initialHeights() const
+  {
+    return m_initial_heights;
+  }
+
+  // reads the next record
+  // return: false once the end of the log is reached or if the log was truncated
+  bool next(TerrainOperationRecord& out_record);
+
+private:
+  std::ifstream m_stream;
+  int m_heightmap_size = 0;
+  std::vector<float> m_initial_heights;
+};
+
+// Applies the records of a terrain operation log to a heightmap held in memory.
+class TerrainOperationReplay
+{
+public:
+  TerrainOperationReplay(int heightmap_size, std::vector<float> heights);
+
+  // return: true if the record was applied, false if it could not be decoded
+  bool apply(const TerrainOperationRecord& record, std::string& out_error);
+
+  int heightmapSize() const
+  {
+    return m_heightmap_size;
+  }
+
+  const std::vector<float>& heights() const
+  {
+    return m_heights;
+  }
+
+private:
+  int m_heightmap_size;
+  std::vector<float> m_heights;
+};
+}  // namespace ow_dynamic_terrain
+
+#endif  // TERRAIN_OPERATION_LOG_H
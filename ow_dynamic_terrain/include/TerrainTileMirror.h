@@ -0,0 +1,84 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#ifndef TERRAIN_TILE_MIRROR_H
+#define TERRAIN_TILE_MIRROR_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+namespace ow_dynamic_terrain
+{
+// A copy of the heights of one terrain aspect split into square tiles, each carrying a version that is incremented
+// whenever a height within the tile changes. The terrain plugins keep the mirror up to date and stream the tiles
+// whose version changed to subscribers. Readers that run in the same process (other Gazebo plugins) can find the
+// mirror by name and read it directly, any number of readers may read concurrently with each other.
+class TerrainTileMirror
+{
+public:
+  // param heightmap_size: number of cells along each side of the heightmap
+  // param tile_size: number of cells along each side of a tile; tiles along the far edges may be smaller
+  // param get_height_value: a lambda function to retrive the initial height values from the heightmap
+  TerrainTileMirror(int heightmap_size, int tile_size, const std::function<float(int, int)>& get_height_value);
+
+  int heightmapSize() const
+  {
+    return m_heightmap_size;
+  }
+
+  int tileSize() const
+  {
+    return m_tile_size;
+  }
+
+  int tilesPerSide() const
+  {
+    return m_tiles_per_side;
+  }
+
+  // copies the heights of a modified region of the heightmap into the mirror and increments the versions of the
+  // tiles the region overlaps
+  void update(int x, int y, int width, int height, const std::function<float(int, int)>& get_height_value);
+
+  uint64_t tileVersion(int tile_x, int tile_y) const;
+
+  // copies the versions of all tiles (row-major) for comparison with versions that were previously published
+  void tileVersions(std::vector<uint64_t>& out_versions) const;
+
+  // Copies the heights of a tile, averaging blocks of downsample x downsample cells into one value.
+  // param out_heights: receives out_width * out_height heights in row-major order
+  // return: the version of the tile that was copied
+  uint64_t readTile(int tile_x, int tile_y, int downsample, std::vector<float>& out_heights, int& out_width,
+                    int& out_height) const;
+
+  // Invokes reader with the full resolution heights (row-major, heightmap image coordinates) while holding a shared
+  // lock that keeps the mirror from being updated. The reader should return promptly.
+  void read(const std::function<void(const float* heights, int heightmap_size)>& reader) const;
+
+  // makes a mirror available to readers within the process under the given name; passing nullptr removes it
+  static void publish(const std::string& name, std::shared_ptr<TerrainTileMirror> mirror);
+
+  // returns the mirror published under the given name, or nullptr if there is none
+  static std::shared_ptr<const TerrainTileMirror> find(const std::string& name);
+
+private:
+  int m_heightmap_size;
+  int m_tile_size;
+  int m_tiles_per_side;
+  mutable std::shared_timed_mutex m_mutex;
+  std::vector<float> m_heights;
+  std::vector<uint64_t> m_tile_versions;
+
+  static std::mutex s_registry_mutex;
+  static std::map<std::string, std::shared_ptr<TerrainTileMirror>> s_registry;
+};
+}  // namespace ow_dynamic_terrain
+
+#endif  // TERRAIN_TILE_MIRROR_H
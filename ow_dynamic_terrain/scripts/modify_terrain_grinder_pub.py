@@ -10,8 +10,7 @@ import rospy
 import time
 from math import degrees
 import numpy as np
-from geometry_msgs.msg import Point
-from gazebo_msgs.msg import LinkStates
+from geometry_msgs.msg import Point, PoseStamped
 from tf.transformations import euler_from_quaternion
 from ow_dynamic_terrain.msg import modify_terrain_circle
 
@@ -25,8 +24,8 @@ class ModifyTerrainGrinder:
         'ow_dynamic_terrain/modify_terrain_circle/visual', modify_terrain_circle, queue_size=1)
     self.pub_collision = rospy.Publisher(
         'ow_dynamic_terrain/modify_terrain_circle/collision', modify_terrain_circle, queue_size=1)
-    self.states_sub = rospy.Subscriber(
-        "/gazebo/link_states", LinkStates, self.handle_link_states)
+    self.pose_sub = rospy.Subscriber(
+        "/link_poses/lander/l_grinder", PoseStamped, self.handle_link_pose)
 
   def compose_modify_terrain_circle_message(self, position, depth, scale=1.0):
     """ Composes a modify_terrain_circle that matches the grinder end effector
@@ -66,15 +65,9 @@ class ModifyTerrainGrinder:
     
     rospy.logdebug_throttle(1, "modify_terrain_grinder message:\n" + str(msg))
 
-  def handle_link_states(self, data):
-    try:
-      idx = data.name.index("lander::l_grinder")
-    except ValueError:
-      rospy.logerr_throttle(1, "lander::l_grinder not found in link_states")
-      return
-
-    position = data.pose[idx].position
-    orientation = data.pose[idx].orientation
+  def handle_link_pose(self, data):
+    position = data.pose.position
+    orientation = data.pose.orientation
     self.check_and_submit(position, orientation)
 
 
@@ -2,7 +2,7 @@
 # -*- encoding: utf-8 -*-
 """
 The modify_terrain_scoop_pub module updates the terrain in line with the scoop
-movement. It accomplishes this by subscribing to link poses of the scoop and
+movement. It accomplishes this by subscribing to the pose of the scoop tip and
 issuing a corresponding modify_terrain_* message to update the terrain.
 """
 
@@ -10,8 +10,7 @@ import time
 from math import degrees
 import rospy
 import numpy as np
-from geometry_msgs.msg import Point
-from gazebo_msgs.msg import LinkStates
+from geometry_msgs.msg import Point, PoseStamped
 from tf.transformations import euler_from_quaternion
 from ow_dynamic_terrain.msg import modify_terrain_ellipse
 
@@ -24,8 +23,8 @@ class ModifyTerrainScoop:
         'ow_dynamic_terrain/modify_terrain_ellipse/visual', modify_terrain_ellipse, queue_size=1)
     self.collision_pub = rospy.Publisher(
         'ow_dynamic_terrain/modify_terrain_ellipse/collision', modify_terrain_ellipse, queue_size=1)
-    self.states_sub = rospy.Subscriber(
-        "/gazebo/link_states", LinkStates, self.handle_link_states)
+    self.pose_sub = rospy.Subscriber(
+        "/link_poses/lander/l_scoop_tip", PoseStamped, self.handle_link_pose)
 
   def compose_modify_terrain_ellipse_message(self, position, orientation, scale=1.0):
     """ Composes a modify_terrain_ellipse that matches the tip of scoop end effector
@@ -60,15 +59,9 @@ class ModifyTerrainScoop:
     
     rospy.logdebug_throttle(1, "modify_terrain_scoop message:\n" + str(msg))
 
-  def handle_link_states(self, data):
-    try:
-      idx = data.name.index("lander::l_scoop_tip")
-    except ValueError:
-      rospy.logerr_throttle(1, "lander::l_scoop_tip not found in link_states")
-      return
-
-    position = data.pose[idx].position
-    orientation = data.pose[idx].orientation
+  def handle_link_pose(self, data):
+    position = data.pose.position
+    orientation = data.pose.orientation
     self.check_and_submit(position, orientation)
 
 
@@ -3,12 +3,28 @@
 // this repository.
 
 #include "DynamicTerrainBase.h"
+#include <cv_bridge/cv_bridge.h>
+#include <sensor_msgs/image_encodings.h>
 #include "memory_ext.h"
+#include "TerrainModifier.h"
 
 using namespace std;
 using namespace ow_dynamic_terrain;
 
-void DynamicTerrainBase::Initialize(const std::string& topic_extension)
+static const int DEFAULT_RELAXATION_CELLS_PER_UPDATE = 65536;
+static const int DEFAULT_RELAXATION_MAX_SPREAD = 32;
+static const int DEFAULT_TILE_SIZE = 64;
+
+DynamicTerrainBase::~DynamicTerrainBase()
+{
+  if (m_edit_broker_registered)
+    TerrainEditBroker::instance().unregisterConsumer();
+
+  if (m_terrain_mirror)
+    TerrainTileMirror::publish(m_mirror_name, nullptr);
+}
+
+void DynamicTerrainBase::Initialize(const std::string& topic_extension, sdf::ElementPtr sdf)
 {
   if (!ros::isInitialized())
   {
@@ -20,34 +36,303 @@ void DynamicTerrainBase::Initialize(const std::string& topic_extension)
   m_node_handle->setCallbackQueue(&m_callback_queue);
 
   auto on_modify_terrain_circle = [this](const modify_terrain_circle::ConstPtr& msg) {
-    this->onModifyTerrainCircleMsg(msg);
+    this->onModifyTerrainCircleMsg(msg, true);
+  };
+  auto on_modify_terrain_circle_aspect = [this](const modify_terrain_circle::ConstPtr& msg) {
+    this->onModifyTerrainCircleMsg(msg, false);
   };
   subscribe<modify_terrain_circle>("modify_terrain_circle", on_modify_terrain_circle);
-  subscribe<modify_terrain_circle>("modify_terrain_circle/" + topic_extension, on_modify_terrain_circle);
+  subscribe<modify_terrain_circle>("modify_terrain_circle/" + topic_extension, on_modify_terrain_circle_aspect);
 
   auto on_modify_terrain_ellipse = [this](const modify_terrain_ellipse::ConstPtr& msg) {
-    this->onModifyTerrainEllipseMsg(msg);
+    this->onModifyTerrainEllipseMsg(msg, true);
+  };
+  auto on_modify_terrain_ellipse_aspect = [this](const modify_terrain_ellipse::ConstPtr& msg) {
+    this->onModifyTerrainEllipseMsg(msg, false);
   };
   subscribe<modify_terrain_ellipse>("modify_terrain_ellipse", on_modify_terrain_ellipse);
-  subscribe<modify_terrain_ellipse>("modify_terrain_ellipse/" + topic_extension, on_modify_terrain_ellipse);
+  subscribe<modify_terrain_ellipse>("modify_terrain_ellipse/" + topic_extension, on_modify_terrain_ellipse_aspect);
 
   auto on_modify_terrain_patch = [this](const modify_terrain_patch::ConstPtr& msg) {
-    this->onModifyTerrainPatchMsg(msg);
+    this->onModifyTerrainPatchMsg(msg, true);
+  };
+  auto on_modify_terrain_patch_aspect = [this](const modify_terrain_patch::ConstPtr& msg) {
+    this->onModifyTerrainPatchMsg(msg, false);
   };
   subscribe<modify_terrain_patch>("modify_terrain_patch", on_modify_terrain_patch);
-  subscribe<modify_terrain_patch>("modify_terrain_patch/" + topic_extension, on_modify_terrain_patch);
+  subscribe<modify_terrain_patch>("modify_terrain_patch/" + topic_extension, on_modify_terrain_patch_aspect);
+
+  TerrainEditBroker::instance().registerConsumer();
+  m_edit_broker_registered = true;
 
+  // differentials are merged per update, but edits at distant locations still produce one message each
   m_differential_pub = m_node_handle->advertise<modified_terrain_diff>(
-      "/" + m_package_name + "/modification_differential/" + topic_extension, 1);
+      "/" + m_package_name + "/modification_differential/" + topic_extension, 10);
+
+  // slope relaxation is enabled by specifying an angle of repose (in degrees) for the terrain
+  if (sdf && sdf->HasElement("angle_of_repose"))
+  {
+    auto angle_of_repose = sdf->Get<double>("angle_of_repose");
+    auto cells_per_update = sdf->HasElement("relaxation_cells_per_update") ?
+                                sdf->Get<int>("relaxation_cells_per_update") :
+                                DEFAULT_RELAXATION_CELLS_PER_UPDATE;
+    auto max_spread = sdf->HasElement("relaxation_max_spread") ? sdf->Get<int>("relaxation_max_spread") :
+                                                                 DEFAULT_RELAXATION_MAX_SPREAD;
+    if (angle_of_repose <= 0.0 || angle_of_repose >= 90.0)
+      gzerr << m_plugin_name << ": angle_of_repose has to be within (0, 90) degrees! Slope relaxation disabled" << endl;
+    else if (cells_per_update <= 0)
+      gzerr << m_plugin_name << ": relaxation_cells_per_update has to be positive! Slope relaxation disabled" << endl;
+    else if (max_spread < 0)
+      gzerr << m_plugin_name << ": relaxation_max_spread can't be negative! Slope relaxation disabled" << endl;
+    else
+      m_slope_relaxation = make_unique<SlopeRelaxation>(angle_of_repose, cells_per_update, max_spread);
+  }
+
+  // accepted operations are logged for offline replay when a log file is specified
+  if (sdf && sdf->HasElement("operation_log"))
+    m_operation_log_path = sdf->Get<string>("operation_log");
+
+  // the terrain mirror is shared with other plugins in the process under the name of the terrain aspect, and
+  // streamed to subscribers when a tile stream rate is specified
+  auto tile_stream_rate = sdf && sdf->HasElement("tile_stream_rate") ? sdf->Get<double>("tile_stream_rate") : 0.0;
+  m_tile_stream_period = tile_stream_rate > 0.0 ? 1.0 / tile_stream_rate : 0.0;
+  m_tile_size = sdf && sdf->HasElement("tile_size") ? sdf->Get<int>("tile_size") : DEFAULT_TILE_SIZE;
+  m_tile_downsample = sdf && sdf->HasElement("tile_downsample") ? sdf->Get<int>("tile_downsample") : 1;
+  if (m_tile_size <= 0 || m_tile_downsample <= 0)
+  {
+    gzerr << m_plugin_name << ": tile_size and tile_downsample have to be positive! Terrain mirror disabled" << endl;
+  }
+  else if (m_tile_stream_period > 0.0 || (sdf && sdf->HasElement("terrain_mirror") && sdf->Get<bool>("terrain_mirror")))
+  {
+    m_mirror_name = topic_extension;
+    if (m_tile_stream_period > 0.0)
+    {
+      ros::AdvertiseOptions options = ros::AdvertiseOptions::create<terrain_tiles>(
+          "/" + m_package_name + "/terrain_tiles/" + topic_extension, 1,
+          [this](const ros::SingleSubscriberPublisher& pub) { onTileSubscriberConnect(pub); },
+          ros::SubscriberStatusCallback(), ros::VoidConstPtr(), &m_callback_queue);
+      m_tiles_pub = m_node_handle->advertise(options);
+    }
+  }
 
   m_on_update_connection = gazebo::event::Events::ConnectPostRender([this]() {
     if (m_node_handle->ok())
       m_callback_queue.callAvailable();
+    if (m_slope_relaxation && m_slope_relaxation->isActive())
+      onRelaxTerrain();
+    if (!m_pending_diff_msgs.empty())
+      publishPendingDifferentials();
+    if (!m_mirror_name.empty())
+      updateTileStream();
   });
 
   gzlog << m_plugin_name << ": successfully loaded!" << endl;
 }
 
+void DynamicTerrainBase::publishDifferential(const modified_terrain_diff& diff_msg)
+{
+  m_pending_diff_msgs.push_back(diff_msg);
+}
+
+void DynamicTerrainBase::publishPendingDifferentials()
+{
+  auto heightmap = getHeightmap(gazebo::rendering::get_scene());
+  if (heightmap == nullptr)
+  {
+    for (const auto& diff_msg : m_pending_diff_msgs)
+      m_differential_pub.publish(diff_msg);
+    m_pending_diff_msgs.clear();
+    return;
+  }
+
+  vector<modified_terrain_diff> diff_msgs;
+  TerrainModifier::mergeDiffMsgs(heightmap, m_pending_diff_msgs, diff_msgs);
+  m_pending_diff_msgs.clear();
+
+  for (const auto& diff_msg : diff_msgs)
+    m_differential_pub.publish(diff_msg);
+}
+
+void DynamicTerrainBase::activateSlopeRelaxation(gazebo::rendering::Heightmap* heightmap, const TerrainEdit& edit)
+{
+  if (!m_slope_relaxation)
+    return;
+
+  auto region = TerrainModifier::getEditRegion(heightmap, edit);
+  m_slope_relaxation->activate({ region.x, region.y, region.width, region.height });
+}
+
+void DynamicTerrainBase::updateTerrainMirror(gazebo::rendering::Heightmap* heightmap, const TerrainEdit& edit,
+                                             const function<float(int, int)>& get_height_value)
+{
+  if (!m_terrain_mirror)
+    return;
+
+  auto region = TerrainModifier::getEditRegion(heightmap, edit);
+  m_terrain_mirror->update(region.x, region.y, region.width, region.height, get_height_value);
+}
+
+void DynamicTerrainBase::updateTerrainMirror(const vector<SlopeRelaxation::RegionDiff>& region_diffs,
+                                             const function<float(int, int)>& get_height_value)
+{
+  if (!m_terrain_mirror)
+    return;
+
+  for (const auto& region_diff : region_diffs)
+  {
+    const auto& region = region_diff.region;
+    m_terrain_mirror->update(region.x, region.y, region.width, region.height, get_height_value);
+  }
+}
+
+void DynamicTerrainBase::updateTileStream()
+{
+  if (!m_terrain_mirror)
+  {
+    auto heightmap = gazebo::rendering::get_scene() ? gazebo::rendering::get_scene()->GetHeightmap() : nullptr;
+    if (heightmap == nullptr)
+      return;  // the heightmap may not have been loaded yet
+
+    auto get_height_value = getHeightAccessor(heightmap);
+    if (!get_height_value)
+      return;
+
+    auto terrain = heightmap->OgreTerrain()->getTerrain(0, 0);
+    m_terrain_position.x = terrain->getPosition().x;
+    m_terrain_position.y = terrain->getPosition().y;
+    m_terrain_position.z = terrain->getPosition().z;
+    m_terrain_world_size = terrain->getWorldSize();
+    m_terrain_mirror =
+        make_shared<TerrainTileMirror>(static_cast<int>(terrain->getSize()), m_tile_size, get_height_value);
+    m_terrain_mirror->tileVersions(m_published_tile_versions);
+    TerrainTileMirror::publish(m_mirror_name, m_terrain_mirror);
+    gzlog << m_plugin_name << ": terrain mirror [" << m_mirror_name << "] is available" << endl;
+
+    if (m_snapshot_pending)
+    {
+      // subscribers that connected before the mirror existed receive the snapshot now
+      terrain_tiles msg;
+      buildTilesMsg(true, msg);
+      m_tiles_pub.publish(msg);
+      m_snapshot_pending = false;
+    }
+  }
+
+  if (m_tile_stream_period <= 0.0)
+    return;
+
+  auto now = chrono::steady_clock::now();
+  if (now < m_next_tile_publish)
+    return;
+  m_next_tile_publish = now + chrono::duration_cast<chrono::steady_clock::duration>(
+                                  chrono::duration<double>(m_tile_stream_period));
+
+  if (m_tiles_pub.getNumSubscribers() == 0)
+  {
+    // subscribers that connect later start from a snapshot, so there is nothing to catch up on
+    m_terrain_mirror->tileVersions(m_published_tile_versions);
+    return;
+  }
+
+  terrain_tiles msg;
+  buildTilesMsg(false, msg);
+  if (!msg.tiles.empty())
+    m_tiles_pub.publish(msg);
+}
+
+void DynamicTerrainBase::onTileSubscriberConnect(const ros::SingleSubscriberPublisher& pub)
+{
+  if (!m_terrain_mirror)
+  {
+    m_snapshot_pending = true;
+    return;
+  }
+
+  // only the subscriber that connected receives the snapshot, the others keep receiving changed tiles
+  terrain_tiles msg;
+  buildTilesMsg(true, msg);
+  pub.publish(msg);
+}
+
+void DynamicTerrainBase::buildTilesMsg(bool snapshot, terrain_tiles& out_msg)
+{
+  out_msg.header.stamp = ros::Time::now();
+  out_msg.snapshot = snapshot;
+  out_msg.position = m_terrain_position;
+  out_msg.world_size = m_terrain_world_size;
+  out_msg.heightmap_size = m_terrain_mirror->heightmapSize();
+  out_msg.tile_size = m_terrain_mirror->tileSize();
+  out_msg.downsample = m_tile_downsample;
+
+  vector<uint64_t> versions;
+  m_terrain_mirror->tileVersions(versions);
+
+  vector<float> heights;
+  int width, height;
+  auto tiles_per_side = m_terrain_mirror->tilesPerSide();
+  for (auto tile_y = 0; tile_y < tiles_per_side; ++tile_y)
+    for (auto tile_x = 0; tile_x < tiles_per_side; ++tile_x)
+    {
+      auto index = tile_y * tiles_per_side + tile_x;
+      if (!snapshot && versions[index] == m_published_tile_versions[index])
+        continue;
+
+      terrain_tile tile;
+      tile.tile_x = tile_x;
+      tile.tile_y = tile_y;
+      tile.version = m_terrain_mirror->readTile(tile_x, tile_y, m_tile_downsample, heights, width, height);
+      auto image = cv::Mat(height, width, CV_32FC1, heights.data());
+      cv_bridge::CvImage(out_msg.header, sensor_msgs::image_encodings::TYPE_32FC1, image).toImageMsg(tile.heights);
+      out_msg.tiles.push_back(move(tile));
+    }
+
+  // snapshots go to a single subscriber, the stream of changes continues from what the others have seen
+  if (!snapshot)
+    m_published_tile_versions = versions;
+}
+
+bool DynamicTerrainBase::openOperationLog(gazebo::rendering::Heightmap* heightmap,
+                                          const function<float(int, int)>& get_height_value)
+{
+  if (m_operation_log.isOpen())
+    return true;
+
+  if (m_operation_log_path.empty())
+    return false;
+
+  auto terrain = heightmap->OgreTerrain()->getTerrain(0, 0);
+  if (!m_operation_log.open(m_operation_log_path, static_cast<int>(terrain->getSize()), get_height_value))
+  {
+    gzerr << m_plugin_name << ": Couldn't create operation log " << m_operation_log_path << endl;
+    m_operation_log_path.clear();  // don't retry on every operation
+    return false;
+  }
+
+  gzlog << m_plugin_name << ": logging terrain operations to " << m_operation_log_path << endl;
+  return true;
+}
+
+void DynamicTerrainBase::logRelaxation(gazebo::rendering::Heightmap* heightmap,
+                                       const function<float(int, int)>& get_height_value,
+                                       const vector<SlopeRelaxation::RegionDiff>& region_diffs)
+{
+  if (region_diffs.empty() || !openOperationLog(heightmap, get_height_value))
+    return;
+
+  auto terrain = heightmap->OgreTerrain()->getTerrain(0, 0);
+  auto h_scale = terrain->getSize() / terrain->getWorldSize();
+  auto sim_time = ros::Time::now().toSec();
+
+  for (const auto& region_diff : region_diffs)
+  {
+    const auto& region = region_diff.region;
+    auto heights = cv::Mat(region.height, region.width, CV_32FC1, const_cast<float*>(region_diff.heights.data()));
+    auto image = cv_bridge::CvImage(std_msgs::Header(), sensor_msgs::image_encodings::TYPE_32FC1, heights);
+    auto center = cv::Point2i(region.x + region.width / 2, region.y + region.height / 2);
+    m_operation_log.append(TerrainOperationType::Relax, sim_time, center, h_scale, *image.toImageMsg());
+  }
+}
+
 template <typename T>
 void DynamicTerrainBase::subscribe(const std::string& topic,
                                    const boost::function<void(const boost::shared_ptr<T const>&)>& callback)
@@ -2,6 +2,7 @@
 // Research and Simulation can be found in README.md in the root directory of
 // this repository.
 
+#include <chrono>
 #include <ros/callback_queue.h>
 #include <ros/ros.h>
 #include <ros/subscribe_options.h>
@@ -12,6 +13,11 @@
 #include "ow_dynamic_terrain/modify_terrain_ellipse.h"
 #include "ow_dynamic_terrain/modify_terrain_patch.h"
 #include "ow_dynamic_terrain/modified_terrain_diff.h"
+#include "ow_dynamic_terrain/terrain_tiles.h"
+#include "SlopeRelaxation.h"
+#include "TerrainEditBroker.h"
+#include "TerrainOperationLog.h"
+#include "TerrainTileMirror.h"
 
 namespace ow_dynamic_terrain
 {
@@ -24,20 +30,108 @@ protected:
   {
   }
 
-  void Initialize(const std::string& topic_extension);
+  virtual ~DynamicTerrainBase();
 
-  virtual void onModifyTerrainCircleMsg(const modify_terrain_circle::ConstPtr& msg) = 0;
+  void Initialize(const std::string& topic_extension, sdf::ElementPtr sdf);
 
-  virtual void onModifyTerrainEllipseMsg(const modify_terrain_ellipse::ConstPtr& msg) = 0;
+  // shared is true when the message was received on one of the topics common to all terrain plugins, in which case
+  // the edit can be shared with the other plugins through acquireEdit.
+  virtual void onModifyTerrainCircleMsg(const modify_terrain_circle::ConstPtr& msg, bool shared) = 0;
 
-  virtual void onModifyTerrainPatchMsg(const modify_terrain_patch::ConstPtr& msg) = 0;
+  virtual void onModifyTerrainEllipseMsg(const modify_terrain_ellipse::ConstPtr& msg, bool shared) = 0;
+
+  virtual void onModifyTerrainPatchMsg(const modify_terrain_patch::ConstPtr& msg, bool shared) = 0;
+
+  // invoked once per frame while slope relaxation is enabled and has regions that are yet to settle
+  virtual void onRelaxTerrain() = 0;
+
+  // returns an accessor to the world heights of the terrain aspect handled by the plugin, or an empty function if
+  // the terrain isn't available
+  virtual std::function<float(int, int)> getHeightAccessor(gazebo::rendering::Heightmap* heightmap) = 0;
 
 protected:
   gazebo::rendering::Heightmap* getHeightmap(gazebo::rendering::ScenePtr scene);
+
+  // Returns the edit for the given message. Edits of shared messages are prepared once through the TerrainEditBroker
+  // and handed to every terrain plugin, while edits of aspect specific messages are prepared locally.
+  template <typename T, typename P>
+  std::shared_ptr<TerrainEdit> acquireEdit(gazebo::rendering::Heightmap* heightmap, const T& msg, bool shared,
+                                           P prepare_method)
+  {
+    auto prepare_edit = [&heightmap, &msg, &prepare_method](TerrainEdit& edit) {
+      return prepare_method(heightmap, msg, edit);
+    };
+
+    if (shared && m_edit_broker_registered)
+      return TerrainEditBroker::instance().acquire(msg, prepare_edit);
+
+    auto edit = std::make_shared<TerrainEdit>();
+    return prepare_edit(*edit) ? edit : nullptr;
+  }
   
+  // Queues a differential for publication at the end of the current update. The differentials of all the edits and
+  // the relaxation performed in an update are merged before publication, see TerrainModifier::mergeDiffMsgs.
+  void publishDifferential(const modified_terrain_diff& diff_msg);
+
+  // queues the region affected by an applied edit for slope relaxation if it is enabled
+  void activateSlopeRelaxation(gazebo::rendering::Heightmap* heightmap, const TerrainEdit& edit);
+
+  // Appends an accepted operation to the operation log if logging is enabled. The log is created with the first
+  // operation such that it starts from the heights that operation was applied to.
+  template <typename M>
+  void logOperation(gazebo::rendering::Heightmap* heightmap, const std::function<float(int, int)>& get_height_value,
+                    const TerrainEdit& edit, const M& msg)
+  {
+    if (openOperationLog(heightmap, get_height_value))
+      m_operation_log.append(operationType(msg), ros::Time::now().toSec(), edit.center, edit.h_scale, msg);
+  }
+
+  // appends the heights of relaxed regions to the operation log if logging is enabled
+  void logRelaxation(gazebo::rendering::Heightmap* heightmap, const std::function<float(int, int)>& get_height_value,
+                     const std::vector<SlopeRelaxation::RegionDiff>& region_diffs);
+
+  // copies the heights modified by an edit or by slope relaxation into the terrain mirror if it is enabled
+  void updateTerrainMirror(gazebo::rendering::Heightmap* heightmap, const TerrainEdit& edit,
+                           const std::function<float(int, int)>& get_height_value);
+
+  void updateTerrainMirror(const std::vector<SlopeRelaxation::RegionDiff>& region_diffs,
+                           const std::function<float(int, int)>& get_height_value);
+
   template <typename T>
   void subscribe(const std::string& topic, const boost::function<void(const boost::shared_ptr<T const>&)>& callback);
 
+private:
+  // merges and publishes the differentials queued during the current update
+  void publishPendingDifferentials();
+
+  // creates the terrain mirror once the heightmap is available and publishes the tiles that changed at the
+  // configured rate
+  void updateTileStream();
+
+  void onTileSubscriberConnect(const ros::SingleSubscriberPublisher& pub);
+
+  // builds a message holding either every tile of the mirror or only those whose version differs from
+  // m_published_tile_versions
+  void buildTilesMsg(bool snapshot, terrain_tiles& out_msg);
+
+  bool openOperationLog(gazebo::rendering::Heightmap* heightmap,
+                        const std::function<float(int, int)>& get_height_value);
+
+  static TerrainOperationType operationType(const modify_terrain_circle&)
+  {
+    return TerrainOperationType::Circle;
+  }
+
+  static TerrainOperationType operationType(const modify_terrain_ellipse&)
+  {
+    return TerrainOperationType::Ellipse;
+  }
+
+  static TerrainOperationType operationType(const modify_terrain_patch&)
+  {
+    return TerrainOperationType::Patch;
+  }
+
 protected:
   std::string m_package_name;
   std::string m_plugin_name;
@@ -46,6 +140,24 @@ protected:
   ros::CallbackQueue m_callback_queue;
   std::vector<ros::Subscriber> m_subscribers;
   ros::Publisher m_differential_pub;
+  std::vector<modified_terrain_diff> m_pending_diff_msgs;
+  bool m_edit_broker_registered = false;
+  std::unique_ptr<SlopeRelaxation> m_slope_relaxation;
+  std::string m_operation_log_path;  // empty when logging is disabled
+  TerrainOperationLogWriter m_operation_log;
+
+  // terrain mirror and tile stream
+  std::string m_mirror_name;  // empty when the mirror is disabled
+  int m_tile_size;
+  int m_tile_downsample;
+  double m_tile_stream_period;  // in seconds, zero when the tile stream is disabled
+  std::shared_ptr<TerrainTileMirror> m_terrain_mirror;
+  std::vector<uint64_t> m_published_tile_versions;
+  std::chrono::steady_clock::time_point m_next_tile_publish;
+  bool m_snapshot_pending = false;
+  geometry_msgs::Point32 m_terrain_position;
+  float m_terrain_world_size = 0.0f;
+  ros::Publisher m_tiles_pub;
 };
 
 }  // namespace ow_dynamic_terrain
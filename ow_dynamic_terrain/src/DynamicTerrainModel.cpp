@@ -28,7 +28,7 @@ public:
   {
   }
 
-  void Load(ModelPtr model, sdf::ElementPtr /*sdf*/) override
+  void Load(ModelPtr model, sdf::ElementPtr sdf) override
   {
     GZ_ASSERT(model != nullptr, "DynamicTerrainModel: model can't be null!");
 
@@ -40,7 +40,7 @@ public:
       gzerr << m_plugin_name << ": ODE's LCP Error messages have been suppressed!" << endl;
     }
 
-    Initialize("collision");
+    Initialize("collision", sdf);
   }
 
 private:
@@ -94,8 +94,8 @@ private:
     heightmap_shape->SetHeight(x, heightmap_shape->VertexCount().Y() - y - 1, value);
   }
 
-  template <typename T, typename M>
-  void onModifyTerrainMsg(T msg, M modify_method)
+  template <typename T, typename P>
+  void onModifyTerrainMsg(T msg, bool shared, P prepare_method)
   {
     auto heightmap = getHeightmap(get_scene());
     if (heightmap == nullptr)
@@ -113,8 +113,14 @@ private:
 
     modified_terrain_diff diff_msg;
 
-    auto changed = modify_method(heightmap, msg, 
-        [&heightmap_shape](int x, int y) { return getHeightInWorldCoords(heightmap_shape, x, y); },
+    auto edit = acquireEdit(heightmap, msg, shared, prepare_method);
+    if (edit == nullptr)
+      return;
+
+    auto get_height = [&heightmap_shape](int x, int y) { return getHeightInWorldCoords(heightmap_shape, x, y); };
+    logOperation(heightmap, get_height, *edit, *msg);
+
+    auto changed = TerrainModifier::applyEdit(heightmap, *edit, get_height,
         [&heightmap_shape](int x, int y, float value) { setHeightFromWorldCoords(heightmap_shape, x, y, value); },
         diff_msg);
 
@@ -122,24 +128,69 @@ private:
     {
       // Re-enable physics updates for models that may have entered a standstill state
       m_model->GetWorld()->EnableAllModels();
-      // publish differential
-      m_differential_pub.publish(diff_msg);
+      publishDifferential(diff_msg);
+      updateTerrainMirror(heightmap, *edit, get_height);
+      activateSlopeRelaxation(heightmap, *edit);
+    }
+  }
+
+  void onRelaxTerrain() override
+  {
+    auto heightmap = getHeightmap(get_scene());
+    if (heightmap == nullptr)
+    {
+      gzerr << m_plugin_name << ": Couldn't acquire heightmap!" << endl;
+      return;
+    }
+
+    auto heightmap_shape = getHeightmapShape();
+    if (heightmap_shape == nullptr)
+    {
+      gzerr << m_plugin_name << ": Couldn't acquire heightmap shape!" << endl;
+      return;
+    }
+
+    vector<SlopeRelaxation::RegionDiff> region_diffs;
+    vector<modified_terrain_diff> diff_msgs;
+
+    auto get_height = [&heightmap_shape](int x, int y) { return getHeightInWorldCoords(heightmap_shape, x, y); };
+    auto changed = TerrainModifier::relaxSlopes(heightmap, *m_slope_relaxation, get_height,
+        [&heightmap_shape](int x, int y, float value) { setHeightFromWorldCoords(heightmap_shape, x, y, value); },
+        region_diffs, diff_msgs);
+    logRelaxation(heightmap, get_height, region_diffs);
+
+    if (changed)
+    {
+      // Re-enable physics updates for models resting on the slopes that were relaxed
+      m_model->GetWorld()->EnableAllModels();
+      for (const auto& diff_msg : diff_msgs)
+        publishDifferential(diff_msg);
+      updateTerrainMirror(region_diffs, get_height);
     }
   }
 
-  void onModifyTerrainCircleMsg(const modify_terrain_circle::ConstPtr& msg) override
+  function<float(int, int)> getHeightAccessor(Heightmap* /*heightmap*/) override
+  {
+    auto heightmap_shape = getHeightmapShape();
+    if (heightmap_shape == nullptr)
+      return nullptr;
+
+    return [heightmap_shape](int x, int y) { return getHeightInWorldCoords(heightmap_shape, x, y); };
+  }
+
+  void onModifyTerrainCircleMsg(const modify_terrain_circle::ConstPtr& msg, bool shared) override
   {
-    onModifyTerrainMsg(msg, TerrainModifier::modifyCircle);
+    onModifyTerrainMsg(msg, shared, TerrainModifier::prepareCircle);
   }
 
-  void onModifyTerrainEllipseMsg(const modify_terrain_ellipse::ConstPtr& msg) override
+  void onModifyTerrainEllipseMsg(const modify_terrain_ellipse::ConstPtr& msg, bool shared) override
   {
-    onModifyTerrainMsg(msg, TerrainModifier::modifyEllipse);
+    onModifyTerrainMsg(msg, shared, TerrainModifier::prepareEllipse);
   }
 
-  void onModifyTerrainPatchMsg(const modify_terrain_patch::ConstPtr& msg) override
+  void onModifyTerrainPatchMsg(const modify_terrain_patch::ConstPtr& msg, bool shared) override
   {
-    onModifyTerrainMsg(msg, TerrainModifier::modifyPatch);
+    onModifyTerrainMsg(msg, shared, TerrainModifier::preparePatch);
   }
 
 private:
@@ -18,9 +18,9 @@ public:
   {
   }
 
-  void Load(VisualPtr /*visual*/, sdf::ElementPtr /*sdf*/) override
+  void Load(VisualPtr /*visual*/, sdf::ElementPtr sdf) override
   {
-    Initialize("visual");
+    Initialize("visual", sdf);
   }
 
 private:
@@ -37,8 +37,8 @@ private:
     terrain->setHeightAtPoint(x, y, value);
   }
 
-  template <typename T, typename M>
-  void onModifyTerrainMsg(T msg, M modify_method)
+  template <typename T, typename P>
+  void onModifyTerrainMsg(T msg, bool shared, P prepare_method)
   {
     auto heightmap = getHeightmap(get_scene());
     if (heightmap == nullptr)
@@ -50,8 +50,14 @@ private:
     modified_terrain_diff diff_msg;
 
     auto terrain = heightmap->OgreTerrain()->getTerrain(0, 0);
-    auto changed = modify_method(heightmap, msg, 
-        [&terrain](int x, int y) { return getHeightInWorldCoords(terrain, x, y); },
+    auto edit = acquireEdit(heightmap, msg, shared, prepare_method);
+    if (edit == nullptr)
+      return;
+
+    auto get_height = [&terrain](int x, int y) { return getHeightInWorldCoords(terrain, x, y); };
+    logOperation(heightmap, get_height, *edit, *msg);
+
+    auto changed = TerrainModifier::applyEdit(heightmap, *edit, get_height,
         [&terrain](int x, int y, float value) { setHeightFromWorldCoords(terrain, x, y, value); }, 
         diff_msg);
 
@@ -60,23 +66,61 @@ private:
       terrain->updateGeometry();
       terrain->updateDerivedData(false, Ogre::Terrain::DERIVED_DATA_NORMALS | Ogre::Terrain::DERIVED_DATA_LIGHTMAP);
 
-      m_differential_pub.publish(diff_msg);
+      publishDifferential(diff_msg);
+      updateTerrainMirror(heightmap, *edit, get_height);
+      activateSlopeRelaxation(heightmap, *edit);
+    }
+  }
+
+  void onRelaxTerrain() override
+  {
+    auto heightmap = getHeightmap(get_scene());
+    if (heightmap == nullptr)
+    {
+      gzerr << m_plugin_name << ": Couldn't acquire heightmap!" << endl;
+      return;
+    }
+
+    vector<SlopeRelaxation::RegionDiff> region_diffs;
+    vector<modified_terrain_diff> diff_msgs;
+
+    auto terrain = heightmap->OgreTerrain()->getTerrain(0, 0);
+    auto get_height = [&terrain](int x, int y) { return getHeightInWorldCoords(terrain, x, y); };
+    auto changed = TerrainModifier::relaxSlopes(heightmap, *m_slope_relaxation, get_height,
+        [&terrain](int x, int y, float value) { setHeightFromWorldCoords(terrain, x, y, value); },
+        region_diffs, diff_msgs);
+    logRelaxation(heightmap, get_height, region_diffs);
+
+    if (changed)
+    {
+      terrain->updateGeometry();
+      terrain->updateDerivedData(false, Ogre::Terrain::DERIVED_DATA_NORMALS | Ogre::Terrain::DERIVED_DATA_LIGHTMAP);
+
+      for (const auto& diff_msg : diff_msgs)
+        publishDifferential(diff_msg);
+      updateTerrainMirror(region_diffs, get_height);
     }
   }
 
-  void onModifyTerrainCircleMsg(const modify_terrain_circle::ConstPtr& msg) override
+  function<float(int, int)> getHeightAccessor(Heightmap* heightmap) override
+  {
+    auto terrain = heightmap->OgreTerrain()->getTerrain(0, 0);
+    return [terrain](int x, int y) { return getHeightInWorldCoords(terrain, x, y); };
+  }
+
+  void onModifyTerrainCircleMsg(const modify_terrain_circle::ConstPtr& msg, bool shared) override
   {
-    onModifyTerrainMsg(msg, TerrainModifier::modifyCircle);
+    onModifyTerrainMsg(msg, shared, TerrainModifier::prepareCircle);
   }
 
-  void onModifyTerrainEllipseMsg(const modify_terrain_ellipse::ConstPtr& msg) override
+  void onModifyTerrainEllipseMsg(const modify_terrain_ellipse::ConstPtr& msg, bool shared) override
   {
-    onModifyTerrainMsg(msg, TerrainModifier::modifyEllipse);
+    onModifyTerrainMsg(msg, shared, TerrainModifier::prepareEllipse);
   }
 
-  void onModifyTerrainPatchMsg(const modify_terrain_patch::ConstPtr& msg) override
+  void onModifyTerrainPatchMsg(const modify_terrain_patch::ConstPtr& msg, bool shared) override
   {
-    onModifyTerrainMsg(msg, TerrainModifier::modifyPatch);
+    onModifyTerrainMsg(msg, shared, TerrainModifier::preparePatch);
   }
 };
 
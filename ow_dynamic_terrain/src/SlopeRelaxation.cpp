@@ -0,0 +1,254 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#include <algorithm>
+#include <cmath>
+#include "SIMD_Util.h"
+#include "SlopeRelaxation.h"
+
+using namespace std;
+using namespace ow_dynamic_terrain;
+
+constexpr float SlopeRelaxation::RELAXATION_RATE;
+constexpr float SlopeRelaxation::TOLERANCE;
+
+static constexpr float PI = 3.14159265358979f;
+
+static bool touches(const SlopeRelaxation::Region& a, const SlopeRelaxation::Region& b)
+{
+  return a.x <= b.x + b.width && b.x <= a.x + a.width && a.y <= b.y + b.height && b.y <= a.y + a.height;
+}
+
+static SlopeRelaxation::Region unite(const SlopeRelaxation::Region& a, const SlopeRelaxation::Region& b)
+{
+  auto x = min(a.x, b.x), y = min(a.y, b.y);
+  return { x, y, max(a.x + a.width, b.x + b.width) - x, max(a.y + a.height, b.y + b.height) - y };
+}
+
+static float horizontalMax(const simd::float4& value)
+{
+  float lanes[4];
+  value.store(lanes);
+  return *max_element(lanes, lanes + 4);
+}
+
+// Returns the amount of material moved from the cell at height a to its neighbor at height b. The flux is positive
+// when material moves from a to b and only non-zero when the height difference exceeds max_dh in either direction.
+template <typename T>
+static T slopeFlux(const T& a, const T& b, const T& max_dh, T& max_excess)
+{
+  auto dh = a - b;
+  auto pos = simd::max(dh - max_dh, T(0.0f));
+  auto neg = simd::min(dh + max_dh, T(0.0f));
+  max_excess = simd::max(max_excess, pos - neg);
+  return T(SlopeRelaxation::RELAXATION_RATE) * (pos + neg);
+}
+
+SlopeRelaxation::SlopeRelaxation(float angle_of_repose, int max_cells_per_update, int max_spread,
+                                 int max_region_size)
+  : m_tan_angle_of_repose(tanf(angle_of_repose * PI / 180.0f))
+  , m_max_cells_per_update(max_cells_per_update)
+  , m_max_spread(max(0, max_spread))
+  // a region must fit within the budget of a single update otherwise it would never be processed
+  , m_max_region_size(max(2, min(max_region_size, static_cast<int>(sqrt(max_cells_per_update)))))
+{
+}
+
+void SlopeRelaxation::activate(const Region& region)
+{
+  // the slopes between a modified region and the cells bordering it have changed as well
+  if (region.width <= 0 || region.height <= 0)
+    return;
+
+  Region padded = { region.x - 1, region.y - 1, region.width + 2, region.height + 2 };
+  auto spread = m_max_spread;
+  insert({ padded, { padded.x - spread, padded.y - spread, padded.width + 2 * spread, padded.height + 2 * spread } });
+}
+
+void SlopeRelaxation::insert(const ActiveRegion& active_region)
+{
+  auto merged = active_region.region;
+  auto bounds = active_region.bounds;
+  for (auto it = m_regions.begin(); it != m_regions.end();)
+  {
+    if (touches(it->region, merged))
+    {
+      merged = unite(it->region, merged);
+      bounds = unite(it->bounds, bounds);
+      it = m_regions.erase(it);
+      it = m_regions.begin();  // the grown region may now touch regions that were skipped
+    }
+    else
+      ++it;
+  }
+
+  // very large edits are split into tiles that fit the size limit; neighboring tiles overlap by one cell so that the
+  // edges between them are relaxed as well
+  auto step = m_max_region_size - 1;
+  for (auto y = merged.y; y == merged.y || y + 1 < merged.y + merged.height; y += step)
+    for (auto x = merged.x; x == merged.x || x + 1 < merged.x + merged.width; x += step)
+      m_regions.push_back({ { x, y, min(m_max_region_size, merged.x + merged.width - x),
+                              min(m_max_region_size, merged.y + merged.height - y) },
+                            bounds });
+}
+
+float SlopeRelaxation::relaxIteration(vector<float>& heights, int width, int height, float max_height_difference,
+                                      vector<float>& delta)
+{
+  using simd::float4;
+
+  fill(delta.begin(), delta.end(), 0.0f);
+  auto max_dh = float4(max_height_difference);
+  auto max_excess = float4(0.0f);
+  auto max_excess_tail = 0.0f;
+
+  // edges between horizontal neighbors; the four lane store to d + c + 1 overlaps the store to d + c, so the two are
+  // done in sequence to accumulate both contributions of each cell
+  for (auto r = 0; r < height; ++r)
+  {
+    auto h = &heights[r * width];
+    auto d = &delta[r * width];
+    auto c = 0;
+    for (; c + 4 < width; c += 4)
+    {
+      auto flux = slopeFlux(float4::load(h + c), float4::load(h + c + 1), max_dh, max_excess);
+      (float4::load(d + c) - flux).store(d + c);
+      (float4::load(d + c + 1) + flux).store(d + c + 1);
+    }
+    for (; c + 1 < width; ++c)
+    {
+      auto flux = slopeFlux(h[c], h[c + 1], max_height_difference, max_excess_tail);
+      d[c] -= flux;
+      d[c + 1] += flux;
+    }
+  }
+
+  // edges between vertical neighbors
+  for (auto r = 0; r + 1 < height; ++r)
+  {
+    auto h0 = &heights[r * width], h1 = h0 + width;
+    auto d0 = &delta[r * width], d1 = d0 + width;
+    auto c = 0;
+    for (; c + 4 <= width; c += 4)
+    {
+      auto flux = slopeFlux(float4::load(h0 + c), float4::load(h1 + c), max_dh, max_excess);
+      (float4::load(d0 + c) - flux).store(d0 + c);
+      (float4::load(d1 + c) + flux).store(d1 + c);
+    }
+    for (; c < width; ++c)
+    {
+      auto flux = slopeFlux(h0[c], h1[c], max_height_difference, max_excess_tail);
+      d0[c] -= flux;
+      d1[c] += flux;
+    }
+  }
+
+  auto i = size_t(0);
+  for (; i + 4 <= heights.size(); i += 4)
+    (float4::load(&heights[i]) + float4::load(&delta[i])).store(&heights[i]);
+  for (; i < heights.size(); ++i)
+    heights[i] += delta[i];
+
+  return max(horizontalMax(max_excess), max_excess_tail);
+}
+
+bool SlopeRelaxation::update(int heightmap_size, float cell_size, const function<float(int, int)>& get_height_value,
+                             const function<void(int, int, float)>& set_height_value, vector<RegionDiff>& out_diffs)
+{
+  auto max_height_difference = m_tan_angle_of_repose * cell_size;
+  auto tolerance = TOLERANCE * max_height_difference;
+  auto budget = m_max_cells_per_update;
+  auto changed = false;
+  vector<ActiveRegion> deferred, processed;
+
+  for (const auto& active_region : m_regions)
+  {
+    // clip against the heightmap as regions may have been activated or grown past its edges
+    const auto& bounds = active_region.bounds;
+    auto x0 = max(active_region.region.x, 0), y0 = max(active_region.region.y, 0);
+    auto x1 = min(active_region.region.x + active_region.region.width, heightmap_size);
+    auto y1 = min(active_region.region.y + active_region.region.height, heightmap_size);
+    auto width = x1 - x0, height = y1 - y0;
+    if (width < 1 || height < 1)
+      continue;  // retire regions that fell outside the heightmap
+    Region region = { x0, y0, width, height };
+
+    auto area = width * height;
+    if (area > budget)
+    {
+      deferred.push_back({ region, bounds });
+      continue;
+    }
+
+    m_heights.resize(area);
+    m_delta.resize(area);
+    for (auto y = 0; y < height; ++y)
+      for (auto x = 0; x < width; ++x)
+        m_heights[y * width + x] = get_height_value(x0 + x, y0 + y);
+    m_original = m_heights;
+
+    // material that reached the border of the region may destabilize the cells beyond it
+    auto significant = RELAXATION_RATE * tolerance;
+    auto moved = [&](int i) { return fabsf(m_delta[i]) > significant; };
+    auto settled = false;
+    auto grow_left = false, grow_right = false, grow_top = false, grow_bottom = false;
+    while (!settled && area <= budget)
+    {
+      auto max_excess = relaxIteration(m_heights, width, height, max_height_difference, m_delta);
+      budget -= area;
+      settled = max_excess < tolerance;
+      for (auto y = 0; y < height; ++y)
+      {
+        grow_left |= moved(y * width);
+        grow_right |= moved(y * width + width - 1);
+      }
+      for (auto x = 0; x < width; ++x)
+      {
+        grow_top |= moved(x);
+        grow_bottom |= moved((height - 1) * width + x);
+      }
+    }
+
+    RegionDiff region_diff{ region, vector<float>(area, 0.0f), {} };
+    auto region_changed = false;
+    for (auto y = 0; y < height; ++y)
+      for (auto x = 0; x < width; ++x)
+      {
+        auto i = y * width + x;
+        auto diff = m_heights[i] - m_original[i];
+        if (diff == 0.0f)
+          continue;
+        set_height_value(x0 + x, y0 + y, m_heights[i]);
+        region_diff.diff[i] = diff;
+        region_changed = true;
+      }
+
+    if (region_changed)
+    {
+      region_diff.heights = m_heights;
+      out_diffs.push_back(move(region_diff));
+      changed = true;
+    }
+
+    // a side grows when material reached it, unless that would exceed the bounds or the size limit of the region
+    auto grow = [this](bool flag, int extent, bool within_bounds) {
+      return flag && within_bounds && extent < m_max_region_size ? 1 : 0;
+    };
+    auto left = grow(grow_left, width, x0 > bounds.x), top = grow(grow_top, height, y0 > bounds.y);
+    auto right = grow(grow_right, width + left, x1 < bounds.x + bounds.width);
+    auto bottom = grow(grow_bottom, height + top, y1 < bounds.y + bounds.height);
+    if (settled && left + right + top + bottom == 0)
+      continue;  // retire settled regions that have nowhere left to spread
+    processed.push_back({ { x0 - left, y0 - top, width + left + right, height + top + bottom }, bounds });
+  }
+
+  // regions that were deferred for lack of budget are served first on the next update
+  m_regions.clear();
+  for (const auto& region : deferred)
+    insert(region);
+  for (const auto& region : processed)
+    insert(region);
+
+  return changed;
+}
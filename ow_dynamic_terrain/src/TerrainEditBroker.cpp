@@ -0,0 +1,58 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#include <algorithm>
+#include "TerrainEditBroker.h"
+
+using namespace std;
+using namespace ow_dynamic_terrain;
+
+constexpr size_t TerrainEditBroker::MAX_ENTRIES;
+
+TerrainEditBroker& TerrainEditBroker::instance()
+{
+  static TerrainEditBroker broker;
+  return broker;
+}
+
+void TerrainEditBroker::registerConsumer()
+{
+  lock_guard<mutex> lock(m_mutex);
+  ++m_consumers;
+}
+
+void TerrainEditBroker::unregisterConsumer()
+{
+  lock_guard<mutex> lock(m_mutex);
+  m_consumers = max(m_consumers - 1, 0);
+  m_entries.clear();
+}
+
+shared_ptr<TerrainEdit> TerrainEditBroker::acquire(const boost::shared_ptr<const void>& msg,
+                                                   const function<bool(TerrainEdit&)>& prepare_edit)
+{
+  lock_guard<mutex> lock(m_mutex);
+
+  auto it = find_if(m_entries.begin(), m_entries.end(), [&msg](const Entry& e) { return e.msg == msg; });
+  if (it != m_entries.end())
+  {
+    auto edit = it->edit;
+    if (--it->pending_consumers <= 0)
+      m_entries.erase(it);
+    return edit;
+  }
+
+  auto edit = make_shared<TerrainEdit>();
+  if (!prepare_edit(*edit))
+    edit = nullptr;  // other consumers will skip the message as well instead of repeating the failure
+
+  if (m_consumers > 1)
+  {
+    if (m_entries.size() >= MAX_ENTRIES)
+      m_entries.pop_front();
+    m_entries.push_back({ msg, edit, m_consumers - 1 });
+  }
+
+  return edit;
+}
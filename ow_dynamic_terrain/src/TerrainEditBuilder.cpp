@@ -0,0 +1,202 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#include <cmath>
+#include <cv_bridge/cv_bridge.h>
+#include <sensor_msgs/image_encodings.h>
+#include "OpenCV_Util.h"
+#include "TerrainBrush.h"
+#include "TerrainEditBuilder.h"
+
+using namespace std;
+using namespace cv;
+using namespace cv_bridge;
+using namespace sensor_msgs;
+using namespace ow_dynamic_terrain;
+
+// rotations are skipped for orientations that are practically zero
+static const float ORIENTATION_EPSILON = 1e-6f;
+
+static bool resolveMergeMethod(const string& merge_method_name, TerrainEdit& out_edit, string& out_error)
+{
+  auto merge_method = MergeMethods::mergeMethodFromString(merge_method_name != "" ? merge_method_name : "add");
+  if (!merge_method)
+  {
+    out_error = "merge method [" + merge_method_name + "] is unsupported!";
+    return false;
+  }
+
+  out_edit.merge_method = *merge_method;
+  return true;
+}
+
+static optional<TerrainBrush::FalloffMethod> resolveFalloffMethod(const string& falloff_name, string& out_error)
+{
+  auto falloff_method = TerrainBrush::falloffMethodFromString(falloff_name != "" ? falloff_name : "quadratic");
+  if (!falloff_method)
+    out_error = "falloff [" + falloff_name + "] is unsupported!";
+  return falloff_method;
+}
+
+static Mat rotate(const Mat& image, float orientation)
+{
+  if (fabsf(orientation) <= ORIENTATION_EPSILON)  // Avoid performing the rotation if orientation is zero
+    return image;
+
+  auto expanded = OpenCV_Util::expandImage(image);  // expand the image to hold rotation output with no loss
+  return OpenCV_Util::rotateImage(expanded, orientation);
+}
+
+bool TerrainEditBuilder::buildCircle(const modify_terrain_circle& msg, float h_scale, TerrainEdit& out_edit,
+                                     string& out_error)
+{
+  if (msg.outer_radius <= 0.0f)
+  {
+    out_error = "outer_radius has to be a positive number!";
+    return false;
+  }
+
+  if (msg.inner_radius > msg.outer_radius)
+  {
+    out_error = "inner_radius can't exceed outer_radius value!";
+    return false;
+  }
+
+  if (!resolveMergeMethod(msg.merge_method, out_edit, out_error))
+    return false;
+
+  auto falloff_method = resolveFalloffMethod(msg.falloff, out_error);
+  if (!falloff_method)
+    return false;
+
+  out_edit.op_name = "circle";
+  out_edit.position = msg.position;
+  out_edit.h_scale = h_scale;
+  out_edit.image = falloff_method->circle(h_scale * msg.outer_radius, h_scale * msg.inner_radius, msg.weight);
+
+  return true;
+}
+
+bool TerrainEditBuilder::buildEllipse(const modify_terrain_ellipse& msg, float h_scale, TerrainEdit& out_edit,
+                                      string& out_error)
+{
+  if (msg.outer_radius_a <= 0.0f || msg.outer_radius_b <= 0.0f)
+  {
+    out_error = "outer_radius a & b has to be positive!";
+    return false;
+  }
+
+  if (msg.inner_radius_a > msg.outer_radius_a || msg.inner_radius_b > msg.outer_radius_b)
+  {
+    out_error = "inner_radius can't exceed outer_radius value!";
+    return false;
+  }
+
+  if (!resolveMergeMethod(msg.merge_method, out_edit, out_error))
+    return false;
+
+  auto falloff_method = resolveFalloffMethod(msg.falloff, out_error);
+  if (!falloff_method)
+    return false;
+
+  auto image = falloff_method->ellipse(h_scale * msg.outer_radius_a, h_scale * msg.inner_radius_a,
+                                       h_scale * msg.outer_radius_b, h_scale * msg.inner_radius_b, msg.weight);
+
+  out_edit.op_name = "ellipse";
+  out_edit.position = msg.position;
+  out_edit.h_scale = h_scale;
+  out_edit.image = rotate(image, msg.orientation);
+
+  return true;
+}
+
+bool TerrainEditBuilder::buildPatch(const modify_terrain_patch& msg, float h_scale, TerrainEdit& out_edit,
+                                    string& out_error)
+{
+  if (!resolveMergeMethod(msg.merge_method, out_edit, out_error))
+    return false;
+
+  if (msg.patch.encoding != "32FC1")
+  {
+    out_error = "Only 32FC1 formats are supported";
+    return false;
+  }
+
+  // the image is copied rather than shared with the message as the edit may outlive the message
+  auto image_handle = CvImagePtr();
+  try
+  {
+    image_handle = toCvCopy(msg.patch, image_encodings::TYPE_32FC1);  // Using single precision (32-bit) float
+                                                                      // same as the heightmap
+  }
+  catch (cv_bridge::Exception& e)
+  {
+    out_error = string("cv_bridge exception: ") + e.what();
+    return false;
+  }
+
+  out_edit.op_name = "patch";
+  out_edit.position = msg.position;
+  out_edit.h_scale = h_scale;
+  out_edit.image = rotate(image_handle->image, msg.orientation);
+
+  return true;
+}
+
+Rect TerrainEditBuilder::getEditRegion(int heightmap_size, const TerrainEdit& edit)
+{
+  auto image_rect = Rect(edit.center.x - edit.image.cols / 2, edit.center.y - edit.image.rows / 2, edit.image.cols,
+                         edit.image.rows);
+  return image_rect & Rect(0, 0, heightmap_size, heightmap_size);
+}
+
+bool TerrainEditBuilder::mergeEdit(int heightmap_size, TerrainEdit& edit,
+                                   const function<float(int, int)>& get_height_value,
+                                   const function<void(int, int, float)>& set_height_value, Mat& out_diff)
+{
+  const auto& image = edit.image;
+
+  // image origin in heightmap coordinates (may fall outside the heightmap)
+  auto left = edit.center.x - image.cols / 2;
+  auto top = edit.center.y - image.rows / 2;
+  auto region = getEditRegion(heightmap_size, edit);
+
+  auto z_bias = edit.position.z;
+  out_diff = OpenCV_Util::createZerosMatLike(image);
+
+  // record the heights around the edit so other aspects of the terrain can reuse the merge
+  auto record = !edit.merged;
+  if (record)
+  {
+    edit.old_heights = OpenCV_Util::createZerosMatLike(image);
+    edit.new_heights = OpenCV_Util::createZerosMatLike(image);
+  }
+
+  bool change_occurred = false;
+
+  for (auto y = region.y; y < region.y + region.height; ++y)
+    for (auto x = region.x; x < region.x + region.width; ++x)
+    {
+      auto pixel_value = image.at<float>(y - top, x - left);
+      auto old_height = get_height_value(x, y);
+      auto new_height = edit.merge_method(old_height, pixel_value + z_bias);
+
+      if (record)
+      {
+        edit.old_heights.at<float>(y - top, x - left) = old_height;
+        edit.new_heights.at<float>(y - top, x - left) = new_height;
+      }
+
+      if (old_height == new_height)
+        continue;  // no change is necessary
+
+      set_height_value(x, y, new_height);
+      out_diff.at<float>(y - top, x - left) = new_height - old_height;
+
+      // if we make it here, flag that a change has occurred
+      change_occurred = true;
+    }
+
+  return change_occurred;
+}
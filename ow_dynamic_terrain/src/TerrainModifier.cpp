@@ -6,9 +6,7 @@
 #include <sensor_msgs/image_encodings.h>
 #include <gazebo/common/Assert.hh>
 #include <gazebo/common/Console.hh>
-#include "MergeMethods.h"
-#include "OpenCV_Util.h"
-#include "TerrainBrush.h"
+#include "TerrainEditBuilder.h"
 #include "TerrainModifier.h"
 
 using namespace std;
@@ -40,26 +38,41 @@ bool TerrainModifier::modifyCircle(Heightmap* heightmap, const modify_terrain_ci
                                    const function<void(int, int, float)>& set_height_value,
                                    ow_dynamic_terrain::modified_terrain_diff& out_diff_msg)
 {
-  GZ_ASSERT(heightmap != nullptr, "heightmap is null!");
-
-  if (msg->outer_radius <= 0.0f)
-  {
-    gzerr << "DynamicTerrain: outer_radius has to be a positive number!" << endl;
+  TerrainEdit edit;
+  if (!prepareCircle(heightmap, msg, edit))
     return false;
-  }
 
-  if (msg->inner_radius > msg->outer_radius)
-  {
-    gzerr << "DynamicTerrain: inner_radius can't exceed outer_radius value!" << endl;
+  return applyEdit(heightmap, edit, get_height_value, set_height_value, out_diff_msg);
+}
+
+bool TerrainModifier::modifyEllipse(Heightmap* heightmap, const modify_terrain_ellipse::ConstPtr& msg,
+                                    const function<float(int, int)>& get_height_value,
+                                    const function<void(int, int, float)>& set_height_value,
+                                    ow_dynamic_terrain::modified_terrain_diff& out_diff_msg)
+{
+  TerrainEdit edit;
+  if (!prepareEllipse(heightmap, msg, edit))
     return false;
-  }
 
-  auto merge_method = MergeMethods::mergeMethodFromString(msg->merge_method != "" ? msg->merge_method : "add");
-  if (!merge_method)
-  {
-    gzerr << "DynamicTerrain: merge method [" << msg->merge_method << "] is unsupported!" << endl;
+  return applyEdit(heightmap, edit, get_height_value, set_height_value, out_diff_msg);
+}
+
+bool TerrainModifier::modifyPatch(Heightmap* heightmap, const modify_terrain_patch::ConstPtr& msg,
+                                  const function<float(int, int)>& get_height_value,
+                                  const function<void(int, int, float)>& set_height_value,
+                                  ow_dynamic_terrain::modified_terrain_diff& out_diff_msg)
+{
+  TerrainEdit edit;
+  if (!preparePatch(heightmap, msg, edit))
     return false;
-  }
+
+  return applyEdit(heightmap, edit, get_height_value, set_height_value, out_diff_msg);
+}
+
+bool TerrainModifier::prepareCircle(Heightmap* heightmap, const modify_terrain_circle::ConstPtr& msg,
+                                    TerrainEdit& out_edit)
+{
+  GZ_ASSERT(heightmap != nullptr, "heightmap is null!");
 
   auto terrain = heightmap->OgreTerrain()->getTerrain(0, 0);
 
@@ -69,48 +82,25 @@ bool TerrainModifier::modifyCircle(Heightmap* heightmap, const modify_terrain_ci
     return false;
   }
 
-  auto center = TerrainModifier::getHeightmapPosition(heightmap, msg->position);
   auto h_scale = terrain->getSize() / terrain->getWorldSize();  // horizontal scale factor
-  auto image = TerrainBrush::circle(h_scale * msg->outer_radius, h_scale * msg->inner_radius, msg->weight);
 
-  CvImage differential_image;
-  auto changed = applyImageToHeightmap(heightmap, center, msg->position.z, image, false, 
-                                       get_height_value, set_height_value, *merge_method,
-                                       differential_image);
+  string error;
+  if (!TerrainEditBuilder::buildCircle(*msg, h_scale, out_edit, error))
+  {
+    gzerr << "DynamicTerrain: " << error << endl;
+    return false;
+  }
 
-  if (changed)
-    formatDiffMsg(differential_image, msg->position, h_scale,
-                  image.rows, image.cols, "circle", out_diff_msg);
+  out_edit.center = TerrainModifier::getHeightmapPosition(heightmap, msg->position);
 
-  return changed;
+  return true;
 }
 
-bool TerrainModifier::modifyEllipse(Heightmap* heightmap, const modify_terrain_ellipse::ConstPtr& msg,
-                                    const function<float(int, int)>& get_height_value,
-                                    const function<void(int, int, float)>& set_height_value,
-                                    ow_dynamic_terrain::modified_terrain_diff& out_diff_msg)
+bool TerrainModifier::prepareEllipse(Heightmap* heightmap, const modify_terrain_ellipse::ConstPtr& msg,
+                                     TerrainEdit& out_edit)
 {
   GZ_ASSERT(heightmap != nullptr, "heightmap is null!");
 
-  if (msg->outer_radius_a <= 0.0f || msg->outer_radius_b <= 0.0f)
-  {
-    gzerr << "DynamicTerrain: outer_radius a & b has to be positive!" << endl;
-    return false;
-  }
-
-  if (msg->inner_radius_a > msg->outer_radius_a || msg->inner_radius_b > msg->outer_radius_b)
-  {
-    gzerr << "DynamicTerrain: inner_radius can't exceed outer_radius value!" << endl;
-    return false;
-  }
-
-  auto merge_method = MergeMethods::mergeMethodFromString(msg->merge_method != "" ? msg->merge_method : "add");
-  if (!merge_method)
-  {
-    gzerr << "DynamicTerrain: merge method [" << msg->merge_method << "] is unsupported!" << endl;
-    return false;
-  }
-
   auto terrain = heightmap->OgreTerrain()->getTerrain(0, 0);
 
   if (!terrain)
@@ -119,45 +109,25 @@ bool TerrainModifier::modifyEllipse(Heightmap* heightmap, const modify_terrain_e
     return false;
   }
 
-  auto center = TerrainModifier::getHeightmapPosition(heightmap, msg->position);
-
   auto h_scale = terrain->getSize() / terrain->getWorldSize();  // horizontal scale factor
-  auto image =
-      TerrainBrush::ellipse(h_scale * msg->outer_radius_a, h_scale * msg->inner_radius_a,
-                            h_scale * msg->outer_radius_b, h_scale * msg->inner_radius_b, msg->weight);
 
-  if (!ignition::math::equal<float>(msg->orientation, 0.0f))  // Avoid performing the rotation if orientation is zero
+  string error;
+  if (!TerrainEditBuilder::buildEllipse(*msg, h_scale, out_edit, error))
   {
-    image = OpenCV_Util::expandImage(image);  // expand the image to hold rotation output with no loss
-    image = OpenCV_Util::rotateImage(image, msg->orientation);
+    gzerr << "DynamicTerrain: " << error << endl;
+    return false;
   }
 
-  cv_bridge::CvImage differential_image;
-  auto changed = applyImageToHeightmap(heightmap, center, msg->position.z, image, false, 
-                                       get_height_value, set_height_value, *merge_method,
-                                       differential_image);
-
-  if (changed)
-    formatDiffMsg(differential_image, msg->position, h_scale,
-                  image.rows, image.cols, "ellipse", out_diff_msg);
+  out_edit.center = TerrainModifier::getHeightmapPosition(heightmap, msg->position);
 
-  return changed;
+  return true;
 }
 
-bool TerrainModifier::modifyPatch(Heightmap* heightmap, const modify_terrain_patch::ConstPtr& msg,
-                                  const function<float(int, int)>& get_height_value,
-                                  const function<void(int, int, float)>& set_height_value,
-                                  ow_dynamic_terrain::modified_terrain_diff& out_diff_msg)
+bool TerrainModifier::preparePatch(Heightmap* heightmap, const modify_terrain_patch::ConstPtr& msg,
+                                   TerrainEdit& out_edit)
 {
   GZ_ASSERT(heightmap != nullptr, "heightmap is null!");
 
-  auto merge_method = MergeMethods::mergeMethodFromString(msg->merge_method != "" ? msg->merge_method : "add");
-  if (!merge_method)
-  {
-    gzerr << "DynamicTerrain: merge method [" << msg->merge_method << "] is unsupported!" << endl;
-    return false;
-  }
-
   auto terrain = heightmap->OgreTerrain()->getTerrain(0, 0);
 
   if (!terrain)
@@ -166,37 +136,50 @@ bool TerrainModifier::modifyPatch(Heightmap* heightmap, const modify_terrain_pat
     return false;
   }
 
-  if (msg->patch.encoding != "32FC1")
-  {
-    gzerr << "DynamicTerrain: Only 32FC1 formats are supported" << endl;
-    return false;
-  }
-
-  auto center = TerrainModifier::getHeightmapPosition(heightmap, msg->position);
   auto h_scale = terrain->getSize() / terrain->getWorldSize();  // horizontal scale factor
 
-  auto image_handle = TerrainModifier::importImageToOpenCV(msg);
-  if (image_handle == nullptr)
+  string error;
+  if (!TerrainEditBuilder::buildPatch(*msg, h_scale, out_edit, error))
   {
-    gzerr << "DynamicTerrain: Failed to convert ROS image" << endl;
+    gzerr << "DynamicTerrain: " << error << endl;
     return false;
   }
 
-  auto image = image_handle->image;
-  if (!ignition::math::equal<float>(msg->orientation, 0.0f))  // Avoid performing the rotation if orientation is zero
+  out_edit.center = TerrainModifier::getHeightmapPosition(heightmap, msg->position);
+
+  return true;
+}
+
+bool TerrainModifier::applyEdit(Heightmap* heightmap, TerrainEdit& edit,
+                                const function<float(int, int)>& get_height_value,
+                                const function<void(int, int, float)>& set_height_value,
+                                ow_dynamic_terrain::modified_terrain_diff& out_diff_msg)
+{
+  GZ_ASSERT(heightmap != nullptr, "heightmap is null!");
+
+  std::lock_guard<std::mutex> lock(edit.mutex);
+
+  if (edit.merged && reuseMergedHeights(heightmap, edit, get_height_value, set_height_value))
   {
-    image = OpenCV_Util::expandImage(image);  // expand the image to hold rotation output with no loss
-    image = OpenCV_Util::rotateImage(image, msg->orientation);
+    if (edit.changed)
+      out_diff_msg = edit.diff_msg;
+    return edit.changed;
   }
 
-  cv_bridge::CvImage differential_image;
-  auto changed = applyImageToHeightmap(heightmap, center, msg->position.z, image, false, 
-                                       get_height_value, set_height_value, *merge_method,
-                                       differential_image);
+  CvImage differential_image;
+  auto changed = applyImageToHeightmap(heightmap, edit, get_height_value, set_height_value, differential_image);
 
   if (changed)
-    formatDiffMsg(differential_image, msg->position, h_scale,
-                  image.rows, image.cols, "patch", out_diff_msg);
+    formatDiffMsg(differential_image, edit.position, edit.h_scale,
+                  edit.image.rows, edit.image.cols, edit.op_name, out_diff_msg);
+
+  if (!edit.merged)
+  {
+    edit.merged = true;
+    edit.changed = changed;
+    if (changed)
+      edit.diff_msg = out_diff_msg;
+  }
 
   return changed;
 }
@@ -211,71 +194,180 @@ Point2i TerrainModifier::getHeightmapPosition(Heightmap* heightmap, const geomet
   return Point2i(lroundf(heightmap_size * heightmap_position.x), lroundf(heightmap_size * heightmap_position.y));
 }
 
-CvImageConstPtr TerrainModifier::importImageToOpenCV(const modify_terrain_patch::ConstPtr& msg)
+Point32 TerrainModifier::getWorldPosition(Heightmap* heightmap, const Point2i& position)
+{
+  auto terrain = heightmap->OgreTerrain()->getTerrain(0, 0);
+  auto heightmap_size = static_cast<Real>(terrain->getSize());
+  auto world_position = Vector3();
+  terrain->getPosition(Vector3(position.x / heightmap_size, position.y / heightmap_size, 0), &world_position);
+  Point32 result;
+  result.x = world_position.x;
+  result.y = world_position.y;
+  result.z = 0;
+  return result;
+}
+
+cv::Rect TerrainModifier::getEditRegion(Heightmap* heightmap, const TerrainEdit& edit)
+{
+  auto terrain = heightmap->OgreTerrain()->getTerrain(0, 0);
+  return TerrainEditBuilder::getEditRegion(static_cast<int>(terrain->getSize()), edit);
+}
+
+bool TerrainModifier::relaxSlopes(Heightmap* heightmap, SlopeRelaxation& slope_relaxation,
+                                  const function<float(int, int)>& get_height_value,
+                                  const function<void(int, int, float)>& set_height_value,
+                                  vector<SlopeRelaxation::RegionDiff>& out_region_diffs,
+                                  vector<ow_dynamic_terrain::modified_terrain_diff>& out_diff_msgs)
 {
-  auto image_handle = CvImageConstPtr();
+  GZ_ASSERT(heightmap != nullptr, "heightmap is null!");
+
+  auto terrain = heightmap->OgreTerrain()->getTerrain(0, 0);
+  auto h_scale = terrain->getSize() / terrain->getWorldSize();  // horizontal scale factor
 
-  try
+  auto first = out_region_diffs.size();
+  auto changed = slope_relaxation.update(static_cast<int>(terrain->getSize()), 1.0f / h_scale, get_height_value,
+                                         set_height_value, out_region_diffs);
+
+  for (auto i = first; i < out_region_diffs.size(); ++i)
   {
-    image_handle = toCvShare(msg->patch, msg, image_encodings::TYPE_32FC1);  // Using single precision (32-bit) float
-                                                                             // same as the heightmap
+    auto& region_diff = out_region_diffs[i];
+    const auto& region = region_diff.region;
+    CvImage differential_image;
+    differential_image.image = Mat(region.height, region.width, CV_32FC1, region_diff.diff.data());
+    differential_image.encoding = image_encodings::TYPE_32FC1;
+
+    // the position of a differential refers to the center pixel of its image, same as the modify operations
+    auto position = getWorldPosition(heightmap, Point2i(region.x + region.width / 2, region.y + region.height / 2));
+
+    out_diff_msgs.emplace_back();
+    formatDiffMsg(differential_image, position, h_scale, region.height, region.width, "relax", out_diff_msgs.back());
   }
-  catch (cv_bridge::Exception& e)
+
+  return changed;
+}
+
+void TerrainModifier::mergeDiffMsgs(Heightmap* heightmap, const vector<modified_terrain_diff>& diff_msgs,
+                                    vector<modified_terrain_diff>& out_diff_msgs)
+{
+  GZ_ASSERT(heightmap != nullptr, "heightmap is null!");
+
+  auto terrain = heightmap->OgreTerrain()->getTerrain(0, 0);
+  auto h_scale = terrain->getSize() / terrain->getWorldSize();  // horizontal scale factor
+
+  struct DiffGroup
+  {
+    Rect region;             // union of the images of the group in heightmap coordinates
+    vector<size_t> members;  // indices into diff_msgs
+  };
+
+  auto image_region = [heightmap](const modified_terrain_diff& diff_msg) {
+    auto center = getHeightmapPosition(heightmap, diff_msg.position);
+    auto cols = static_cast<int>(diff_msg.diff.width);
+    auto rows = static_cast<int>(diff_msg.diff.height);
+    return Rect(center.x - cols / 2, center.y - rows / 2, cols, rows);
+  };
+
+  auto touches = [](const Rect& a, const Rect& b) {
+    return (Rect(a.x - 1, a.y - 1, a.width + 2, a.height + 2) & b).area() > 0;
+  };
+
+  vector<DiffGroup> groups;
+  for (size_t i = 0; i < diff_msgs.size(); ++i)
   {
-    gzerr << "DynamicTerrain: cv_bridge exception: %s" << e.what() << endl;
-    return nullptr;
+    DiffGroup group{ image_region(diff_msgs[i]), { i } };
+
+    // absorbing a group enlarges the region, which may then touch a group that was skipped before
+    for (auto absorbed = true; absorbed;)
+    {
+      absorbed = false;
+      for (auto it = groups.begin(); it != groups.end(); ++it)
+      {
+        if (!touches(it->region, group.region))
+          continue;
+        group.region |= it->region;
+        group.members.insert(group.members.end(), it->members.begin(), it->members.end());
+        groups.erase(it);
+        absorbed = true;
+        break;
+      }
+    }
+
+    groups.push_back(move(group));
   }
 
-  return image_handle;
+  for (auto& group : groups)
+  {
+    if (group.members.size() == 1)
+    {
+      out_diff_msgs.push_back(diff_msgs[group.members.front()]);
+      continue;
+    }
+
+    const auto& region = group.region;
+    CvImage differential_image;
+    differential_image.image = Mat::zeros(region.height, region.width, CV_32FC1);
+    differential_image.encoding = image_encodings::TYPE_32FC1;
+
+    for (auto i : group.members)
+    {
+      auto part = toCvShare(diff_msgs[i].diff, nullptr, image_encodings::TYPE_32FC1);
+      Mat target = differential_image.image(image_region(diff_msgs[i]) - region.tl());
+      target += part->image;
+    }
+
+    auto position = getWorldPosition(heightmap, Point2i(region.x + region.width / 2, region.y + region.height / 2));
+
+    out_diff_msgs.emplace_back();
+    differential_image.toImageMsg(out_diff_msgs.back().diff);
+    out_diff_msgs.back().position = position;
+    out_diff_msgs.back().height = region.height / h_scale;
+    out_diff_msgs.back().width = region.width / h_scale;
+  }
 }
 
-bool TerrainModifier::applyImageToHeightmap(Heightmap* heightmap, const Point2i& center, float z_bias,
-                                            const Mat& image, bool skip_zeros,
+bool TerrainModifier::applyImageToHeightmap(Heightmap* heightmap, TerrainEdit& edit,
                                             const function<float(int, int)>& get_height_value,
                                             const function<void(int, int, float)>& set_height_value,
-                                            const function<float(float, float)>& merge_method, 
                                             cv_bridge::CvImage& out_diff_image)
 {
-  auto terrain = heightmap->OgreTerrain()->getTerrain(0, 0);
-
-  if (image.type() != CV_32FC1)
+  if (edit.image.type() != CV_32FC1)
   {
     gzerr << "DynamicTerrain: Only 32FC1 formats are supported" << endl;
     return false;
   }
 
-  auto heightmap_size = static_cast<int>(terrain->getSize());
-  auto left = max(center.x - image.cols / 2, 0);
-  auto top = max(center.y - image.rows / 2, 0);
-  auto right = min(center.x - image.cols / 2 + image.cols - 1, heightmap_size);
-  auto bottom = min(center.y - image.rows / 2 + image.rows - 1, heightmap_size);
+  auto terrain = heightmap->OgreTerrain()->getTerrain(0, 0);
+  Mat diff;
+  auto change_occurred = TerrainEditBuilder::mergeEdit(static_cast<int>(terrain->getSize()), edit, get_height_value,
+                                                       set_height_value, diff);
+
+  out_diff_image.image    = diff;
+  out_diff_image.encoding = image_encodings::TYPE_32FC1;
 
-  auto diff = OpenCV_Util::createZerosMatLike(image);
+  return change_occurred;
+}
+
+bool TerrainModifier::reuseMergedHeights(Heightmap* heightmap, const TerrainEdit& edit,
+                                         const function<float(int, int)>& get_height_value,
+                                         const function<void(int, int, float)>& set_height_value)
+{
+  auto left = edit.center.x - edit.image.cols / 2;
+  auto top = edit.center.y - edit.image.rows / 2;
+  auto region = getEditRegion(heightmap, edit);
 
-  bool change_occurred = false;
+  for (auto y = region.y; y < region.y + region.height; ++y)
+    for (auto x = region.x; x < region.x + region.width; ++x)
+      if (get_height_value(x, y) != edit.old_heights.at<float>(y - top, x - left))
+        return false;  // this aspect of the terrain diverged from the one the edit was merged with
 
-  for (auto y = top; y <= bottom; ++y)
-    for (auto x = left; x <= right; ++x)
+  for (auto y = region.y; y < region.y + region.height; ++y)
+    for (auto x = region.x; x < region.x + region.width; ++x)
     {
-      auto pixel_value = image.at<float>(y - top, x - left);
-      if (skip_zeros && ignition::math::equal<float>(pixel_value, 0.0f))
-        continue;
-      
-      auto old_height = get_height_value(x, y);
-      auto new_height = merge_method(old_height, pixel_value + z_bias);
-
-      if (old_height == new_height) 
-        continue; // no change is necessary
-      
-      set_height_value(x, y, new_height);
-      diff.at<float>(y - top, x - left) = new_height - old_height;
-      
-      // if we make it here, flag that a change has occurred
-      change_occurred = true;
+      auto old_height = edit.old_heights.at<float>(y - top, x - left);
+      auto new_height = edit.new_heights.at<float>(y - top, x - left);
+      if (old_height != new_height)
+        set_height_value(x, y, new_height);
     }
-  
-    out_diff_image.image    = diff;
-    out_diff_image.encoding = image_encodings::TYPE_32FC1;
-  
-    return change_occurred;
+
+  return true;
 }
@@ -0,0 +1,197 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#include <cstring>
+#include <cv_bridge/cv_bridge.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/image_encodings.h>
+#include "TerrainEditBuilder.h"
+#include "TerrainOperationLog.h"
+
+using namespace std;
+using namespace cv;
+using namespace cv_bridge;
+using namespace ow_dynamic_terrain;
+
+static const char MAGIC[4] = { 'O', 'W', 'T', 'L' };
+static const uint32_t VERSION = 1;
+
+template <typename T>
+static void writeValue(ofstream& stream, const T& value)
+{
+  stream.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+static bool readValue(ifstream& stream, T& value)
+{
+  return static_cast<bool>(stream.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+bool TerrainOperationLogWriter::open(const string& path, int heightmap_size,
+                                     const function<float(int, int)>& get_height_value)
+{
+  m_stream.open(path, ios::binary | ios::trunc);
+  if (!m_stream)
+    return false;
+
+  vector<float> heights(heightmap_size * heightmap_size);
+  for (auto y = 0; y < heightmap_size; ++y)
+    for (auto x = 0; x < heightmap_size; ++x)
+      heights[y * heightmap_size + x] = get_height_value(x, y);
+
+  m_stream.write(MAGIC, sizeof(MAGIC));
+  writeValue(m_stream, VERSION);
+  writeValue(m_stream, static_cast<int32_t>(heightmap_size));
+  m_stream.write(reinterpret_cast<const char*>(heights.data()), heights.size() * sizeof(float));
+  m_stream.flush();
+
+  if (!m_stream)
+  {
+    m_stream.close();
+    return false;
+  }
+
+  return true;
+}
+
+void TerrainOperationLogWriter::writeRecord(TerrainOperationType type, double sim_time, const Point2i& center,
+                                            float h_scale)
+{
+  writeValue(m_stream, static_cast<uint8_t>(type));
+  writeValue(m_stream, sim_time);
+  writeValue(m_stream, static_cast<int32_t>(center.x));
+  writeValue(m_stream, static_cast<int32_t>(center.y));
+  writeValue(m_stream, h_scale);
+  writeValue(m_stream, static_cast<uint32_t>(m_payload.size()));
+  m_stream.write(reinterpret_cast<const char*>(m_payload.data()), m_payload.size());
+  m_stream.flush();
+}
+
+bool TerrainOperationLogReader::open(const string& path, string& out_error)
+{
+  m_stream.open(path, ios::binary);
+  if (!m_stream)
+  {
+    out_error = "couldn't open " + path;
+    return false;
+  }
+
+  char magic[sizeof(MAGIC)];
+  uint32_t version;
+  int32_t heightmap_size;
+  if (!m_stream.read(magic, sizeof(magic)) || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0)
+  {
+    out_error = path + " is not a terrain operation log";
+    return false;
+  }
+
+  if (!readValue(m_stream, version) || version != VERSION)
+  {
+    out_error = "unsupported terrain operation log version";
+    return false;
+  }
+
+  if (!readValue(m_stream, heightmap_size) || heightmap_size <= 0)
+  {
+    out_error = "invalid heightmap size";
+    return false;
+  }
+
+  m_heightmap_size = heightmap_size;
+  m_initial_heights.resize(heightmap_size * heightmap_size);
+  if (!m_stream.read(reinterpret_cast<char*>(m_initial_heights.data()), m_initial_heights.size() * sizeof(float)))
+  {
+    out_error = "log ended before the initial heights";
+    return false;
+  }
+
+  return true;
+}
+
+bool TerrainOperationLogReader::next(TerrainOperationRecord& out_record)
+{
+  uint8_t type;
+  int32_t center_x, center_y;
+  uint32_t payload_size;
+  if (!readValue(m_stream, type) || !readValue(m_stream, out_record.sim_time) || !readValue(m_stream, center_x) ||
+      !readValue(m_stream, center_y) || !readValue(m_stream, out_record.h_scale) ||
+      !readValue(m_stream, payload_size))
+    return false;
+
+  out_record.type = static_cast<TerrainOperationType>(type);
+  out_record.center = Point2i(center_x, center_y);
+  out_record.payload.resize(payload_size);
+  return static_cast<bool>(m_stream.read(reinterpret_cast<char*>(out_record.payload.data()), payload_size));
+}
+
+TerrainOperationReplay::TerrainOperationReplay(int heightmap_size, vector<float> heights)
+  : m_heightmap_size(heightmap_size), m_heights(move(heights))
+{
+}
+
+template <typename M, typename B>
+static bool replayEdit(const TerrainOperationRecord& record, int heightmap_size, vector<float>& heights, B build,
+                       string& out_error)
+{
+  M msg;
+  record.decode(msg);
+
+  TerrainEdit edit;
+  if (!build(msg, record.h_scale, edit, out_error))
+    return false;
+  edit.center = record.center;
+
+  Mat diff;
+  TerrainEditBuilder::mergeEdit(heightmap_size, edit,
+      [&](int x, int y) { return heights[y * heightmap_size + x]; },
+      [&](int x, int y, float value) { heights[y * heightmap_size + x] = value; },
+      diff);
+  return true;
+}
+
+bool TerrainOperationReplay::apply(const TerrainOperationRecord& record, string& out_error)
+{
+  try
+  {
+    switch (record.type)
+    {
+      case TerrainOperationType::Circle:
+        return replayEdit<modify_terrain_circle>(record, m_heightmap_size, m_heights, TerrainEditBuilder::buildCircle,
+                                                 out_error);
+      case TerrainOperationType::Ellipse:
+        return replayEdit<modify_terrain_ellipse>(record, m_heightmap_size, m_heights,
+                                                  TerrainEditBuilder::buildEllipse, out_error);
+      case TerrainOperationType::Patch:
+        return replayEdit<modify_terrain_patch>(record, m_heightmap_size, m_heights, TerrainEditBuilder::buildPatch,
+                                                out_error);
+      case TerrainOperationType::Relax:
+      {
+        sensor_msgs::Image msg;
+        record.decode(msg);
+        auto image = toCvCopy(msg, sensor_msgs::image_encodings::TYPE_32FC1)->image;
+        auto left = record.center.x - image.cols / 2;
+        auto top = record.center.y - image.rows / 2;
+        auto region = Rect(left, top, image.cols, image.rows) & Rect(0, 0, m_heightmap_size, m_heightmap_size);
+        for (auto y = region.y; y < region.y + region.height; ++y)
+          for (auto x = region.x; x < region.x + region.width; ++x)
+            m_heights[y * m_heightmap_size + x] = image.at<float>(y - top, x - left);
+        return true;
+      }
+    }
+  }
+  catch (ros::Exception& e)  // covers payloads that fail to deserialize
+  {
+    out_error = string("malformed record: ") + e.what();
+    return false;
+  }
+  catch (cv_bridge::Exception& e)
+  {
+    out_error = string("cv_bridge exception: ") + e.what();
+    return false;
+  }
+
+  out_error = "unknown operation type " + to_string(static_cast<int>(record.type));
+  return false;
+}
@@ -0,0 +1,111 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#include <algorithm>
+#include "TerrainTileMirror.h"
+
+using namespace std;
+using namespace ow_dynamic_terrain;
+
+mutex TerrainTileMirror::s_registry_mutex;
+map<string, shared_ptr<TerrainTileMirror>> TerrainTileMirror::s_registry;
+
+TerrainTileMirror::TerrainTileMirror(int heightmap_size, int tile_size,
+                                     const function<float(int, int)>& get_height_value)
+  : m_heightmap_size(heightmap_size)
+  , m_tile_size(max(tile_size, 1))
+  , m_tiles_per_side((heightmap_size + m_tile_size - 1) / m_tile_size)
+  , m_heights(heightmap_size * heightmap_size)
+  , m_tile_versions(m_tiles_per_side * m_tiles_per_side, 0)
+{
+  for (auto y = 0; y < heightmap_size; ++y)
+    for (auto x = 0; x < heightmap_size; ++x)
+      m_heights[y * heightmap_size + x] = get_height_value(x, y);
+}
+
+void TerrainTileMirror::update(int x, int y, int width, int height, const function<float(int, int)>& get_height_value)
+{
+  auto x0 = max(x, 0), y0 = max(y, 0);
+  auto x1 = min(x + width, m_heightmap_size), y1 = min(y + height, m_heightmap_size);
+  if (x0 >= x1 || y0 >= y1)
+    return;
+
+  // sample the terrain before taking the lock so readers are only held up by the copy
+  vector<float> heights((x1 - x0) * (y1 - y0));
+  for (auto r = y0; r < y1; ++r)
+    for (auto c = x0; c < x1; ++c)
+      heights[(r - y0) * (x1 - x0) + c - x0] = get_height_value(c, r);
+
+  unique_lock<shared_timed_mutex> lock(m_mutex);
+
+  for (auto r = y0; r < y1; ++r)
+    copy_n(&heights[(r - y0) * (x1 - x0)], x1 - x0, &m_heights[r * m_heightmap_size + x0]);
+
+  for (auto ty = y0 / m_tile_size; ty <= (y1 - 1) / m_tile_size; ++ty)
+    for (auto tx = x0 / m_tile_size; tx <= (x1 - 1) / m_tile_size; ++tx)
+      ++m_tile_versions[ty * m_tiles_per_side + tx];
+}
+
+uint64_t TerrainTileMirror::tileVersion(int tile_x, int tile_y) const
+{
+  shared_lock<shared_timed_mutex> lock(m_mutex);
+  return m_tile_versions[tile_y * m_tiles_per_side + tile_x];
+}
+
+void TerrainTileMirror::tileVersions(vector<uint64_t>& out_versions) const
+{
+  shared_lock<shared_timed_mutex> lock(m_mutex);
+  out_versions = m_tile_versions;
+}
+
+uint64_t TerrainTileMirror::readTile(int tile_x, int tile_y, int downsample, vector<float>& out_heights,
+                                     int& out_width, int& out_height) const
+{
+  downsample = max(downsample, 1);
+
+  auto x0 = tile_x * m_tile_size, y0 = tile_y * m_tile_size;
+  auto width = min(m_tile_size, m_heightmap_size - x0);
+  auto height = min(m_tile_size, m_heightmap_size - y0);
+  out_width = (width + downsample - 1) / downsample;
+  out_height = (height + downsample - 1) / downsample;
+  out_heights.resize(out_width * out_height);
+
+  shared_lock<shared_timed_mutex> lock(m_mutex);
+
+  for (auto r = 0; r < out_height; ++r)
+    for (auto c = 0; c < out_width; ++c)
+    {
+      // blocks along the far edges of a tile may be partial
+      auto sum = 0.0f;
+      auto count = 0;
+      for (auto y = y0 + r * downsample; y < min(y0 + (r + 1) * downsample, y0 + height); ++y)
+        for (auto x = x0 + c * downsample; x < min(x0 + (c + 1) * downsample, x0 + width); ++x, ++count)
+          sum += m_heights[y * m_heightmap_size + x];
+      out_heights[r * out_width + c] = sum / count;
+    }
+
+  return m_tile_versions[tile_y * m_tiles_per_side + tile_x];
+}
+
+void TerrainTileMirror::read(const function<void(const float*, int)>& reader) const
+{
+  shared_lock<shared_timed_mutex> lock(m_mutex);
+  reader(m_heights.data(), m_heightmap_size);
+}
+
+void TerrainTileMirror::publish(const string& name, shared_ptr<TerrainTileMirror> mirror)
+{
+  lock_guard<mutex> lock(s_registry_mutex);
+  if (mirror)
+    s_registry[name] = move(mirror);
+  else
+    s_registry.erase(name);
+}
+
+shared_ptr<const TerrainTileMirror> TerrainTileMirror::find(const string& name)
+{
+  lock_guard<mutex> lock(s_registry_mutex);
+  auto it = s_registry.find(name);
+  return it != s_registry.end() ? it->second : nullptr;
+}
@@ -0,0 +1,115 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+// Replays a terrain operation log recorded by one of the dynamic terrain plugins and writes the resulting heightmap
+// as a single channel 32-bit float TIFF image (world heights in heightmap image coordinates). The replay does not
+// need Gazebo or a running ROS master.
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <opencv2/imgcodecs.hpp>
+#include "TerrainOperationLog.h"
+
+using namespace std;
+using namespace ow_dynamic_terrain;
+
+static void printUsage()
+{
+  cerr << "usage: terrain_replay [--checkpoint-every N] <operation_log> <output.tif>" << endl
+       << "  --checkpoint-every N  additionally writes <output>_<op>.tif after every N operations" << endl;
+}
+
+static bool writeHeightmap(const TerrainOperationReplay& replay, const string& path)
+{
+  auto size = replay.heightmapSize();
+  auto image = cv::Mat(size, size, CV_32FC1, const_cast<float*>(replay.heights().data()));
+  if (!cv::imwrite(path, image))
+  {
+    cerr << "terrain_replay: failed to write " << path << endl;
+    return false;
+  }
+  return true;
+}
+
+static string checkpointPath(const string& output_path, size_t op_count)
+{
+  auto extension = output_path.rfind('.');
+  if (extension == string::npos || output_path.find('/', extension) != string::npos)
+    return output_path + "_" + to_string(op_count) + ".tif";
+  return output_path.substr(0, extension) + "_" + to_string(op_count) + output_path.substr(extension);
+}
+
+int main(int argc, char** argv)
+{
+  size_t checkpoint_every = 0;
+  string log_path, output_path;
+
+  for (auto i = 1; i < argc; ++i)
+  {
+    string arg = argv[i];
+    if (arg == "--checkpoint-every" && i + 1 < argc)
+      checkpoint_every = strtoul(argv[++i], nullptr, 10);
+    else if (arg == "-h" || arg == "--help")
+    {
+      printUsage();
+      return EXIT_SUCCESS;
+    }
+    else if (log_path.empty())
+      log_path = arg;
+    else if (output_path.empty())
+      output_path = arg;
+    else
+    {
+      printUsage();
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (log_path.empty() || output_path.empty())
+  {
+    printUsage();
+    return EXIT_FAILURE;
+  }
+
+  TerrainOperationLogReader reader;
+  string error;
+  if (!reader.open(log_path, error))
+  {
+    cerr << "terrain_replay: " << error << endl;
+    return EXIT_FAILURE;
+  }
+
+  auto start = chrono::steady_clock::now();
+
+  TerrainOperationReplay replay(reader.heightmapSize(), reader.initialHeights());
+  TerrainOperationRecord record;
+  size_t op_count = 0, failed_count = 0;
+  auto sim_time = 0.0;
+  while (reader.next(record))
+  {
+    if (!replay.apply(record, error))
+    {
+      cerr << "terrain_replay: operation " << op_count << " skipped: " << error << endl;
+      ++failed_count;
+    }
+
+    sim_time = record.sim_time;
+    ++op_count;
+
+    if (checkpoint_every > 0 && op_count % checkpoint_every == 0 &&
+        !writeHeightmap(replay, checkpointPath(output_path, op_count)))
+      return EXIT_FAILURE;
+  }
+
+  if (!writeHeightmap(replay, output_path))
+    return EXIT_FAILURE;
+
+  auto elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cout << "terrain_replay: replayed " << op_count << " operations (" << failed_count << " skipped) up to sim time "
+       << sim_time << "s in " << elapsed << "s" << endl;
+
+  return failed_count == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,214 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#include <cmath>
+#include <numeric>
+#include <gtest/gtest.h>
+#include "SlopeRelaxation.h"
+
+using namespace std;
+using namespace ow_dynamic_terrain;
+
+static const float CELL_SIZE = 0.02f;
+static const float ANGLE_OF_REPOSE = 30.0f;
+
+// a square heightmap with a rectangular trench carved into a flat surface
+class TestSlopeRelaxation : public ::testing::Test
+{
+protected:
+  static const int SIZE = 64;
+  vector<float> m_heights = vector<float>(SIZE * SIZE, 1.0f);
+
+  void SetUp() override
+  {
+    for (auto y = 20; y < 30; ++y)
+      for (auto x = 24; x < 37; ++x)
+        m_heights[y * SIZE + x] = 0.8f;
+  }
+
+  float& at(int x, int y)
+  {
+    return m_heights[y * SIZE + x];
+  }
+
+  bool update(SlopeRelaxation& relaxation, vector<SlopeRelaxation::RegionDiff>& diffs)
+  {
+    return relaxation.update(SIZE, CELL_SIZE, [this](int x, int y) { return at(x, y); },
+                             [this](int x, int y, float value) { at(x, y) = value; }, diffs);
+  }
+
+  float maxSlopeExcess()
+  {
+    auto max_dh = tanf(ANGLE_OF_REPOSE * 3.14159265f / 180.0f) * CELL_SIZE;
+    auto excess = 0.0f;
+    for (auto y = 0; y < SIZE; ++y)
+      for (auto x = 0; x < SIZE; ++x)
+      {
+        if (x + 1 < SIZE)
+          excess = max(excess, fabsf(at(x, y) - at(x + 1, y)) - max_dh);
+        if (y + 1 < SIZE)
+          excess = max(excess, fabsf(at(x, y) - at(x, y + 1)) - max_dh);
+      }
+    return excess;
+  }
+
+  double volume()
+  {
+    return accumulate(m_heights.begin(), m_heights.end(), 0.0);
+  }
+};
+
+TEST_F(TestSlopeRelaxation, relaxesToAngleOfRepose)
+{
+  auto initial_volume = volume();
+  SlopeRelaxation relaxation(ANGLE_OF_REPOSE, 1 << 30);
+  relaxation.activate({ 24, 20, 13, 10 });
+
+  vector<SlopeRelaxation::RegionDiff> diffs;
+  for (auto i = 0; i < 100 && relaxation.isActive(); ++i)
+    update(relaxation, diffs);
+
+  EXPECT_FALSE(relaxation.isActive());
+  EXPECT_LT(maxSlopeExcess(), 1e-3f);
+  EXPECT_NEAR(initial_volume, volume(), 1e-3);
+}
+
+TEST_F(TestSlopeRelaxation, diffsMatchHeightmapChanges)
+{
+  auto initial = m_heights;
+  SlopeRelaxation relaxation(ANGLE_OF_REPOSE, 1 << 30);
+  relaxation.activate({ 24, 20, 13, 10 });
+
+  vector<SlopeRelaxation::RegionDiff> diffs;
+  ASSERT_TRUE(update(relaxation, diffs));
+  ASSERT_FALSE(diffs.empty());
+
+  auto reconstructed = initial;
+  auto total_diff = 0.0;
+  for (const auto& d : diffs)
+  {
+    ASSERT_EQ(static_cast<size_t>(d.region.width * d.region.height), d.diff.size());
+    for (auto y = 0; y < d.region.height; ++y)
+      for (auto x = 0; x < d.region.width; ++x)
+      {
+        reconstructed[(d.region.y + y) * SIZE + d.region.x + x] += d.diff[y * d.region.width + x];
+        total_diff += d.diff[y * d.region.width + x];
+      }
+  }
+  for (auto i = 0; i < SIZE * SIZE; ++i)
+    EXPECT_NEAR(reconstructed[i], m_heights[i], 1e-5f);
+
+  // relaxation only moves material around
+  EXPECT_NEAR(0.0, total_diff, 1e-3);
+}
+
+TEST_F(TestSlopeRelaxation, boundedWorkPerUpdate)
+{
+  // a budget of two iterations over the initial region and its border
+  SlopeRelaxation relaxation(ANGLE_OF_REPOSE, 2 * 15 * 12);
+  relaxation.activate({ 24, 20, 13, 10 });
+
+  vector<SlopeRelaxation::RegionDiff> diffs;
+  auto untouched = m_heights;
+  ASSERT_TRUE(update(relaxation, diffs));
+  EXPECT_TRUE(relaxation.isActive());
+
+  // cells beyond the border of the activated region are left for later updates
+  for (auto y = 0; y < SIZE; ++y)
+    for (auto x = 0; x < SIZE; ++x)
+    {
+      if (x < 23 || x > 37 || y < 19 || y > 30)
+      {
+        EXPECT_EQ(untouched[y * SIZE + x], at(x, y));
+      }
+    }
+}
+
+TEST_F(TestSlopeRelaxation, stableTerrainIsRetired)
+{
+  for (auto& h : m_heights)
+    h = 1.0f;
+  SlopeRelaxation relaxation(ANGLE_OF_REPOSE, 1 << 30);
+  relaxation.activate({ 10, 10, 8, 8 });
+
+  vector<SlopeRelaxation::RegionDiff> diffs;
+  EXPECT_FALSE(update(relaxation, diffs));
+  EXPECT_TRUE(diffs.empty());
+  EXPECT_FALSE(relaxation.isActive());
+}
+
+TEST_F(TestSlopeRelaxation, spreadIsBoundedAroundEdit)
+{
+  // a natural slope far steeper than the angle of repose rises right next to the trench
+  for (auto y = 0; y < SIZE; ++y)
+    for (auto x = 37; x < SIZE; ++x)
+      at(x, y) = 1.0f + 0.05f * (x - 36);
+
+  auto initial = m_heights;
+  auto initial_volume = volume();
+  const int max_spread = 4;
+  SlopeRelaxation relaxation(ANGLE_OF_REPOSE, 1 << 30, max_spread);
+  relaxation.activate({ 24, 20, 13, 10 });
+
+  vector<SlopeRelaxation::RegionDiff> diffs;
+  for (auto i = 0; i < 1000 && relaxation.isActive(); ++i)
+    update(relaxation, diffs);
+
+  EXPECT_FALSE(relaxation.isActive());
+  EXPECT_NEAR(initial_volume, volume(), 1e-3);
+
+  // the activated region is padded by one cell before the margin is applied
+  for (auto y = 0; y < SIZE; ++y)
+    for (auto x = 0; x < SIZE; ++x)
+    {
+      if (x < 23 - max_spread || x > 37 + max_spread || y < 19 - max_spread || y > 30 + max_spread)
+      {
+        EXPECT_EQ(initial[y * SIZE + x], at(x, y));
+      }
+    }
+}
+
+TEST(TestSlopeRelaxationKernel, vectorAndScalarEdgesAgree)
+{
+  // 7 columns exercise both the four lane body and the scalar tail
+  const int width = 7, height = 5;
+  vector<float> heights(width * height), delta(width * height);
+  for (auto i = 0; i < width * height; ++i)
+    heights[i] = static_cast<float>((i * 7919) % 13) * 0.01f;
+  auto reference = heights;
+
+  SlopeRelaxation::relaxIteration(heights, width, height, 0.02f, delta);
+
+  vector<float> reference_delta(width * height, 0.0f);
+  auto flux = [](float a, float b) {
+    auto dh = a - b;
+    return SlopeRelaxation::RELAXATION_RATE * (max(dh - 0.02f, 0.0f) + min(dh + 0.02f, 0.0f));
+  };
+  for (auto y = 0; y < height; ++y)
+    for (auto x = 0; x < width; ++x)
+    {
+      auto i = y * width + x;
+      if (x + 1 < width)
+      {
+        auto f = flux(reference[i], reference[i + 1]);
+        reference_delta[i] -= f;
+        reference_delta[i + 1] += f;
+      }
+      if (y + 1 < height)
+      {
+        auto f = flux(reference[i], reference[i + width]);
+        reference_delta[i] -= f;
+        reference_delta[i + width] += f;
+      }
+    }
+  for (auto i = 0; i < width * height; ++i)
+    EXPECT_NEAR(reference[i] + reference_delta[i], heights[i], 1e-6f);
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
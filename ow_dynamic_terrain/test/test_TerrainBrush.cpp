@@ -0,0 +1,150 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#include <cmath>
+#include <gtest/gtest.h>
+#include "TerrainBrush.h"
+
+using namespace ow_dynamic_terrain;
+
+// Reference implementations of the quadratic brushes evaluated per pixel
+static float referenceCircle(int dx, int dy, float outer_radius, float inner_radius, float weight)
+{
+  auto dist = sqrtf(dx * dx + dy * dy);
+  auto falloff_weight = 1.0f;
+  if (dist > inner_radius)
+  {
+    falloff_weight = std::min(std::max((dist - inner_radius) / (outer_radius - inner_radius), 0.0f), 1.0f);
+    falloff_weight = 1.0f - (falloff_weight * falloff_weight);
+  }
+  return falloff_weight * weight;
+}
+
+static float referenceEllipse(int dx, int dy, float outer_a, float inner_a, float outer_b, float inner_b, float weight)
+{
+  auto intersect = [](float a, float b, float m) { return a * b / sqrtf(b * b + m * m * a * a); };
+  auto falloff_weight = 1.0f;
+  if (inner_a <= 0.0f || inner_b <= 0.0f)
+  {
+    // the inner ellipse is only the center, falloff is by the elliptic radius relative to the outer ellipse
+    auto rho = sqrtf(dx * dx / (outer_a * outer_a) + dy * dy / (outer_b * outer_b));
+    falloff_weight = std::min(rho, 1.0f);
+    falloff_weight = 1.0f - (falloff_weight * falloff_weight);
+  }
+  else if (inner_b * inner_b * dx * dx + inner_a * inner_a * dy * dy > inner_a * inner_a * inner_b * inner_b)
+  {
+    if (dx != 0)
+    {
+      auto m = static_cast<float>(dy) / static_cast<float>(dx);
+      auto x1 = intersect(inner_a, inner_b, m);
+      auto x2 = intersect(outer_a, outer_b, m);
+      falloff_weight = (std::abs(dx) - x1) / (x2 - x1);
+    }
+    else
+    {
+      falloff_weight = (std::abs(dy) - inner_b) / (outer_b - inner_b);
+    }
+    falloff_weight = std::min(std::max(falloff_weight, 0.0f), 1.0f);
+    falloff_weight = 1.0f - (falloff_weight * falloff_weight);
+  }
+  return falloff_weight * weight;
+}
+
+TEST(TestTerrainBrush, circleMatchesReference)
+{
+  const float outer = 9.3f, inner = 2.5f, weight = -0.7f;
+  auto image = TerrainBrush::circle(outer, inner, weight);
+  ASSERT_EQ(20, image.rows);
+  ASSERT_EQ(20, image.cols);
+  for (auto y = 0; y < image.rows; ++y)
+    for (auto x = 0; x < image.cols; ++x)
+      EXPECT_NEAR(referenceCircle(x - 10, y - 10, outer, inner, weight), image.at<float>(y, x), 1e-5f);
+}
+
+TEST(TestTerrainBrush, ellipseMatchesReference)
+{
+  const float outer_a = 7.2f, inner_a = 1.5f, outer_b = 4.6f, inner_b = 0.5f, weight = 1.3f;
+  auto image = TerrainBrush::ellipse(outer_a, inner_a, outer_b, inner_b, weight);
+  ASSERT_EQ(10, image.rows);
+  ASSERT_EQ(16, image.cols);
+  for (auto y = 0; y < image.rows; ++y)
+    for (auto x = 0; x < image.cols; ++x)
+      EXPECT_NEAR(referenceEllipse(x - 8, y - 5, outer_a, inner_a, outer_b, inner_b, weight),
+                  image.at<float>(y, x), 1e-4f);
+}
+
+TEST(TestTerrainBrush, ellipseWithZeroInnerRadius)
+{
+  auto image = TerrainBrush::ellipse(5.0f, 0.0f, 3.0f, 0.0f, 1.0f);
+  EXPECT_FLOAT_EQ(1.0f, image.at<float>(3, 5));  // center
+  EXPECT_NEAR(0.36f, image.at<float>(3, 9), 1e-5f);  // 4 of 5 along a
+  EXPECT_NEAR(0.0f, image.at<float>(3, 0), 1e-5f);   // on the outer ellipse
+  for (auto y = 0; y < image.rows; ++y)
+    for (auto x = 0; x < image.cols; ++x)
+      EXPECT_NEAR(referenceEllipse(x - 5, y - 3, 5.0f, 0.0f, 3.0f, 0.0f, 1.0f), image.at<float>(y, x), 1e-4f);
+}
+
+TEST(TestTerrainBrush, falloffPolicies)
+{
+  EXPECT_FLOAT_EQ(1.0f, falloff::Quadratic::evaluate(0.0f));
+  EXPECT_FLOAT_EQ(0.75f, falloff::Quadratic::evaluate(0.5f));
+  EXPECT_FLOAT_EQ(0.5f, falloff::Linear::evaluate(0.5f));
+  EXPECT_NEAR(1.0f, falloff::Cosine::evaluate(0.0f), 1e-6f);
+  EXPECT_NEAR(0.5f, falloff::Cosine::evaluate(0.5f), 1e-6f);
+  EXPECT_NEAR(0.0f, falloff::Cosine::evaluate(1.0f), 1e-6f);
+  EXPECT_NEAR(1.0f, falloff::Gaussian::evaluate(0.0f), 1e-6f);
+  EXPECT_NEAR(0.0f, falloff::Gaussian::evaluate(1.0f), 1e-6f);
+  EXPECT_FLOAT_EQ(1.0f, falloff::HardEdge::evaluate(0.99f));
+  EXPECT_FLOAT_EQ(0.0f, falloff::HardEdge::evaluate(1.0f));
+}
+
+TEST(TestTerrainBrush, vectorAndScalarEvaluationAgree)
+{
+  // 2 * ceil(6.5) = 14 columns exercises both the four lane body and the scalar tail of each row
+  auto cosine = TerrainBrush::circle<falloff::Cosine>(6.5f, 1.0f, 1.0f);
+  auto gaussian = TerrainBrush::ellipse<falloff::Gaussian>(6.5f, 1.0f, 3.0f, 0.5f, 1.0f);
+  CircleShape circle(6.5f, 1.0f);
+  EllipseShape ellipse(6.5f, 1.0f, 3.0f, 0.5f);
+  for (auto y = 0; y < cosine.rows; ++y)
+    for (auto x = 0; x < cosine.cols; ++x)
+    {
+      auto t = circle.parameter<falloff::Cosine>(static_cast<float>(x - 7), static_cast<float>(y - 7));
+      EXPECT_NEAR(falloff::Cosine::evaluate(t), cosine.at<float>(y, x), 1e-6f);
+    }
+  for (auto y = 0; y < gaussian.rows; ++y)
+    for (auto x = 0; x < gaussian.cols; ++x)
+    {
+      auto t = ellipse.parameter<falloff::Gaussian>(static_cast<float>(x - 7), static_cast<float>(y - 3));
+      EXPECT_NEAR(falloff::Gaussian::evaluate(t), gaussian.at<float>(y, x), 1e-6f);
+    }
+}
+
+TEST(TestTerrainBrush, hardEdgeSkipsDistance)
+{
+  auto image = TerrainBrush::circle<falloff::HardEdge>(4.0f, 1.0f, 2.0f);
+  for (auto y = 0; y < image.rows; ++y)
+    for (auto x = 0; x < image.cols; ++x)
+    {
+      auto dx = x - 4, dy = y - 4;
+      EXPECT_FLOAT_EQ(dx * dx + dy * dy < 16 ? 2.0f : 0.0f, image.at<float>(y, x));
+    }
+}
+
+TEST(TestTerrainBrush, falloffMethodFromString)
+{
+  for (auto name : { "quadratic", "linear", "cosine", "gaussian", "hard" })
+    EXPECT_TRUE(TerrainBrush::falloffMethodFromString(name));
+  EXPECT_FALSE(TerrainBrush::falloffMethodFromString("invalid_falloff_name"));
+
+  auto quadratic = TerrainBrush::falloffMethodFromString("quadratic");
+  auto image = quadratic->circle(3.0f, 1.0f, 1.0f);
+  EXPECT_FLOAT_EQ(referenceCircle(1, 2, 3.0f, 1.0f, 1.0f), image.at<float>(5, 4));
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
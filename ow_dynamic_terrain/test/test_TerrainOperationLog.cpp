@@ -0,0 +1,128 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#include <cstdio>
+#include <gtest/gtest.h>
+#include <cv_bridge/cv_bridge.h>
+#include <sensor_msgs/image_encodings.h>
+#include "TerrainEditBuilder.h"
+#include "TerrainOperationLog.h"
+
+using namespace std;
+using namespace ow_dynamic_terrain;
+
+static const int SIZE = 32;
+static const float H_SCALE = 4.0f;
+
+class TestTerrainOperationLog : public ::testing::Test
+{
+protected:
+  string m_path = "/tmp/test_terrain_operation.log";
+  vector<float> m_heights;
+
+  void SetUp() override
+  {
+    m_heights.resize(SIZE * SIZE);
+    for (auto i = 0; i < SIZE * SIZE; ++i)
+      m_heights[i] = 1.0f + 0.01f * (i % 7);
+  }
+
+  void TearDown() override
+  {
+    remove(m_path.c_str());
+  }
+
+  float get(int x, int y)
+  {
+    return m_heights[y * SIZE + x];
+  }
+
+  void set(int x, int y, float value)
+  {
+    m_heights[y * SIZE + x] = value;
+  }
+};
+
+TEST_F(TestTerrainOperationLog, replayReproducesOperations)
+{
+  auto initial_heights = m_heights;
+  auto get_height = [this](int x, int y) { return get(x, y); };
+  auto set_height = [this](int x, int y, float value) { set(x, y, value); };
+
+  TerrainOperationLogWriter writer;
+  ASSERT_TRUE(writer.open(m_path, SIZE, get_height));
+
+  // a circle dug near the edge of the heightmap followed by a rotated ellipse
+  modify_terrain_circle circle;
+  circle.outer_radius = 1.5f;
+  circle.inner_radius = 0.5f;
+  circle.weight = -0.3f;
+  circle.falloff = "cosine";
+  TerrainEdit circle_edit;
+  string error;
+  ASSERT_TRUE(TerrainEditBuilder::buildCircle(circle, H_SCALE, circle_edit, error));
+  circle_edit.center = cv::Point2i(2, 5);
+  writer.append(TerrainOperationType::Circle, 1.0, circle_edit.center, H_SCALE, circle);
+  cv::Mat diff;
+  TerrainEditBuilder::mergeEdit(SIZE, circle_edit, get_height, set_height, diff);
+
+  modify_terrain_ellipse ellipse;
+  ellipse.position.z = 1.0f;
+  ellipse.orientation = 30.0f;
+  ellipse.outer_radius_a = 2.0f;
+  ellipse.outer_radius_b = 1.0f;
+  ellipse.weight = -0.2f;
+  ellipse.merge_method = "min";
+  TerrainEdit ellipse_edit;
+  ASSERT_TRUE(TerrainEditBuilder::buildEllipse(ellipse, H_SCALE, ellipse_edit, error));
+  ellipse_edit.center = cv::Point2i(16, 15);
+  writer.append(TerrainOperationType::Ellipse, 2.0, ellipse_edit.center, H_SCALE, ellipse);
+  TerrainEditBuilder::mergeEdit(SIZE, ellipse_edit, get_height, set_height, diff);
+
+  // a relaxed region is logged with its resulting heights
+  auto relaxed = cv::Mat(3, 4, CV_32FC1, cv::Scalar(0.25f));
+  for (auto y = 0; y < relaxed.rows; ++y)
+    for (auto x = 0; x < relaxed.cols; ++x)
+      set(20 + x, 10 + y, 0.25f);
+  auto relaxed_msg = cv_bridge::CvImage(std_msgs::Header(), sensor_msgs::image_encodings::TYPE_32FC1, relaxed);
+  writer.append(TerrainOperationType::Relax, 3.0, cv::Point2i(22, 11), H_SCALE, *relaxed_msg.toImageMsg());
+
+  TerrainOperationLogReader reader;
+  ASSERT_TRUE(reader.open(m_path, error)) << error;
+  ASSERT_EQ(SIZE, reader.heightmapSize());
+  EXPECT_EQ(initial_heights, reader.initialHeights());
+
+  TerrainOperationReplay replay(reader.heightmapSize(), reader.initialHeights());
+  TerrainOperationRecord record;
+  auto count = 0;
+  while (reader.next(record))
+  {
+    EXPECT_TRUE(replay.apply(record, error)) << error;
+    EXPECT_DOUBLE_EQ(++count, record.sim_time);
+  }
+  EXPECT_EQ(3, count);
+
+  // the replay is bit exact
+  EXPECT_EQ(m_heights, replay.heights());
+}
+
+TEST_F(TestTerrainOperationLog, rejectsInvalidLogs)
+{
+  FILE* file = fopen(m_path.c_str(), "wb");
+  ASSERT_NE(nullptr, file);
+  fputs("not a log", file);
+  fclose(file);
+
+  TerrainOperationLogReader reader;
+  string error;
+  EXPECT_FALSE(reader.open(m_path, error));
+  EXPECT_FALSE(error.empty());
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,82 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#include <gtest/gtest.h>
+#include "TerrainTileMirror.h"
+
+using namespace std;
+using namespace ow_dynamic_terrain;
+
+static const int SIZE = 10;
+
+static float initialHeight(int x, int y)
+{
+  return static_cast<float>(y * SIZE + x);
+}
+
+TEST(TestTerrainTileMirror, tilesCoverHeightmap)
+{
+  TerrainTileMirror mirror(SIZE, 4, initialHeight);
+  EXPECT_EQ(3, mirror.tilesPerSide());
+
+  vector<float> heights;
+  int width, height;
+  EXPECT_EQ(0u, mirror.readTile(2, 1, 1, heights, width, height));
+  ASSERT_EQ(2, width);  // tiles along the far edges are smaller
+  ASSERT_EQ(4, height);
+  EXPECT_FLOAT_EQ(initialHeight(8, 4), heights[0]);
+  EXPECT_FLOAT_EQ(initialHeight(9, 7), heights[3 * width + 1]);
+}
+
+TEST(TestTerrainTileMirror, updateIncrementsOverlappedTiles)
+{
+  TerrainTileMirror mirror(SIZE, 4, initialHeight);
+  mirror.update(3, 3, 2, 1, [](int, int) { return -1.0f; });
+
+  vector<uint64_t> versions;
+  mirror.tileVersions(versions);
+  ASSERT_EQ(9u, versions.size());
+  EXPECT_EQ((vector<uint64_t>{ 1, 1, 0, 0, 0, 0, 0, 0, 0 }), versions);
+
+  mirror.read([](const float* heights, int heightmap_size) {
+    EXPECT_FLOAT_EQ(-1.0f, heights[3 * heightmap_size + 3]);
+    EXPECT_FLOAT_EQ(-1.0f, heights[3 * heightmap_size + 4]);
+    EXPECT_FLOAT_EQ(initialHeight(5, 3), heights[3 * heightmap_size + 5]);
+  });
+
+  // regions reaching beyond the heightmap are clipped
+  mirror.update(8, -2, 5, 3, [](int, int) { return 2.0f; });
+  EXPECT_EQ(1u, mirror.tileVersion(2, 0));
+}
+
+TEST(TestTerrainTileMirror, downsampleAveragesBlocks)
+{
+  TerrainTileMirror mirror(SIZE, 5, initialHeight);
+  vector<float> heights;
+  int width, height;
+  mirror.readTile(1, 1, 2, heights, width, height);
+  ASSERT_EQ(3, width);
+  ASSERT_EQ(3, height);
+  EXPECT_FLOAT_EQ((initialHeight(5, 5) + initialHeight(6, 5) + initialHeight(5, 6) + initialHeight(6, 6)) / 4,
+                  heights[0]);
+  // partial block in the corner holds a single cell
+  EXPECT_FLOAT_EQ(initialHeight(9, 9), heights[8]);
+}
+
+TEST(TestTerrainTileMirror, registry)
+{
+  EXPECT_EQ(nullptr, TerrainTileMirror::find("test"));
+  auto mirror = make_shared<TerrainTileMirror>(SIZE, 4, initialHeight);
+  TerrainTileMirror::publish("test", mirror);
+  EXPECT_EQ(mirror, TerrainTileMirror::find("test"));
+  TerrainTileMirror::publish("test", nullptr);
+  EXPECT_EQ(nullptr, TerrainTileMirror::find("test"));
+}
+
+// Run all the tests that were declared with TEST()
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -3,13 +3,7 @@
 // this repository.
 
 // TODO:
-//    1) Add in discrete element domain relaxation step before cosimulation
-//       begins (if needed).
-//    2) Transform force and torque to Gazebo's reference frame (if needed).
-//    3) Interpolate between consecutive scoop poses before each call to 
-//       Cosimulator::update to ensure smooth movement.
-//    4) Implement CropHeightmap
-//    5) Read in parameters in a more OceanWATERS-like way (i.e rosparam yaml?)
+//    1) Read in parameters in a more OceanWATERS-like way (i.e rosparam yaml?)
 
 #include "CosimulationPlugin.h"
 
@@ -18,22 +12,27 @@
 #include <gazebo/physics/World.hh>
 #include <gazebo/physics/Model.hh>
 #include <gazebo/physics/Link.hh>
-#include <gazebo/rendering/RenderingIface.hh>
-#include <gazebo/rendering/Scene.hh>
-#include <gazebo/rendering/Heightmap.hh>
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstdlib>
 
 using namespace gazebo;
+using namespace std;
 
-// Generate a mesh with a +Z-facing geometry that matches the heigthmap and
-// all other sides match the box boundaries
-static common::Mesh CropHeightmap(rendering::Heightmap* heightmap, 
-    ignition::math::OrientedBoxd& box)
+// Relaxed particle beds are kept in the ROS home directory by default
+static std::string defaultBedCacheDirectory(void)
 {
-  gzwarn << "CropHeightmap - STUBBED" << std::endl;
-
-  return common::Mesh();
+  const char *ros_home = getenv("ROS_HOME");
+  if (ros_home && *ros_home) {
+    return std::string(ros_home) + "/cosimulation_beds";
+  }
+  const char *home = getenv("HOME");
+  if (home && *home) {
+    return std::string(home) + "/.ros/cosimulation_beds";
+  }
+  return std::string();
 }
 
 // Convenience function for the Load function SDF parsing
@@ -46,12 +45,22 @@ static T parseElement(sdf::ElementPtr sdf, const std::string &name) {
 }
 
 CosimulationPlugin::CosimulationPlugin() 
-: ModelPlugin(), m_started(false)
+: ModelPlugin(), m_blocking(false), m_relax_max_iterations(1000000),
+  m_relax_max_speed(1e-3), m_fill_stale(false), m_fill_wait_reported(false),
+  m_heightmap_missing_reported(false), m_started(false), m_last_time(0.0),
+  m_result_count(0)
 {
 }
 
 CosimulationPlugin::~CosimulationPlugin()
 {
+  // no more updates may reach the worker while it is stopped
+  m_phys_connect.reset();
+  // a relaxation that is still running would hold up the shutdown
+  m_cosim.cancelRelax();
+  if (m_fill_done.valid()) {
+    m_fill_done.wait();
+  }
 }
 
 void CosimulationPlugin::Load(physics::ModelPtr model, sdf::ElementPtr sdf)
@@ -64,6 +73,7 @@ void CosimulationPlugin::Load(physics::ModelPtr model, sdf::ElementPtr sdf)
       part_friction_static, part_friction_rolling, part_density, part_radius;
   ignition::math::Vector3d workspace_dimensions;
   ignition::math::Pose3d workspace_pose; 
+  std::string bed_cache_directory;
 
   try {
     // parse link parameter and save reference
@@ -95,6 +105,20 @@ void CosimulationPlugin::Load(physics::ModelPtr model, sdf::ElementPtr sdf)
     workspace_pose = parseElement<ignition::math::Pose3d>(sdf, "workspace_pose");  
     // Cosimulation timestep parameter
     m_timestep = parseElement<double>(sdf, "timestep");
+    // optional relaxation parameters
+    if (sdf->HasElement("relax_max_iterations")) {
+      m_relax_max_iterations = sdf->Get<int>("relax_max_iterations");
+    }
+    if (sdf->HasElement("relax_max_speed")) {
+      m_relax_max_speed = sdf->Get<double>("relax_max_speed");
+    }
+    if (sdf->HasElement("blocking")) {
+      m_blocking = sdf->Get<bool>("blocking");
+    }
+    bed_cache_directory = defaultBedCacheDirectory();
+    if (sdf->HasElement("bed_cache_directory")) {
+      bed_cache_directory = sdf->Get<std::string>("bed_cache_directory");
+    }
   } catch (common::Exception err) {
     // TODO: print this exception to gzerr
     return;
@@ -107,6 +131,8 @@ void CosimulationPlugin::Load(physics::ModelPtr model, sdf::ElementPtr sdf)
   m_cosim.setParticleProperties(part_youngs_modulus, part_poisson_ratio, 
       part_restitution_coef, part_friction_static, part_friction_rolling, 
       part_density, part_radius);
+  m_cosim.setTimestep(m_timestep);
+  m_cosim.setBedCacheDirectory(bed_cache_directory);
   // get world pointer
   m_world = physics::get_world();
   if (!m_world) {
@@ -120,74 +146,154 @@ void CosimulationPlugin::Load(physics::ModelPtr model, sdf::ElementPtr sdf)
   // build workspace bounding box
   m_workspace_box.Size(workspace_dimensions);
   m_workspace_box.Pose(workspace_pose);
-  // get heightmap and pass it to the cosimulation as a cropped heightmap
-  rendering::ScenePtr scene = rendering::get_scene();
-  if (!scene) {
-    gzerr << "CosimulationPlugin::Load - scene pointer is NULL" << std::endl;
-    return;
-  }
-  rendering::Heightmap* heightmap = scene->GetHeightmap();
-  if (!heightmap) {
-    gzerr << "CosimulationPlugin::Load - heightmap pointer is NULL" << std::endl;
-    return;  
+  m_cosim.setDomain(m_workspace_box);
+  // crop the heightmap and start filling it with particles now if it is
+  // loaded already, otherwise once it is
+  if (m_crop.initialize(m_world, m_workspace_box)) {
+    fillWorkspace();
   }
-  m_cosim.setParticleFillGeometry(CropHeightmap(heightmap, m_workspace_box));
-
-  m_cosim.initialize();
 
   m_phys_connect = event::Events::ConnectBeforePhysicsUpdate(
       std::bind(&CosimulationPlugin::OnUpdate, this));
 }
 
+void CosimulationPlugin::fillWorkspace(void)
+{
+  // Particles relaxing in an earlier crop are of no use anymore. Filling them
+  // in can't be interrupted though, so Gazebo doesn't wait for the running
+  // task and the crop is filled again once it is done.
+  if (isFilling()) {
+    m_cosim.cancelRelax();
+    m_fill_stale = true;
+    return;
+  }
+  finishFill();
+  m_fill_stale = false;
+  m_cosim.allowRelax();
+  m_cosim.setParticleFillGeometry(m_crop.getMesh());
+  // Gazebo keeps running while the particles relax, m_cosim is left to this
+  // task until it is done
+  m_fill_done = std::async(std::launch::async, [this]() {
+    m_cosim.initialize();
+    gzmsg << "CosimulationPlugin - Relaxing particles..." << std::endl;
+    m_cosim.relax(m_relax_max_iterations, m_relax_max_speed);
+  });
+}
+
+bool CosimulationPlugin::isFilling(void)
+{
+  return m_fill_done.valid()
+    && m_fill_done.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+}
+
+void CosimulationPlugin::finishFill(void)
+{
+  if (m_fill_done.valid()) {
+    m_fill_done.get();
+  }
+}
+
 void CosimulationPlugin::OnUpdate(void)
 {
   // NOTE: So long as region's height is larger than the link, using the link's
   //       CoG here works fine.
-  ignition::math::Pose3d link_pose = m_link->WorldCoGPose();
+  ignition::math::Vector3d link_cog = m_link->WorldCoGPose().Pos();
+  // the tool mesh is in the link's frame
+  ignition::math::Pose3d link_pose = m_link->WorldPose();
+  bool inside = m_workspace_box.Contains(link_cog);
+
+  // Until the link enters the workspace, terrain edits inside of it are
+  // followed, and the particles are filled in and relaxed again in the
+  // background. From then on the particles are the terrain there.
+  if (m_started == false) {
+    if (!m_crop.isInitialized()) {
+      if (m_crop.initialize(m_world, m_workspace_box)) {
+        fillWorkspace();
+      }
+    } else if (!inside && m_crop.update()) {
+      fillWorkspace();
+    } else if (m_fill_stale && !isFilling()) {
+      fillWorkspace();
+    }
+  }
 
-  if (m_workspace_box.Contains(link_pose.Pos()) == false) {
+  if (inside == false) {
     // ignore this call if link is not within workspace yet  
     return;
   } else if (m_started == false) {
+    if (!m_crop.isInitialized()) {
+      if (!m_heightmap_missing_reported) {
+        gzerr << "CosimulationPlugin::OnUpdate - world has no heightmap to "
+              << "fill the workspace from" << std::endl;
+        m_heightmap_missing_reported = true;
+      }
+      return;
+    }
+    // the link is left to the terrain of Gazebo until the particles are ready
+    if (m_fill_stale || isFilling()) {
+      if (!m_fill_wait_reported) {
+        gzmsg << "CosimulationPlugin::OnUpdate - waiting for particles to relax"
+              << std::endl;
+        m_fill_wait_reported = true;
+      }
+      return;
+    }
+    finishFill();
     // record time when link first enters workspace
     m_started = true;
     m_starttime = m_world->SimTime().Double();
+    m_last_time = 0.0;
+    // the cosimulator is only used by the worker thread from now on
+    m_worker = make_unique<CosimulationWorker>(m_cosim, m_timestep, link_pose);
+    return;
   }
 
-  double gz_time = m_world->SimTime().Double();
-  // linear and angular impulse for accumulating forces and torques
-  ignition::math::Vector3d lin_impulse;
-  ignition::math::Vector3d ang_impulse;
-  // track total cosimulation time for all loops
-  double elapsed = 0.0;
-  // catch cosimulation up to Gazebo simulation
-  // FIXME: m_starttime should be used in here for comparing cosim time and gz_time
-  while(m_cosim.getSimTime() <= gz_time) {
-    // cosim update function output variables
-    ignition::math::Vector3d out_force;
-    ignition::math::Vector3d out_torque;
-    // select timestep
-    // NOTE: remainder calculation allows both simulations to sync their clocks
-    double remainder = gz_time - (m_cosim.getSimTime() + m_timestep);
-    if (remainder == 0.0) {
-      break;
-    }
-    double timestep = std::min(remainder, m_timestep);
-    // advance cosimulation physics
-    m_cosim.update(link_pose, timestep, out_force, out_torque);
-    // accumulate forces and torques as linear and angular impulse
-    lin_impulse += out_force * timestep;
-    ang_impulse += out_torque * timestep;
-    elapsed += timestep;
+  // cosimulation time that corresponds to Gazebo's time
+  double target_time = m_world->SimTime().Double() - m_starttime;
+  if (target_time <= m_last_time) {
+    return;
   }
-  // calculate time averaged force and torque from impulses
-  if (elapsed <= 0.0) {
-    gzerr << "CosimulationPlugin::OnUpdate - Cosimulation elapsed time <= 0" << std::endl;
+  double request_start_time = m_last_time;
+  if (!m_worker->submit({target_time, link_pose})) {
+    gzerr << "CosimulationPlugin::OnUpdate - too many pending cosimulation "
+          << "requests" << std::endl;
     return;
   }
-  auto avg_force = lin_impulse / elapsed;
-  auto avg_torque = ang_impulse / elapsed;
-  // pass force and torque back to Gazebo
-  m_link->AddRelativeForce(avg_force);
-  m_link->AddRelativeTorque(avg_torque);
+  m_last_time = target_time;
+
+  ignition::math::Vector3d force;
+  ignition::math::Vector3d torque;
+  if (m_blocking) {
+    // wait for the cosimulation to catch up with this update
+    auto result = m_worker->wait();
+    force = result.force;
+    torque = result.torque;
+  } else {
+    // The cosimulation of this update runs while Gazebo computes its next
+    // physics step, what is applied now is the result of the previous one.
+    if (m_worker->getPendingCount() < 2) {
+      return;
+    }
+    m_results[0] = m_results[1];
+    m_results[1] = m_worker->wait();
+    ++m_result_count;
+    force = m_results[1].force;
+    torque = m_results[1].torque;
+    // extrapolate linearly from the last two results to the middle of this
+    // update's interval to make up for the lag
+    if (m_result_count >= 2) {
+      double previous_mid = 0.5 * (m_results[0].start_time + m_results[0].end_time);
+      double last_mid = 0.5 * (m_results[1].start_time + m_results[1].end_time);
+      double mid = 0.5 * (request_start_time + target_time);
+      if (last_mid > previous_mid) {
+        double scale = (mid - last_mid) / (last_mid - previous_mid);
+        force += (m_results[1].force - m_results[0].force) * scale;
+        torque += (m_results[1].torque - m_results[0].torque) * scale;
+      }
+    }
+  }
+  // pass force and torque back to Gazebo, both are in the world frame and the
+  // torque is about the link's origin
+  m_link->AddForceAtWorldPosition(force, link_pose.Pos());
+  m_link->AddTorque(torque);
 }
@@ -5,20 +5,31 @@
 #ifndef CosimulationPlugin_h
 #define CosimulationPlugin_h
 
+#include <future>
+#include <memory>
+
 #include <gazebo/common/Plugin.hh>
 #include <gazebo/physics/World.hh>
 
 #include <ignition/math/OrientedBox.hh>
 
 #include "Cosimulator.h"
+#include "CosimulationWorker.h"
+#include "HeightmapCrop.h"
 
 namespace gazebo {
 
 // CosimulationPlugin acts as the primary interface between Gazebo and the 
 // Cosimulator. It is responsbile for closing the loop between Gazebo's physics
 // engine and the cosimulation. It also computes the geometry that Cosimulator 
-// will operate on based on the portion of the scene's heightmap that intersects 
+// will operate on based on the portion of the world's heightmap that intersects 
 // the workspace box.
+//
+// By default the cosimulation runs on a thread of its own one update behind
+// Gazebo, so that both simulations advance at the same time. The forces
+// applied to the link are then extrapolated from the last two results of the
+// cosimulation. In blocking mode every update waits for the cosimulation to
+// catch up with it instead, as it is meant for validation runs.
 class CosimulationPlugin : public ModelPlugin
 {
 public:
@@ -32,14 +43,39 @@ protected:
   void OnUpdate();
 
 private:
+  // fills the cropped heightmap with particles and starts relaxing them in
+  // the background, or marks the particles as stale if a fill is running
+  // still, which is then restarted once it is done
+  void fillWorkspace(void);
+  // true while particles are filled in or relaxed in the background
+  bool isFilling(void);
+  // collects the result of a fill that is done, rethrowing its errors
+  void finishFill(void);
+
   // Cosimulator class that interfaces with external physics simulation
   Cosimulator m_cosim;
+  // Terrain inside of the workspace that particles are filled into
+  HeightmapCrop m_crop;
   // Timestep the cosimulation is iterated at
   double m_timestep;
+  // True if each update waits for the cosimulation to catch up with it,
+  // instead of applying the extrapolated result of the previous update
+  bool m_blocking;
+  // Limits of the relaxation after particles are filled in
+  int m_relax_max_iterations;
+  double m_relax_max_speed;
+  // Relaxation running in the background, valid until it was waited for
+  std::future<void> m_fill_done;
+  // True if the terrain changed while a fill was running
+  bool m_fill_stale;
+  bool m_fill_wait_reported;
+  bool m_heightmap_missing_reported;
   // True if Cosimulator has begun updating its physics
   bool m_started;
   // Timepoint when cosimulation started updating its physics
   double m_starttime;
+  // Cosimulation time of the last update
+  double m_last_time;
   // Link that will be cosimulated and have resulting forces applied to it
   physics::LinkPtr m_link;
   // World pointer for checking Gazebo simulation clock
@@ -48,6 +84,11 @@ private:
   ignition::math::OrientedBoxd m_workspace_box;
   // Physics update connection
   event::ConnectionPtr m_phys_connect;
+  // Runs m_cosim once the link entered the workspace, destroyed before it
+  std::unique_ptr<CosimulationWorker> m_worker;
+  // Last two results of the worker, the latest last, for extrapolation
+  CosimulationWorker::Result m_results[2];
+  int m_result_count;
 };
 
 // Register this plugin with the Gazebo
@@ -0,0 +1,140 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#include "CosimulationWorker.h"
+
+#include <algorithm>
+
+#include <ignition/math/Helpers.hh>
+
+using namespace ignition::math;
+
+// Remainders shorter than this fraction of a timestep are not stepped, they
+// are too short for the tool's velocity to be estimated from its poses
+static const double MIN_TIMESTEP_FRACTION = 1e-3;
+
+// Requests that may be pending at once
+static const size_t QUEUE_CAPACITY = 4;
+
+CosimulationWorker::CosimulationWorker(Cosimulator &cosim, double timestep,
+                                       const Pose3d &tool_pose)
+  : m_cosim(cosim), m_timestep(timestep), m_last_pose(tool_pose),
+    m_last_time(cosim.getSimTime()), m_requests(QUEUE_CAPACITY),
+    m_results(QUEUE_CAPACITY), m_pending(0), m_stop(false)
+{
+  m_thread = std::thread(&CosimulationWorker::run, this);
+}
+
+CosimulationWorker::~CosimulationWorker()
+{
+  m_stop = true;
+  {
+    std::lock_guard<std::mutex> lock(m_wake_mutex);
+  }
+  m_request_ready.notify_one();
+  m_thread.join();
+}
+
+bool CosimulationWorker::submit(const Request &request)
+{
+  if (m_pending >= static_cast<int>(QUEUE_CAPACITY)
+      || !m_requests.TryPush(request)) {
+    return false;
+  }
+  ++m_pending;
+  // taking the mutex after pushing makes sure the worker either sees the
+  // request before it sleeps or is asleep when notified
+  {
+    std::lock_guard<std::mutex> lock(m_wake_mutex);
+  }
+  m_request_ready.notify_one();
+  return true;
+}
+
+CosimulationWorker::Result CosimulationWorker::wait(void)
+{
+  Result result = {};
+  if (m_pending == 0) {
+    return result;
+  }
+  if (!m_results.TryPop(result)) {
+    std::unique_lock<std::mutex> lock(m_wake_mutex);
+    m_result_ready.wait(lock, [&]() { return m_results.TryPop(result); });
+  }
+  --m_pending;
+  return result;
+}
+
+void CosimulationWorker::run(void)
+{
+  while (true) {
+    Request request;
+    if (!m_requests.TryPop(request)) {
+      std::unique_lock<std::mutex> lock(m_wake_mutex);
+      m_request_ready.wait(lock, [&]() {
+        return m_stop || m_requests.TryPop(request);
+      });
+    }
+    if (m_stop) {
+      return;
+    }
+    // there is room, as the plugin never has more requests pending than the
+    // queue holds
+    m_results.TryPush(catchUp(request));
+    {
+      std::lock_guard<std::mutex> lock(m_wake_mutex);
+    }
+    m_result_ready.notify_one();
+  }
+}
+
+CosimulationWorker::Result CosimulationWorker::catchUp(const Request &request)
+{
+  Result result = {};
+  result.start_time = m_cosim.getSimTime();
+  result.end_time = result.start_time;
+  double interval = request.end_time - m_last_time;
+  if (interval <= 0.0) {
+    return result;
+  }
+  // linear and angular impulse for accumulating forces and torques
+  Vector3d lin_impulse;
+  Vector3d ang_impulse;
+  // track total cosimulation time for all loops
+  double elapsed = 0.0;
+  // catch cosimulation up to the requested time, steps that would be a tiny
+  // fraction of a timestep are left for the next request
+  while (request.end_time - m_cosim.getSimTime()
+         > MIN_TIMESTEP_FRACTION * m_timestep) {
+    // cosim update function output variables
+    Vector3d out_force;
+    Vector3d out_torque;
+    // select timestep
+    // NOTE: the last step is shortened so that both simulations sync clocks
+    double timestep = std::min(m_timestep,
+                               request.end_time - m_cosim.getSimTime());
+    // move the tool smoothly from its last pose to the requested one
+    double fraction = (m_cosim.getSimTime() + timestep - m_last_time) / interval;
+    fraction = clamp(fraction, 0.0, 1.0);
+    Pose3d step_pose(
+      m_last_pose.Pos() + (request.tool_pose.Pos() - m_last_pose.Pos()) * fraction,
+      Quaterniond::Slerp(fraction, m_last_pose.Rot(), request.tool_pose.Rot(),
+                         true));
+    // advance cosimulation physics
+    m_cosim.update(step_pose, timestep, out_force, out_torque);
+    // accumulate forces and torques as linear and angular impulse
+    lin_impulse += out_force * timestep;
+    ang_impulse += out_torque * timestep;
+    elapsed += timestep;
+  }
+  m_last_pose = request.tool_pose;
+  m_last_time = request.end_time;
+  result.end_time = m_cosim.getSimTime();
+  // calculate time averaged force and torque from impulses
+  if (elapsed > 0.0) {
+    result.force = lin_impulse / elapsed;
+    result.torque = ang_impulse / elapsed;
+  }
+  return result;
+}
@@ -0,0 +1,90 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#ifndef CosimulationWorker_h
+#define CosimulationWorker_h
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <ignition/math/Pose3.hh>
+#include <ignition/math/Vector3.hh>
+
+#include "Cosimulator.h"
+#include "SpscRing.h"
+
+// CosimulationWorker runs a Cosimulator on a thread of its own, so that the
+// cosimulation can advance while Gazebo computes its physics. Requests to
+// advance to a time with the tool at a pose are queued to the worker thread,
+// which catches the cosimulation up to that time and queues back the force
+// and torque on the tool averaged over the interval.
+//
+// Requests and results are passed through lock-free queues. The mutex is only
+// ever taken to put a thread to sleep while it has nothing to do, or to wake
+// it up.
+class CosimulationWorker
+{
+public:
+  // Request to catch up to end_time, moving the tool to tool_pose
+  struct Request {
+    double end_time;
+    ignition::math::Pose3d tool_pose;
+  };
+
+  // Force and torque averaged over the interval of a request, in the world
+  // frame, the torque about the origin of the tool
+  struct Result {
+    double start_time;
+    double end_time;
+    ignition::math::Vector3d force;
+    ignition::math::Vector3d torque;
+  };
+
+  // cosim must be initialized and is only used by the worker thread from
+  // then on, tool_pose is the tool's pose at the cosimulation's current time
+  CosimulationWorker(Cosimulator &cosim, double timestep,
+                     const ignition::math::Pose3d &tool_pose);
+  ~CosimulationWorker();
+
+  CosimulationWorker(const CosimulationWorker&) = delete;
+  CosimulationWorker& operator=(const CosimulationWorker&) = delete;
+
+  // queues a request, returns false if too many are pending
+  bool submit(const Request &request);
+
+  // waits for the result of the oldest request whose result has not been
+  // taken yet
+  Result wait(void);
+
+  // number of requests whose result has not been taken yet
+  int getPendingCount(void) const {
+    return m_pending;
+  }
+
+private:
+  void run(void);
+  // catches the cosimulation up to request, moving the tool smoothly from the
+  // previous request's pose
+  Result catchUp(const Request &request);
+
+  Cosimulator &m_cosim;
+  double m_timestep;
+  // pose and time of the last request, only accessed by the worker thread
+  ignition::math::Pose3d m_last_pose;
+  double m_last_time;
+
+  SpscRing<Request> m_requests;
+  SpscRing<Result> m_results;
+  int m_pending;
+
+  std::atomic<bool> m_stop;
+  std::mutex m_wake_mutex;
+  std::condition_variable m_request_ready;
+  std::condition_variable m_result_ready;
+  std::thread m_thread;
+};
+
+#endif // CosimulationWorker_h
@@ -4,72 +4,184 @@
 
 #include "Cosimulator.h"
 #include <gazebo/common/Console.hh>
+#include <gazebo/common/Mesh.hh>
+#include <gazebo/common/MeshManager.hh>
 
-Cosimulator::Cosimulator() : m_relaxed(false)
+#include <algorithm>
+#include <cmath>
+
+// Fraction of the critical timestep above which the simulation is unstable
+static const double MAX_CRITICAL_TIMESTEP_FRACTION = 0.3;
+
+// Append the triangles of all submeshes of mesh to out_triangles
+static void appendTriangles(const gazebo::common::Mesh &mesh,
+    DemTriangles &out_triangles)
+{
+  for (unsigned int s = 0; s < mesh.GetSubMeshCount(); ++s) {
+    const auto submesh = mesh.GetSubMesh(s);
+    if (submesh->GetPrimitiveType() != gazebo::common::SubMesh::TRIANGLES) {
+      gzwarn << "Cosimulator - skipping submesh " << s
+             << " that is not made of triangles" << std::endl;
+      continue;
+    }
+    for (unsigned int i = 0; i + 2 < submesh->GetIndexCount(); i += 3) {
+      for (unsigned int k = 0; k < 3; ++k) {
+        out_triangles.push_back(submesh->Vertex(submesh->GetIndex(i + k)));
+      }
+    }
+  }
+}
+
+Cosimulator::Cosimulator() : m_timestep(0.0), m_relaxed(false),
+  m_sim_time(0.0), m_cancel_relax(false)
 {
 }
 
 void Cosimulator::initialize(void) {
-  gzwarn << "Cosimulator::initialize - STUBBED" << std::endl;
+  DemMaterial particle_material = {
+    m_particle_youngs_modulus, m_particle_poisson_ratio,
+    m_particle_restitution_coef, m_particle_friction_static,
+    m_particle_friction_rolling
+  };
+  DemMaterial tool_material = {
+    m_tool_youngs_modulus, m_tool_poisson_ratio, m_tool_restitution_coef,
+    m_tool_friction_static, m_tool_friction_rolling
+  };
+  m_engine.setParticleMaterial(particle_material, m_particle_radius,
+                               m_particle_density);
+  m_engine.setToolMaterial(tool_material);
+  m_engine.setGravity(m_gravity);
+  m_engine.setDomain(m_domain);
+  m_engine.setToolMesh(m_tool_triangles);
 
   // fill mesh with DE's
+  auto count = m_engine.fill(m_fill_triangles);
+  gzmsg << "Cosimulator::initialize - filled geometry with " << count
+        << " particles" << std::endl;
+  if (count == 0) {
+    gzwarn << "Cosimulator::initialize - particle fill geometry is empty or "
+           << "outside of the workspace" << std::endl;
+  }
+  if (m_tool_triangles.empty()) {
+    gzwarn << "Cosimulator::initialize - tool mesh is empty" << std::endl;
+  }
 
-  // initialize rest of cosimulation
+  auto critical = m_engine.getCriticalTimestep();
+  if (m_timestep > MAX_CRITICAL_TIMESTEP_FRACTION * critical) {
+    gzwarn << "Cosimulator::initialize - timestep " << m_timestep
+           << " is too large for a stable simulation, it should not exceed "
+           << MAX_CRITICAL_TIMESTEP_FRACTION * critical << std::endl;
+  }
+
+  m_sim_time = 0.0;
+  m_relaxed = false;
 }
 
-void Cosimulator::relax(const int &max_it, const int &max_speed) {
-  gzwarn << "Cosimulator::relax - STUBBED" << std::endl;
-  gzwarn << "Cosimulator::relax     max_it=" << max_it << std::endl;
-  gzwarn << "Cosimulator::relax     max_speed="<< max_speed << std::endl;
+void Cosimulator::relax(const int &max_it, const double &max_speed) {
+  if (m_timestep <= 0.0) {
+    gzerr << "Cosimulator::relax - timestep must be positive" << std::endl;
+    return;
+  }
+
+  auto key = getBedKey(max_speed);
+  if (m_bed_cache.load(key, m_engine)) {
+    gzmsg << "Cosimulator::relax - loaded relaxed particles from "
+          << m_bed_cache.getPath(key) << std::endl;
+    m_relaxed = true;
+    return;
+  }
 
   // iterate till max_it or all particles are under max_speed
+  // Particles start at rest, so they must stay under max_speed for long enough
+  // that a particle falling freely would not.
+  auto gravity = m_gravity.Length();
+  int check_interval = 100;
+  if (gravity > 0.0) {
+    check_interval = std::max(1,
+      static_cast<int>(std::ceil(max_speed / (gravity * m_timestep))));
+  }
+  bool was_slow = false;
+  int it = 0;
+  for (; it < max_it; ++it) {
+    if (m_cancel_relax) {
+      return;
+    }
+    if (it % check_interval == 0) {
+      bool slow = m_engine.getMaxParticleSpeed() < max_speed;
+      if (slow && was_slow)
+        break;
+      was_slow = slow;
+    }
+    m_engine.step(m_timestep);
+  }
 
+  auto speed = m_engine.getMaxParticleSpeed();
+  if (speed >= max_speed) {
+    gzwarn << "Cosimulator::relax - particles still move at up to " << speed
+           << " m/s after " << it << " iterations" << std::endl;
+  } else if (m_bed_cache.save(key, m_engine)) {
+    gzmsg << "Cosimulator::relax - saved relaxed particles to "
+          << m_bed_cache.getPath(key) << std::endl;
+  }
   m_relaxed = true;
 }
 
+uint64_t Cosimulator::getBedKey(double max_speed) const
+{
+  BedKey key;
+  for (const auto &vertex : m_fill_triangles) {
+    key.add(vertex.X());
+    key.add(vertex.Y());
+    key.add(vertex.Z());
+  }
+  const auto &size = m_domain.Size();
+  const auto &pose = m_domain.Pose();
+  for (double value : {size.X(), size.Y(), size.Z(),
+                       pose.Pos().X(), pose.Pos().Y(), pose.Pos().Z(),
+                       pose.Rot().W(), pose.Rot().X(), pose.Rot().Y(),
+                       pose.Rot().Z(),
+                       m_particle_youngs_modulus, m_particle_poisson_ratio,
+                       m_particle_restitution_coef, m_particle_friction_static,
+                       m_particle_friction_rolling, m_particle_radius,
+                       m_particle_density,
+                       m_gravity.X(), m_gravity.Y(), m_gravity.Z(),
+                       m_timestep, max_speed}) {
+    key.add(value);
+  }
+  return key.get();
+}
+
 void Cosimulator::update(const ignition::math::Pose3d &tool_pose, double timestep,
   ignition::math::Vector3d &out_force, ignition::math::Vector3d &out_torque) {
-  gzwarn << "Cosimulator::update - STUBBED" << std::endl;
-  gzwarn << "Cosimulator::update     tool_pos=" << tool_pose << std::endl;
-  gzwarn << "Cosimulator::update     timestep=" << timestep << std::endl;
-  
   if (timestep <= 0) {
     out_force = ignition::math::Vector3d();
     out_torque = ignition::math::Vector3d();
     return;
   }
 
-  // update tool position in cosimulation
-
-  // run cosimulation for 1 timetep
-
-  // return forces and torques acted on scoops
-
+  m_engine.step(tool_pose, timestep, out_force, out_torque);
+  m_sim_time += timestep;
 }
 
 double Cosimulator::getSimTime(void)
 {
-  gzwarn << "Cosimulator::getSimTime - STUBBED" << std::endl;
-
-  // get in-sim time from cosimulation
-
-  return 0.0;
+  return m_sim_time;
 }
 
-void Cosimulator::setParticleFillGeometry(gazebo::common::Mesh mesh) {
-  gzwarn << "Cosimulator::setParticleFillGeometry - STUBBED" << std::endl;
-
-  // set the value of pfill_mesh, convert if needed
-
+void Cosimulator::setParticleFillGeometry(const gazebo::common::Mesh &mesh) {
+  m_fill_triangles.clear();
+  appendTriangles(mesh, m_fill_triangles);
 }
 
 void Cosimulator::setToolMesh(const std::string& path_to_mesh) {
-  gzwarn << "Cosimulator::setToolMesh - STUBBED" << std::endl;
-  gzwarn << "Cosimulator::setToolMesh     path_to_mesh="
-            << path_to_mesh << std::endl;
-
-  // set the value of tool_mesh, convert if needed
-
+  m_tool_triangles.clear();
+  const auto mesh = gazebo::common::MeshManager::Instance()->Load(path_to_mesh);
+  if (!mesh) {
+    gzerr << "Cosimulator::setToolMesh - failed to load " << path_to_mesh
+          << std::endl;
+    return;
+  }
+  appendTriangles(*mesh, m_tool_triangles);
 }
 
 void Cosimulator::setParticleProperties( double youngs_modulus, 
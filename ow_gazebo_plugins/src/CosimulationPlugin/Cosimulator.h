@@ -2,24 +2,24 @@
 // Research and Simulation can be found in README.md in the root directory of
 // this repository.
 
-// TODO:
-//   1) Add a mesh data structure to define the fill volume of discrete elements
-//   2) Add a mesh data structure to for the tool
-//   3) Add all necessary external physics simulation data structures and calls
-
 #ifndef Cosimulator_h
 #define Cosimulator_h
 
+#include <atomic>
+#include <string>
+
+#include <ignition/math/OrientedBox.hh>
 #include <ignition/math/Vector3.hh>
 #include <ignition/math/Pose3.hh>
 
 #include <gazebo/common/common.hh>
 
-// Cosimulator encapsulates the methods and data structures of a discrete
-// element method (DEM) API. 
+#include "DemEngine.h"
+#include "ParticleBedCache.h"
 
-// NOTE: A DEM API has not yet been implemented, so many of its methods are
-// stubs and this plugin does not presently function.
+// Cosimulator encapsulates the methods and data structures of a discrete
+// element method (DEM) API. The simulation itself is done by DemEngine, which
+// runs on the CPU using all of its cores.
 class Cosimulator
 {
 public:
@@ -29,8 +29,20 @@ public:
   void initialize(void);
 
   // relax DE geometry
+  // iterates until max_it iterations have been done or every particle moves
+  // slower than max_speed
   // can be ran in the background to shorten total simulation time
-  void relax(const int &max_it, const int &max_speed);
+  // loads the bed from the bed cache instead if it was relaxed under the same
+  // conditions before, and saves it there otherwise
+  void relax(const int &max_it, const double &max_speed);
+  // makes a relax running on another thread return early, as well as every
+  // relax after it until allowRelax is called
+  void cancelRelax(void) {
+    m_cancel_relax = true;
+  }
+  void allowRelax(void) {
+    m_cancel_relax = false;
+  }
   bool isRelaxed(void) {
     return m_relaxed;
   }
@@ -44,9 +56,15 @@ public:
   // return in-simulation time in seconds
   double getSimTime(void);
 
-  void setParticleFillGeometry(gazebo::common::Mesh mesh);
+  void setParticleFillGeometry(const gazebo::common::Mesh &mesh);
+  // the mesh is in the frame of the tool, whose pose is passed to update
   void setToolMesh(const std::string& path_to_mesh);
 
+  // particles are kept within the sides and above the bottom of box
+  void setDomain(const ignition::math::OrientedBoxd &box) {
+    m_domain = box;
+  }
+
   void setParticleProperties(
       double youngs_modulus,
       double poisson_ratio,
@@ -66,11 +84,30 @@ public:
     m_gravity = gravity_vector;
   }
 
+  // timestep relax iterates at
+  void setTimestep(double timestep) {
+    m_timestep = timestep;
+  }
+
+  // directory relaxed beds are kept in, none are if it is empty
+  void setBedCacheDirectory(const std::string &directory) {
+    m_bed_cache = ParticleBedCache(directory);
+  }
+
 private:
+  // identifies the conditions the bed is relaxed under
+  uint64_t getBedKey(double max_speed) const;
+
   // simulation parameters
   ignition::math::Vector3d m_gravity;
   double m_timestep;
-  bool m_relaxed;
+  // written by the task relaxing the particles, read by isRelaxed
+  std::atomic<bool> m_relaxed;
+  double m_sim_time;
+  // geometry
+  ignition::math::OrientedBoxd m_domain;
+  DemTriangles m_fill_triangles;
+  DemTriangles m_tool_triangles;
   // tool material properties
   double m_tool_youngs_modulus;
   double m_tool_poisson_ratio;
@@ -86,6 +123,9 @@ private:
   double m_particle_radius;
   double m_particle_density;
 
+  DemEngine m_engine;
+  ParticleBedCache m_bed_cache;
+  std::atomic<bool> m_cancel_relax;
 };
 
 #endif // Cosimulator_h
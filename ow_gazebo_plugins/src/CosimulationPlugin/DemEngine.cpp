@@ -0,0 +1,709 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#include "DemEngine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <random>
+
+using ignition::math::Pose3d;
+using ignition::math::Vector3d;
+
+namespace {
+
+// closest point to p on the triangle a, b, c, from Ericson's Real-Time
+// Collision Detection
+Vector3d closestPointOnTriangle(const Vector3d &p, const Vector3d &a,
+                                const Vector3d &b, const Vector3d &c)
+{
+  auto ab = b - a;
+  auto ac = c - a;
+  auto ap = p - a;
+  auto d1 = ab.Dot(ap);
+  auto d2 = ac.Dot(ap);
+  if (d1 <= 0.0 && d2 <= 0.0)
+    return a;
+
+  auto bp = p - b;
+  auto d3 = ab.Dot(bp);
+  auto d4 = ac.Dot(bp);
+  if (d3 >= 0.0 && d4 <= d3)
+    return b;
+
+  auto vc = d1 * d4 - d3 * d2;
+  if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+    return a + ab * (d1 / (d1 - d3));
+
+  auto cp = p - c;
+  auto d5 = ab.Dot(cp);
+  auto d6 = ac.Dot(cp);
+  if (d6 >= 0.0 && d5 <= d6)
+    return c;
+
+  auto vb = d5 * d2 - d1 * d6;
+  if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+    return a + ac * (d2 / (d2 - d6));
+
+  auto va = d3 * d6 - d5 * d4;
+  if (va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0)
+    return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+  auto denom = 1.0 / (va + vb + vc);
+  return a + ab * (vb * denom) + ac * (vc * denom);
+}
+
+} // namespace
+
+void DemEngine::setParticleMaterial(const DemMaterial &material, double radius,
+                                    double density)
+{
+  m_particle_material = material;
+  m_radius = radius;
+  m_density = density;
+  m_mass = density * 4.0 / 3.0 * M_PI * radius * radius * radius;
+  m_inertia = 0.4 * m_mass * radius * radius;
+  m_particle_model = makeContactModel(m_particle_material, true);
+  // walls stand in for the surrounding regolith
+  m_wall_model = makeContactModel(m_particle_material, false);
+  m_tool_model = makeContactModel(m_tool_material, false);
+}
+
+void DemEngine::setToolMaterial(const DemMaterial &material)
+{
+  m_tool_material = material;
+  m_tool_model = makeContactModel(m_tool_material, false);
+}
+
+DemEngine::ContactModel DemEngine::makeContactModel(const DemMaterial &other,
+                                                    bool other_is_particle) const
+{
+  const auto &p = m_particle_material;
+  ContactModel model = {};
+  if (p.youngs_modulus <= 0.0 || other.youngs_modulus <= 0.0 || m_radius <= 0.0)
+    return model;
+
+  auto youngs = 1.0 / ((1.0 - p.poisson_ratio * p.poisson_ratio) / p.youngs_modulus
+    + (1.0 - other.poisson_ratio * other.poisson_ratio) / other.youngs_modulus);
+  auto shear = 1.0 / (2.0 * (2.0 - p.poisson_ratio) * (1.0 + p.poisson_ratio) / p.youngs_modulus
+    + 2.0 * (2.0 - other.poisson_ratio) * (1.0 + other.poisson_ratio) / other.youngs_modulus);
+  auto radius = other_is_particle ? m_radius / 2.0 : m_radius;
+  auto mass = other_is_particle ? m_mass / 2.0 : m_mass;
+
+  auto restitution = std::min(std::max(other.restitution_coef, 1e-6), 1.0);
+  auto log_e = std::log(restitution);
+  auto beta = log_e / std::sqrt(log_e * log_e + M_PI * M_PI);
+
+  model.kn = 4.0 / 3.0 * youngs * std::sqrt(radius);
+  model.sn = 2.0 * youngs * std::sqrt(radius);
+  model.st = 8.0 * shear * std::sqrt(radius);
+  model.damping = -2.0 * std::sqrt(5.0 / 6.0) * beta * std::sqrt(mass);
+  model.friction_static = other.friction_static;
+  model.friction_rolling = other.friction_rolling;
+  return model;
+}
+
+double DemEngine::getCriticalTimestep(void) const
+{
+  const auto &p = m_particle_material;
+  if (p.youngs_modulus <= 0.0)
+    return 0.0;
+  auto shear = p.youngs_modulus / (2.0 * (1.0 + p.poisson_ratio));
+  return M_PI * m_radius * std::sqrt(m_density / shear)
+    / (0.1631 * p.poisson_ratio + 0.8766);
+}
+
+void DemEngine::setDomain(const ignition::math::OrientedBoxd &box)
+{
+  m_domain = box;
+  m_wall_points.clear();
+  m_wall_normals.clear();
+  auto half = box.Size() / 2.0;
+  const auto &rot = box.Pose().Rot();
+  const auto &center = box.Pose().Pos();
+  // bottom and four sides, normals pointing inwards
+  const Vector3d normals[] = {
+    Vector3d::UnitZ, Vector3d::UnitX, -Vector3d::UnitX,
+    Vector3d::UnitY, -Vector3d::UnitY
+  };
+  for (const auto &normal : normals) {
+    auto offset = Vector3d(-normal.X() * half.X(), -normal.Y() * half.Y(),
+                           -normal.Z() * half.Z());
+    m_wall_points.push_back(center + rot.RotateVector(offset));
+    m_wall_normals.push_back(rot.RotateVector(normal));
+  }
+  // particles flung higher than the box is deep above it are given up on
+  m_ceiling_point = center + rot.RotateVector(Vector3d(0, 0, 3.0 * half.Z()));
+  m_ceiling_normal = rot.RotateVector(-Vector3d::UnitZ);
+}
+
+void DemEngine::setToolMesh(const DemTriangles &triangles)
+{
+  m_tool_triangles = triangles;
+  m_tool_cell_start.assign(1, 0);
+  m_tool_cell_triangles.clear();
+  m_tool_pose_valid = false;
+  if (triangles.empty() || m_radius <= 0.0)
+    return;
+
+  // the grid covers the mesh plus a particle radius around it
+  Vector3d min = triangles.front();
+  Vector3d max = triangles.front();
+  for (const auto &v : triangles) {
+    min.Min(v);
+    max.Max(v);
+  }
+  min -= Vector3d(m_radius, m_radius, m_radius);
+  max += Vector3d(m_radius, m_radius, m_radius);
+  auto extent = max - min;
+  // cells a particle across, but not more than 64 along any axis
+  m_tool_cell_size = std::max(2.0 * m_radius, extent.Max() / 64.0);
+  m_tool_grid_min = min;
+  for (int axis = 0; axis < 3; ++axis)
+    m_tool_dims[axis] = std::max(1, static_cast<int>(
+      std::ceil(extent[axis] / m_tool_cell_size)));
+
+  auto cell_count = m_tool_dims[0] * m_tool_dims[1] * m_tool_dims[2];
+  auto for_cells = [&](size_t triangle, const std::function<void(int)> &visit) {
+    Vector3d lo = triangles[triangle * 3];
+    Vector3d hi = lo;
+    for (int k = 1; k < 3; ++k) {
+      lo.Min(triangles[triangle * 3 + k]);
+      hi.Max(triangles[triangle * 3 + k]);
+    }
+    int first[3], last[3];
+    for (int axis = 0; axis < 3; ++axis) {
+      first[axis] = std::max(0, static_cast<int>(std::floor(
+        (lo[axis] - m_radius - min[axis]) / m_tool_cell_size)));
+      last[axis] = std::min(m_tool_dims[axis] - 1, static_cast<int>(std::floor(
+        (hi[axis] + m_radius - min[axis]) / m_tool_cell_size)));
+    }
+    for (int x = first[0]; x <= last[0]; ++x)
+      for (int y = first[1]; y <= last[1]; ++y)
+        for (int z = first[2]; z <= last[2]; ++z)
+          visit((x * m_tool_dims[1] + y) * m_tool_dims[2] + z);
+  };
+
+  // counting sort of the triangles into the cells they are near
+  m_tool_cell_start.assign(cell_count + 1, 0);
+  auto triangle_count = triangles.size() / 3;
+  for (size_t t = 0; t < triangle_count; ++t)
+    for_cells(t, [this](int cell) { ++m_tool_cell_start[cell + 1]; });
+  for (int cell = 0; cell < cell_count; ++cell)
+    m_tool_cell_start[cell + 1] += m_tool_cell_start[cell];
+  m_tool_cell_triangles.resize(m_tool_cell_start.back());
+  std::vector<uint32_t> cursor(m_tool_cell_start.begin(),
+                               m_tool_cell_start.end() - 1);
+  for (size_t t = 0; t < triangle_count; ++t)
+    for_cells(t, [&](int cell) { m_tool_cell_triangles[cursor[cell]++] = t; });
+}
+
+size_t DemEngine::fill(const DemTriangles &fill_mesh)
+{
+  m_px.clear(); m_py.clear(); m_pz.clear();
+  if (fill_mesh.empty() || m_radius <= 0.0) {
+    resetParticles();
+    return 0;
+  }
+
+  // The fill mesh is brought into the frame of the domain, where the lattice
+  // is laid out in columns along Z. A point is inside of the mesh if a ray up
+  // from it crosses the mesh an odd number of times. Triangles are bucketed by
+  // the columns they cover so that every column only tests the few triangles
+  // above or below it.
+  const auto &domain_pose = m_domain.Pose();
+  DemTriangles local(fill_mesh.size());
+  for (size_t i = 0; i < fill_mesh.size(); ++i)
+    local[i] = domain_pose.Rot().RotateVectorReverse(fill_mesh[i] - domain_pose.Pos());
+
+  // a little room between particles, which jitter keeps from lining up in
+  // perfect columns that would never collapse
+  auto spacing = 2.02 * m_radius;
+  auto jitter = 0.01 * m_radius;
+  // centers stay far enough from the walls that jitter cannot push them in
+  auto margin = m_radius + jitter;
+  auto half = m_domain.Size() / 2.0 - Vector3d(margin, margin, margin);
+  if (half.X() < 0.0 || half.Y() < 0.0 || half.Z() < 0.0) {
+    resetParticles();
+    return 0;
+  }
+  int columns_x = static_cast<int>(2.0 * half.X() / spacing) + 1;
+  int columns_y = static_cast<int>(2.0 * half.Y() / spacing) + 1;
+  int layers = static_cast<int>(2.0 * half.Z() / spacing) + 1;
+
+  std::vector<std::vector<uint32_t>> column_triangles(columns_x * columns_y);
+  for (size_t t = 0; t < local.size() / 3; ++t) {
+    auto lo = local[t * 3];
+    auto hi = lo;
+    for (int k = 1; k < 3; ++k) {
+      lo.Min(local[t * 3 + k]);
+      hi.Max(local[t * 3 + k]);
+    }
+    int x0 = std::max(0, static_cast<int>(std::ceil((lo.X() + half.X()) / spacing)));
+    int x1 = std::min(columns_x - 1, static_cast<int>(std::floor((hi.X() + half.X()) / spacing)));
+    int y0 = std::max(0, static_cast<int>(std::ceil((lo.Y() + half.Y()) / spacing)));
+    int y1 = std::min(columns_y - 1, static_cast<int>(std::floor((hi.Y() + half.Y()) / spacing)));
+    for (int x = x0; x <= x1; ++x)
+      for (int y = y0; y <= y1; ++y)
+        column_triangles[x * columns_y + y].push_back(t);
+  }
+
+  std::mt19937 random(0);
+  std::uniform_real_distribution<double> offset(-jitter, jitter);
+  std::vector<double> crossings;
+  for (int x = 0; x < columns_x; ++x)
+    for (int y = 0; y < columns_y; ++y) {
+      double cx = -half.X() + x * spacing;
+      double cy = -half.Y() + y * spacing;
+      crossings.clear();
+      for (auto t : column_triangles[x * columns_y + y]) {
+        const auto &a = local[t * 3];
+        const auto &b = local[t * 3 + 1];
+        const auto &c = local[t * 3 + 2];
+        // barycentric coordinates of the column in the triangle's projection
+        auto det = (b.Y() - c.Y()) * (a.X() - c.X()) + (c.X() - b.X()) * (a.Y() - c.Y());
+        if (det == 0.0)
+          continue;
+        auto u = ((b.Y() - c.Y()) * (cx - c.X()) + (c.X() - b.X()) * (cy - c.Y())) / det;
+        auto v = ((c.Y() - a.Y()) * (cx - c.X()) + (a.X() - c.X()) * (cy - c.Y())) / det;
+        auto w = 1.0 - u - v;
+        if (u < 0.0 || v < 0.0 || w < 0.0)
+          continue;
+        crossings.push_back(u * a.Z() + v * b.Z() + w * c.Z());
+      }
+      if (crossings.empty())
+        continue;
+      std::sort(crossings.begin(), crossings.end());
+      for (int z = 0; z < layers; ++z) {
+        double cz = -half.Z() + z * spacing;
+        auto above = crossings.end()
+          - std::upper_bound(crossings.begin(), crossings.end(), cz);
+        if (above % 2 == 0)
+          continue;
+        auto position = domain_pose.Pos() + domain_pose.Rot().RotateVector(
+          Vector3d(cx + offset(random), cy + offset(random), cz + offset(random)));
+        m_px.push_back(position.X());
+        m_py.push_back(position.Y());
+        m_pz.push_back(position.Z());
+      }
+    }
+
+  resetParticles();
+  return m_px.size();
+}
+
+void DemEngine::resetParticles(void)
+{
+  auto count = m_px.size();
+  for (auto array : {&m_vx, &m_vy, &m_vz, &m_wx, &m_wy, &m_wz,
+                     &m_fx, &m_fy, &m_fz, &m_tx, &m_ty, &m_tz})
+    array->assign(count, 0.0);
+  m_active.assign(count, 1);
+  m_contact_partner.assign(count * MAX_CONTACTS, PARTNER_NONE);
+  m_contact_dx.assign(count * MAX_CONTACTS, 0.0);
+  m_contact_dy.assign(count * MAX_CONTACTS, 0.0);
+  m_contact_dz.assign(count * MAX_CONTACTS, 0.0);
+}
+
+namespace {
+
+// Layout of a state written by writeState: this header, followed by the
+// double arrays, the partners of the contacts, and the active flags. Wider
+// values come first, so that every array is aligned where the state is.
+struct StateHeader {
+  uint64_t particle_count;
+  uint32_t max_contacts;
+  uint32_t reserved;
+};
+
+}
+
+bool DemEngine::writeState(std::ostream &out) const
+{
+  StateHeader header = {m_px.size(), MAX_CONTACTS, 0};
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  for (auto array : {&m_px, &m_py, &m_pz, &m_vx, &m_vy, &m_vz,
+                     &m_wx, &m_wy, &m_wz,
+                     &m_contact_dx, &m_contact_dy, &m_contact_dz})
+    out.write(reinterpret_cast<const char *>(array->data()),
+              array->size() * sizeof(double));
+  out.write(reinterpret_cast<const char *>(m_contact_partner.data()),
+            m_contact_partner.size() * sizeof(int32_t));
+  out.write(reinterpret_cast<const char *>(m_active.data()), m_active.size());
+  return static_cast<bool>(out);
+}
+
+bool DemEngine::readState(const char *data, size_t size)
+{
+  StateHeader header;
+  if (size < sizeof(header))
+    return false;
+  std::memcpy(&header, data, sizeof(header));
+  const uint64_t count = header.particle_count;
+  const uint64_t slots = count * MAX_CONTACTS;
+  if (header.max_contacts != MAX_CONTACTS
+      || size != sizeof(header) + (9 * count + 3 * slots) * sizeof(double)
+                 + slots * sizeof(int32_t) + count)
+    return false;
+
+  auto cursor = data + sizeof(header);
+  auto read = [&cursor](void *out, size_t bytes) {
+    std::memcpy(out, cursor, bytes);
+    cursor += bytes;
+  };
+  for (auto array : {&m_px, &m_py, &m_pz, &m_vx, &m_vy, &m_vz,
+                     &m_wx, &m_wy, &m_wz}) {
+    array->resize(count);
+    read(array->data(), count * sizeof(double));
+  }
+  for (auto array : {&m_contact_dx, &m_contact_dy, &m_contact_dz}) {
+    array->resize(slots);
+    read(array->data(), slots * sizeof(double));
+  }
+  m_contact_partner.resize(slots);
+  read(m_contact_partner.data(), slots * sizeof(int32_t));
+  m_active.resize(count);
+  read(m_active.data(), count);
+  for (auto array : {&m_fx, &m_fy, &m_fz, &m_tx, &m_ty, &m_tz})
+    array->assign(count, 0.0);
+  return true;
+}
+
+size_t DemEngine::getActiveParticleCount(void) const
+{
+  return std::count(m_active.begin(), m_active.end(), 1);
+}
+
+double DemEngine::getMaxParticleSpeed(void) const
+{
+  double max_speed_squared = 0.0;
+  auto count = static_cast<long>(m_px.size());
+  #pragma omp parallel for reduction(max:max_speed_squared)
+  for (long i = 0; i < count; ++i)
+    if (m_active[i])
+      max_speed_squared = std::max(max_speed_squared,
+        m_vx[i] * m_vx[i] + m_vy[i] * m_vy[i] + m_vz[i] * m_vz[i]);
+  return std::sqrt(max_speed_squared);
+}
+
+void DemEngine::buildGrid(void)
+{
+  const auto count = static_cast<long>(m_px.size());
+  const auto cell_size = 2.0 * m_radius;
+  double min_x = HUGE_VAL, min_y = HUGE_VAL, min_z = HUGE_VAL;
+  double max_x = -HUGE_VAL, max_y = -HUGE_VAL, max_z = -HUGE_VAL;
+  #pragma omp parallel for \
+    reduction(min:min_x, min_y, min_z) reduction(max:max_x, max_y, max_z)
+  for (long i = 0; i < count; ++i)
+    if (m_active[i]) {
+      min_x = std::min(min_x, m_px[i]);
+      min_y = std::min(min_y, m_py[i]);
+      min_z = std::min(min_z, m_pz[i]);
+      max_x = std::max(max_x, m_px[i]);
+      max_y = std::max(max_y, m_py[i]);
+      max_z = std::max(max_z, m_pz[i]);
+    }
+  if (min_x > max_x) {
+    min_x = min_y = min_z = max_x = max_y = max_z = 0.0;
+  }
+
+  // one cell of border so that the neighbors of every cell exist
+  m_grid_min.Set(min_x, min_y, min_z);
+  m_grid_dims[0] = static_cast<int64_t>((max_x - min_x) / cell_size) + 3;
+  m_grid_dims[1] = static_cast<int64_t>((max_y - min_y) / cell_size) + 3;
+  m_grid_dims[2] = static_cast<int64_t>((max_z - min_z) / cell_size) + 3;
+  const auto cell_count = m_grid_dims[0] * m_grid_dims[1] * m_grid_dims[2];
+
+  m_particle_cell.resize(count);
+  #pragma omp parallel for
+  for (long i = 0; i < count; ++i) {
+    if (!m_active[i]) {
+      m_particle_cell[i] = cell_count;
+      continue;
+    }
+    auto x = static_cast<int64_t>((m_px[i] - m_grid_min.X()) / cell_size) + 1;
+    auto y = static_cast<int64_t>((m_py[i] - m_grid_min.Y()) / cell_size) + 1;
+    auto z = static_cast<int64_t>((m_pz[i] - m_grid_min.Z()) / cell_size) + 1;
+    m_particle_cell[i] = (x * m_grid_dims[1] + y) * m_grid_dims[2] + z;
+  }
+
+  // counting sort of the particles by cell, inactive ones are left out
+  m_cell_start.assign(cell_count + 1, 0);
+  for (long i = 0; i < count; ++i)
+    if (m_particle_cell[i] < cell_count)
+      ++m_cell_start[m_particle_cell[i] + 1];
+  for (int64_t c = 0; c < cell_count; ++c)
+    m_cell_start[c + 1] += m_cell_start[c];
+  m_cell_particles.resize(m_cell_start.back());
+  std::vector<uint32_t> cursor(m_cell_start.begin(), m_cell_start.end() - 1);
+  for (long i = 0; i < count; ++i)
+    if (m_particle_cell[i] < cell_count)
+      m_cell_particles[cursor[m_particle_cell[i]]++] = i;
+}
+
+bool DemEngine::closestToolPoint(const Vector3d &point, Vector3d &out_closest) const
+{
+  auto local = m_tool_pose.Rot().RotateVectorReverse(point - m_tool_pose.Pos());
+  int cell[3];
+  for (int axis = 0; axis < 3; ++axis) {
+    cell[axis] = static_cast<int>(std::floor(
+      (local[axis] - m_tool_grid_min[axis]) / m_tool_cell_size));
+    if (cell[axis] < 0 || cell[axis] >= m_tool_dims[axis])
+      return false;
+  }
+  auto index = (cell[0] * m_tool_dims[1] + cell[1]) * m_tool_dims[2] + cell[2];
+
+  // only the closest triangle makes contact, so that a particle on an edge
+  // between two triangles is not pushed twice
+  auto best_distance = m_radius * m_radius;
+  auto found = false;
+  Vector3d best;
+  for (auto k = m_tool_cell_start[index]; k < m_tool_cell_start[index + 1]; ++k) {
+    auto t = m_tool_cell_triangles[k];
+    auto closest = closestPointOnTriangle(local, m_tool_triangles[t * 3],
+      m_tool_triangles[t * 3 + 1], m_tool_triangles[t * 3 + 2]);
+    auto distance = (closest - local).SquaredLength();
+    if (distance < best_distance) {
+      best_distance = distance;
+      best = closest;
+      found = true;
+    }
+  }
+  if (found)
+    out_closest = m_tool_pose.Pos() + m_tool_pose.Rot().RotateVector(best);
+  return found;
+}
+
+void DemEngine::step(const Pose3d &tool_pose, double timestep,
+                     Vector3d &out_force, Vector3d &out_torque)
+{
+  out_force = Vector3d::Zero;
+  out_torque = Vector3d::Zero;
+  if (timestep <= 0.0)
+    return;
+
+  // the tool's velocity is the one that takes it from its last pose to the
+  // new one over the step
+  if (!m_tool_pose_valid) {
+    m_tool_pose = tool_pose;
+    m_tool_pose_valid = true;
+  }
+  auto linear_velocity = (tool_pose.Pos() - m_tool_pose.Pos()) / timestep;
+  auto rotation = tool_pose.Rot() * m_tool_pose.Rot().Inverse();
+  Vector3d axis;
+  double angle;
+  rotation.ToAxis(axis, angle);
+  if (angle > M_PI)
+    angle -= 2.0 * M_PI;
+  auto angular_velocity = axis * (angle / timestep);
+  m_tool_pose = tool_pose;
+
+  buildGrid();
+  computeForces(!m_tool_triangles.empty(), timestep, linear_velocity,
+                angular_velocity, out_force, out_torque);
+  integrate(timestep);
+}
+
+void DemEngine::step(double timestep)
+{
+  if (timestep <= 0.0)
+    return;
+  Vector3d force, torque;
+  buildGrid();
+  computeForces(false, timestep, Vector3d::Zero, Vector3d::Zero, force, torque);
+  integrate(timestep);
+}
+
+void DemEngine::computeForces(bool with_tool, double timestep,
+                              const Vector3d &tool_linear_velocity,
+                              const Vector3d &tool_angular_velocity,
+                              Vector3d &out_force, Vector3d &out_torque)
+{
+  const auto count = static_cast<long>(m_px.size());
+  const auto radius = m_radius;
+  const auto contact_distance_squared = 4.0 * radius * radius;
+  const auto tool_origin = m_tool_pose.Pos();
+  double tool_fx = 0.0, tool_fy = 0.0, tool_fz = 0.0;
+  double tool_tx = 0.0, tool_ty = 0.0, tool_tz = 0.0;
+
+  #pragma omp parallel for \
+    reduction(+:tool_fx, tool_fy, tool_fz, tool_tx, tool_ty, tool_tz)
+  for (long i = 0; i < count; ++i) {
+    if (!m_active[i]) {
+      m_fx[i] = m_fy[i] = m_fz[i] = m_tx[i] = m_ty[i] = m_tz[i] = 0.0;
+      continue;
+    }
+    const Vector3d position(m_px[i], m_py[i], m_pz[i]);
+    const Vector3d velocity(m_vx[i], m_vy[i], m_vz[i]);
+    const Vector3d spin(m_wx[i], m_wy[i], m_wz[i]);
+    const auto spin_length = spin.Length();
+    Vector3d force = m_gravity * m_mass;
+    Vector3d torque;
+
+    // contacts of the previous step, the slots are rewritten with this step's
+    const auto slots = i * MAX_CONTACTS;
+    int32_t old_partners[MAX_CONTACTS];
+    Vector3d old_displacements[MAX_CONTACTS];
+    for (int k = 0; k < MAX_CONTACTS; ++k) {
+      old_partners[k] = m_contact_partner[slots + k];
+      old_displacements[k].Set(m_contact_dx[slots + k], m_contact_dy[slots + k],
+                               m_contact_dz[slots + k]);
+    }
+    int contact_count = 0;
+
+    // Applies the force of a contact to the particle and returns it. normal
+    // points from the particle's center towards the contact, overlap is how
+    // far the surfaces interpenetrate and partner_velocity the velocity of
+    // the partner's surface at the contact.
+    auto resolve = [&](int32_t partner, const Vector3d &normal, double overlap,
+                       const Vector3d &partner_velocity, const ContactModel &model) {
+      auto relative = velocity + spin.Cross(normal * radius) - partner_velocity;
+      auto normal_speed = relative.Dot(normal);
+      auto tangential = relative - normal * normal_speed;
+
+      Vector3d displacement;
+      for (int k = 0; k < MAX_CONTACTS; ++k)
+        if (old_partners[k] == partner) {
+          displacement = old_displacements[k];
+          break;
+        }
+      // keep the spring in the tangent plane as the contact rotates
+      displacement -= normal * displacement.Dot(normal);
+      displacement += tangential * timestep;
+
+      auto root = std::sqrt(overlap);
+      auto normal_stiffness = model.sn * root;
+      auto tangential_stiffness = model.st * root;
+      auto normal_force = std::max(0.0, model.kn * overlap * root
+        + model.damping * std::sqrt(normal_stiffness) * normal_speed);
+      auto tangential_force = displacement * -tangential_stiffness
+        - tangential * (model.damping * std::sqrt(tangential_stiffness));
+      // sliding once friction is exceeded, the spring stretches no further
+      auto friction_limit = model.friction_static * normal_force;
+      auto tangential_length = tangential_force.Length();
+      if (tangential_length > friction_limit) {
+        tangential_force *= friction_limit / tangential_length;
+        displacement = tangential_stiffness > 0.0
+          ? tangential_force / -tangential_stiffness : Vector3d::Zero;
+      }
+
+      auto contact_force = tangential_force - normal * normal_force;
+      force += contact_force;
+      torque += (normal * radius).Cross(tangential_force);
+      // rolling resistance, at most what stops the particle's spin this step
+      if (spin_length > 0.0)
+        torque -= spin * (std::min(model.friction_rolling * normal_force * radius,
+                                   m_inertia * spin_length / timestep) / spin_length);
+
+      if (contact_count < MAX_CONTACTS) {
+        m_contact_partner[slots + contact_count] = partner;
+        m_contact_dx[slots + contact_count] = displacement.X();
+        m_contact_dy[slots + contact_count] = displacement.Y();
+        m_contact_dz[slots + contact_count] = displacement.Z();
+        ++contact_count;
+      }
+      return contact_force;
+    };
+
+    // other particles in the 27 cells around this one, which are nine runs
+    // of three consecutive cells
+    const int64_t stride_x = m_grid_dims[1] * m_grid_dims[2];
+    const int64_t stride_y = m_grid_dims[2];
+    for (int dx = -1; dx <= 1; ++dx)
+      for (int dy = -1; dy <= 1; ++dy) {
+        auto center = m_particle_cell[i] + dx * stride_x + dy * stride_y;
+        auto end = m_cell_start[center + 2];
+        for (auto k = m_cell_start[center - 1]; k < end; ++k) {
+          auto j = m_cell_particles[k];
+          if (j == static_cast<uint32_t>(i))
+            continue;
+          Vector3d offset(m_px[j] - position.X(), m_py[j] - position.Y(),
+                          m_pz[j] - position.Z());
+          auto distance_squared = offset.SquaredLength();
+          if (distance_squared >= contact_distance_squared || distance_squared == 0.0)
+            continue;
+          auto distance = std::sqrt(distance_squared);
+          auto normal = offset / distance;
+          auto partner_velocity = Vector3d(m_vx[j], m_vy[j], m_vz[j])
+            + Vector3d(m_wx[j], m_wy[j], m_wz[j]).Cross(normal * -radius);
+          resolve(j, normal, 2.0 * radius - distance, partner_velocity,
+                  m_particle_model);
+        }
+      }
+
+    for (size_t w = 0; w < m_wall_points.size(); ++w) {
+      auto distance = (position - m_wall_points[w]).Dot(m_wall_normals[w]);
+      if (distance < radius)
+        resolve(PARTNER_WALL - static_cast<int32_t>(w), -m_wall_normals[w], radius - distance,
+                Vector3d::Zero, m_wall_model);
+    }
+
+    Vector3d closest;
+    if (with_tool && closestToolPoint(position, closest)) {
+      auto offset = closest - position;
+      auto distance = offset.Length();
+      if (distance > 0.0) {
+        auto lever = closest - tool_origin;
+        auto tool_velocity = tool_linear_velocity + tool_angular_velocity.Cross(lever);
+        auto reaction = -resolve(PARTNER_TOOL, offset / distance, radius - distance,
+                                 tool_velocity, m_tool_model);
+        auto reaction_torque = lever.Cross(reaction);
+        tool_fx += reaction.X();
+        tool_fy += reaction.Y();
+        tool_fz += reaction.Z();
+        tool_tx += reaction_torque.X();
+        tool_ty += reaction_torque.Y();
+        tool_tz += reaction_torque.Z();
+      }
+    }
+
+    for (int k = contact_count; k < MAX_CONTACTS; ++k)
+      m_contact_partner[slots + k] = PARTNER_NONE;
+    m_fx[i] = force.X();
+    m_fy[i] = force.Y();
+    m_fz[i] = force.Z();
+    m_tx[i] = torque.X();
+    m_ty[i] = torque.Y();
+    m_tz[i] = torque.Z();
+  }
+
+  out_force.Set(tool_fx, tool_fy, tool_fz);
+  out_torque.Set(tool_tx, tool_ty, tool_tz);
+}
+
+void DemEngine::integrate(double timestep)
+{
+  const auto count = static_cast<long>(m_px.size());
+  const auto linear = timestep / m_mass;
+  const auto angular = timestep / m_inertia;
+
+  // semi-implicit Euler
+  #pragma omp parallel for
+  for (long i = 0; i < count; ++i) {
+    if (!m_active[i])
+      continue;
+    m_vx[i] += m_fx[i] * linear;
+    m_vy[i] += m_fy[i] * linear;
+    m_vz[i] += m_fz[i] * linear;
+    m_px[i] += m_vx[i] * timestep;
+    m_py[i] += m_vy[i] * timestep;
+    m_pz[i] += m_vz[i] * timestep;
+    m_wx[i] += m_tx[i] * angular;
+    m_wy[i] += m_ty[i] * angular;
+    m_wz[i] += m_tz[i] * angular;
+
+    // particles whose center passed through a wall left the domain, and
+    // particles carried out over the top and dropped outside of it would
+    // otherwise fall forever, those far above it would stretch the grid
+    const Vector3d position(m_px[i], m_py[i], m_pz[i]);
+    for (size_t w = 0; w < m_wall_points.size(); ++w)
+      if ((position - m_wall_points[w]).Dot(m_wall_normals[w]) < 0.0)
+        m_active[i] = 0;
+    if (!m_wall_points.empty()
+        && (position - m_ceiling_point).Dot(m_ceiling_normal) < 0.0)
+      m_active[i] = 0;
+  }
+}
@@ -0,0 +1,195 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#ifndef DemEngine_h
+#define DemEngine_h
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include <ignition/math/OrientedBox.hh>
+#include <ignition/math/Pose3.hh>
+#include <ignition/math/Vector3.hh>
+
+// Material of a surface that takes part in contacts
+struct DemMaterial {
+  double youngs_modulus;
+  double poisson_ratio;
+  double restitution_coef;
+  double friction_static;
+  double friction_rolling;
+};
+
+// Triangle soup, every three consecutive vertices are a triangle
+typedef std::vector<ignition::math::Vector3d> DemTriangles;
+
+// DemEngine is a discrete element method (DEM) simulation of equally sized
+// spherical particles that runs on the CPU. Particles collide with each other,
+// with the walls of a domain box, and with a kinematic tool given as a
+// triangle mesh, whose pose is prescribed every step. Contacts follow the
+// Hertz-Mindlin no-slip model with viscous damping derived from the
+// coefficient of restitution, Coulomb friction, and a constant rolling
+// resistance torque.
+//
+// Particle state is kept in separate arrays per component so that the loops
+// over particles stay cache friendly. Neighbors are found through a uniform
+// grid of cells as large as a particle that is fitted around the particles
+// every step. Particles are sorted by cell, so that the neighbors of a
+// particle lie in nine contiguous runs of cells. Forces are computed per
+// particle, each particle summing the forces that act on it, so the contact
+// stage runs in parallel with OpenMP without any synchronization between
+// threads.
+class DemEngine
+{
+public:
+  DemEngine() = default;
+
+  void setParticleMaterial(const DemMaterial &material, double radius,
+                           double density);
+  void setToolMaterial(const DemMaterial &material);
+  void setGravity(const ignition::math::Vector3d &gravity) {
+    m_gravity = gravity;
+  }
+
+  // The bottom and the sides of the box are walls that keep particles in,
+  // its top is open. The walls are made of the particles' material.
+  void setDomain(const ignition::math::OrientedBoxd &box);
+
+  // triangles of the tool in its own frame
+  void setToolMesh(const DemTriangles &triangles);
+
+  // Replaces all particles by particles on a cubic lattice that fills the
+  // part of the domain that is inside of the closed triangle mesh.
+  // returns: the number of particles
+  size_t fill(const DemTriangles &fill_mesh);
+
+  // Advances the simulation by timestep with the tool moving from its
+  // previous pose to tool_pose over the step.
+  // outputs: the force and torque particles exerted on the tool in the world
+  //          frame, the torque about the origin of tool_pose
+  void step(const ignition::math::Pose3d &tool_pose, double timestep,
+            ignition::math::Vector3d &out_force,
+            ignition::math::Vector3d &out_torque);
+
+  // advances the simulation by timestep without the tool
+  void step(double timestep);
+
+  size_t getParticleCount(void) const {
+    return m_px.size();
+  }
+  size_t getActiveParticleCount(void) const;
+  double getMaxParticleSpeed(void) const;
+
+  // the Rayleigh time step, steps should be a fraction of it
+  double getCriticalTimestep(void) const;
+
+  // Writes the state of the particles, which readState restores, so that
+  // relaxed particle beds can be saved.
+  bool writeState(std::ostream &out) const;
+  // Restores a state of size bytes that writeState wrote, data need not be
+  // aligned. Returns false and leaves the particles as they were if data is
+  // not such a state.
+  bool readState(const char *data, size_t size);
+
+private:
+  // Contact parameters for one pair of materials, see computeForces
+  struct ContactModel {
+    // normal force is kn * overlap^1.5
+    double kn;
+    // normal and tangential stiffness are sn * overlap^0.5 and st * overlap^0.5
+    double sn;
+    double st;
+    // damping coefficients are damping * sqrt(stiffness)
+    double damping;
+    double friction_static;
+    double friction_rolling;
+  };
+
+  // partners of contacts that are not particles
+  enum : int32_t { PARTNER_NONE = -1, PARTNER_TOOL = -2, PARTNER_WALL = -3 };
+
+  // contacts per particle whose tangential displacement is kept from step to
+  // step, further contacts start over every step
+  static const int MAX_CONTACTS = 16;
+
+  // the other material's coefficients describe the interaction, partners that
+  // are not particles are infinitely large and heavy
+  ContactModel makeContactModel(const DemMaterial &other,
+                                bool other_is_particle) const;
+
+  // sizes the state of every particle in m_px, m_py and m_pz, which are left
+  // at rest, active and without contacts
+  void resetParticles(void);
+
+  void buildGrid(void);
+
+  // closest point of the tool to a point, false if none is within the radius
+  bool closestToolPoint(const ignition::math::Vector3d &point,
+                        ignition::math::Vector3d &out_closest) const;
+
+  void computeForces(bool with_tool, double timestep,
+                     const ignition::math::Vector3d &tool_linear_velocity,
+                     const ignition::math::Vector3d &tool_angular_velocity,
+                     ignition::math::Vector3d &out_force,
+                     ignition::math::Vector3d &out_torque);
+
+  void integrate(double timestep);
+
+  // material
+  DemMaterial m_particle_material = {};
+  DemMaterial m_tool_material = {};
+  double m_radius = 0.0;
+  double m_density = 0.0;
+  double m_mass = 0.0;
+  double m_inertia = 0.0;
+  ContactModel m_particle_model = {};
+  ContactModel m_tool_model = {};
+  ContactModel m_wall_model = {};
+  ignition::math::Vector3d m_gravity;
+
+  // domain walls, as points on them and normals pointing into the domain
+  ignition::math::OrientedBoxd m_domain;
+  std::vector<ignition::math::Vector3d> m_wall_points;
+  std::vector<ignition::math::Vector3d> m_wall_normals;
+  ignition::math::Vector3d m_ceiling_point;
+  ignition::math::Vector3d m_ceiling_normal;
+
+  // particle state
+  std::vector<double> m_px, m_py, m_pz;
+  std::vector<double> m_vx, m_vy, m_vz;
+  std::vector<double> m_wx, m_wy, m_wz;
+  std::vector<double> m_fx, m_fy, m_fz;
+  std::vector<double> m_tx, m_ty, m_tz;
+  // particles that left the domain are no longer simulated, see integrate
+  std::vector<uint8_t> m_active;
+
+  // MAX_CONTACTS slots per particle of contact partners and the tangential
+  // displacements of the contacts
+  std::vector<int32_t> m_contact_partner;
+  std::vector<double> m_contact_dx, m_contact_dy, m_contact_dz;
+
+  // Grid from m_grid_min, the lowest corner of the active particles, with a
+  // border of empty cells around them. Cells are numbered along Z first, then
+  // Y, then X. The particles of cell c are
+  // m_cell_particles[m_cell_start[c] to m_cell_start[c + 1]].
+  ignition::math::Vector3d m_grid_min;
+  int64_t m_grid_dims[3] = {0, 0, 0};
+  std::vector<uint32_t> m_cell_start;
+  std::vector<uint32_t> m_cell_particles;
+  std::vector<uint32_t> m_particle_cell;
+
+  // tool triangles in the tool's frame, and a grid over them in which each
+  // cell lists the triangles within a particle radius of it
+  DemTriangles m_tool_triangles;
+  ignition::math::Vector3d m_tool_grid_min;
+  double m_tool_cell_size = 0.0;
+  int m_tool_dims[3] = {0, 0, 0};
+  std::vector<uint32_t> m_tool_cell_start;
+  std::vector<uint32_t> m_tool_cell_triangles;
+  ignition::math::Pose3d m_tool_pose;
+  bool m_tool_pose_valid = false;
+};
+
+#endif // DemEngine_h
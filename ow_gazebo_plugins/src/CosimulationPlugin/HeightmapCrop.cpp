@@ -0,0 +1,280 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#include "HeightmapCrop.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#include <gazebo/common/Console.hh>
+
+using namespace gazebo;
+using ignition::math::Vector3d;
+
+HeightmapCrop::HeightmapCrop()
+  : m_window_column(0), m_window_row(0), m_window_columns(0),
+    m_window_rows(0), m_columns(0), m_rows(0), m_height_offset(0.0f),
+    m_submesh(nullptr)
+{
+}
+
+bool HeightmapCrop::initialize(const physics::WorldPtr &world,
+                               const ignition::math::OrientedBoxd &box)
+{
+  if (m_shape) {
+    return true;
+  }
+  physics::CollisionPtr heightmap_collision;
+  for (const auto &model : world->Models()) {
+    for (const auto &link : model->GetLinks()) {
+      for (const auto &collision : link->GetCollisions()) {
+        auto shape = boost::dynamic_pointer_cast<physics::HeightmapShape>(
+          collision->GetShape());
+        if (shape) {
+          m_shape = shape;
+          heightmap_collision = collision;
+        }
+      }
+    }
+  }
+  if (!m_shape) {
+    return false;
+  }
+  m_box = box;
+
+  // heightmap columns run along +X and rows along -Y from its first vertex
+  auto origin = heightmap_collision->WorldPose().Pos() + m_shape->Pos();
+  auto size = m_shape->Size();
+  auto count = m_shape->VertexCount();
+  int heightmap_columns = count.X();
+  int heightmap_rows = count.Y();
+  double origin_x = origin.X() - size.X() / 2.0;
+  double origin_y = origin.Y() + size.Y() / 2.0;
+  double columns_per_meter = (heightmap_columns - 1) / size.X();
+  double rows_per_meter = (heightmap_rows - 1) / size.Y();
+  m_height_offset = origin.Z() - box.Pose().Pos().Z();
+
+  // a grid about as fine as the heightmap
+  const auto &pose = box.Pose();
+  auto half = box.Size() / 2.0;
+  double spacing = std::min(1.0 / columns_per_meter, 1.0 / rows_per_meter);
+  m_columns = std::max(2, static_cast<int>(std::ceil(box.Size().X() / spacing)) + 1);
+  m_rows = std::max(2, static_cast<int>(std::ceil(box.Size().Y() / spacing)) + 1);
+  const int vertex_count = m_columns * m_rows;
+  m_local_x.resize(vertex_count);
+  m_local_y.resize(vertex_count);
+  m_cell.assign(vertex_count, 0);
+  m_cell_x.assign(vertex_count, 0.0f);
+  m_cell_y.assign(vertex_count, 0.0f);
+  m_off_terrain.assign(vertex_count, 1.0f);
+
+  // find the heightmap cell of every vertex, and the window of heightmap
+  // vertices the cells span
+  std::vector<int> cell_columns(vertex_count, 0);
+  std::vector<int> cell_rows(vertex_count, 0);
+  int min_column = INT_MAX, max_column = INT_MIN;
+  int min_row = INT_MAX, max_row = INT_MIN;
+  for (int r = 0; r < m_rows; ++r) {
+    for (int c = 0; c < m_columns; ++c) {
+      const int k = r * m_columns + c;
+      m_local_x[k] = -half.X() + c * box.Size().X() / (m_columns - 1);
+      m_local_y[k] = -half.Y() + r * box.Size().Y() / (m_rows - 1);
+      auto world_point = pose.Pos()
+        + pose.Rot().RotateVector(Vector3d(m_local_x[k], m_local_y[k], 0.0));
+      double column = (world_point.X() - origin_x) * columns_per_meter;
+      double row = (origin_y - world_point.Y()) * rows_per_meter;
+      if (!(column >= 0.0 && column <= heightmap_columns - 1
+            && row >= 0.0 && row <= heightmap_rows - 1)) {
+        continue;
+      }
+      // the last column and row use the cell before them
+      cell_columns[k] = std::min(static_cast<int>(column), heightmap_columns - 2);
+      cell_rows[k] = std::min(static_cast<int>(row), heightmap_rows - 2);
+      m_cell_x[k] = column - cell_columns[k];
+      m_cell_y[k] = row - cell_rows[k];
+      m_off_terrain[k] = 0.0f;
+      min_column = std::min(min_column, cell_columns[k]);
+      max_column = std::max(max_column, cell_columns[k]);
+      min_row = std::min(min_row, cell_rows[k]);
+      max_row = std::max(max_row, cell_rows[k]);
+    }
+  }
+
+  if (max_column < min_column) {
+    gzwarn << "HeightmapCrop::initialize - box does not overlap the heightmap"
+           << std::endl;
+    // a window of zeros that every vertex's cell can index
+    m_window.assign(4, 0.0f);
+  } else {
+    m_window_column = min_column;
+    m_window_row = min_row;
+    m_window_columns = max_column - min_column + 2;
+    m_window_rows = max_row - min_row + 2;
+    m_window.resize(m_window_columns * m_window_rows);
+    for (int r = 0; r < m_window_rows; ++r) {
+      for (int c = 0; c < m_window_columns; ++c) {
+        m_window[r * m_window_columns + c] =
+          m_shape->GetHeight(m_window_column + c, m_window_row + r);
+      }
+    }
+    for (int k = 0; k < vertex_count; ++k) {
+      if (m_off_terrain[k] == 0.0f) {
+        m_cell[k] = (cell_rows[k] - m_window_row) * m_window_columns
+          + cell_columns[k] - m_window_column;
+      }
+    }
+  }
+
+  // Top vertices come first and bottom ones after them, the bottom is a copy
+  // of the top's grid at the bottom of the box. Faces wind counterclockwise
+  // seen from outside.
+  m_submesh = new common::SubMesh();
+  m_submesh->SetPrimitiveType(common::SubMesh::TRIANGLES);
+  for (int k = 0; k < vertex_count; ++k) {
+    m_submesh->AddVertex(Vector3d::Zero);
+  }
+  for (int k = 0; k < vertex_count; ++k) {
+    m_submesh->AddVertex(pose.Pos() + pose.Rot().RotateVector(
+      Vector3d(m_local_x[k], m_local_y[k], -half.Z())));
+  }
+  auto add_triangle = [this](int a, int b, int c) {
+    m_submesh->AddIndex(a);
+    m_submesh->AddIndex(b);
+    m_submesh->AddIndex(c);
+  };
+  for (int r = 0; r + 1 < m_rows; ++r) {
+    for (int c = 0; c + 1 < m_columns; ++c) {
+      const int v00 = r * m_columns + c;
+      const int v10 = v00 + 1;
+      const int v01 = v00 + m_columns;
+      const int v11 = v01 + 1;
+      add_triangle(v00, v10, v11);
+      add_triangle(v00, v11, v01);
+      add_triangle(vertex_count + v00, vertex_count + v11, vertex_count + v10);
+      add_triangle(vertex_count + v00, vertex_count + v01, vertex_count + v11);
+    }
+  }
+  // walls between the top's edge and the bottom's, going counterclockwise
+  // around the box seen from above
+  auto add_wall = [&](int a, int b) {
+    add_triangle(vertex_count + a, vertex_count + b, b);
+    add_triangle(vertex_count + a, b, a);
+  };
+  const int last_row = (m_rows - 1) * m_columns;
+  for (int c = 0; c + 1 < m_columns; ++c) {
+    add_wall(c, c + 1);
+    add_wall(last_row + c + 1, last_row + c);
+  }
+  for (int r = 0; r + 1 < m_rows; ++r) {
+    add_wall(r * m_columns + m_columns - 1, (r + 1) * m_columns + m_columns - 1);
+    add_wall((r + 1) * m_columns, r * m_columns);
+  }
+  m_mesh.AddSubMesh(m_submesh);
+
+  std::vector<uint32_t> all(vertex_count);
+  for (int k = 0; k < vertex_count; ++k) {
+    all[k] = k;
+  }
+  updateVertices(all);
+  return true;
+}
+
+bool HeightmapCrop::update(void)
+{
+  if (!m_shape) {
+    return false;
+  }
+
+  // find the window vertices whose heights changed
+  int min_column = INT_MAX, max_column = INT_MIN;
+  int min_row = INT_MAX, max_row = INT_MIN;
+  for (int r = 0; r < m_window_rows; ++r) {
+    for (int c = 0; c < m_window_columns; ++c) {
+      float height = m_shape->GetHeight(m_window_column + c, m_window_row + r);
+      float &cached = m_window[r * m_window_columns + c];
+      if (height != cached) {
+        cached = height;
+        min_column = std::min(min_column, c);
+        max_column = std::max(max_column, c);
+        min_row = std::min(min_row, r);
+        max_row = std::max(max_row, r);
+      }
+    }
+  }
+  if (max_column < min_column) {
+    return false;
+  }
+
+  // a vertex moves if any corner of its cell changed
+  std::vector<uint32_t> moved;
+  const int vertex_count = m_columns * m_rows;
+  for (int k = 0; k < vertex_count; ++k) {
+    const int c = m_cell[k] % m_window_columns;
+    const int r = m_cell[k] / m_window_columns;
+    if (m_off_terrain[k] == 0.0f && c + 1 >= min_column && c <= max_column
+        && r + 1 >= min_row && r <= max_row) {
+      moved.push_back(k);
+    }
+  }
+  updateVertices(moved);
+  return true;
+}
+
+void HeightmapCrop::updateVertices(const std::vector<uint32_t> &vertices)
+{
+  const auto count = vertices.size();
+  m_world_x.resize(count);
+  m_world_y.resize(count);
+  m_world_z.resize(count);
+
+  const auto &pose = m_box.Pose();
+  const auto center = pose.Pos();
+  const auto x_axis = pose.Rot().RotateVector(Vector3d::UnitX);
+  const auto y_axis = pose.Rot().RotateVector(Vector3d::UnitY);
+  const auto z_axis = pose.Rot().RotateVector(Vector3d::UnitZ);
+  const float bottom = -m_box.Size().Z() / 2.0;
+  const float top = m_box.Size().Z() / 2.0;
+  const float offset = m_height_offset;
+  const int stride = m_window_columns;
+
+  // plain arrays and no branches, so that this loop is vectorized
+  const uint32_t *index = vertices.data();
+  const float *window = m_window.data();
+  const int32_t *cell = m_cell.data();
+  const float *cell_x = m_cell_x.data();
+  const float *cell_y = m_cell_y.data();
+  const float *off_terrain = m_off_terrain.data();
+  const double *local_x = m_local_x.data();
+  const double *local_y = m_local_y.data();
+  double *world_x = m_world_x.data();
+  double *world_y = m_world_y.data();
+  double *world_z = m_world_z.data();
+  #pragma omp simd
+  for (size_t n = 0; n < count; ++n) {
+    const auto k = index[n];
+    const auto first = cell[k];
+    const float fx = cell_x[k];
+    const float fy = cell_y[k];
+    // bilinear between the corners of the heightmap cell
+    const float near_row = window[first] * (1.0f - fx) + window[first + 1] * fx;
+    const float far_row = window[first + stride] * (1.0f - fx)
+      + window[first + stride + 1] * fx;
+    float z = near_row * (1.0f - fy) + far_row * fy + offset;
+    z = std::min(std::max(z, bottom), top);
+    // vertices off of the heightmap are at the bottom of the box
+    z += off_terrain[k] * (bottom - z);
+    world_x[n] = center.X() + local_x[k] * x_axis.X() + local_y[k] * y_axis.X()
+      + z * z_axis.X();
+    world_y[n] = center.Y() + local_x[k] * x_axis.Y() + local_y[k] * y_axis.Y()
+      + z * z_axis.Y();
+    world_z[n] = center.Z() + local_x[k] * x_axis.Z() + local_y[k] * y_axis.Z()
+      + z * z_axis.Z();
+  }
+
+  for (size_t n = 0; n < count; ++n) {
+    m_submesh->SetVertex(vertices[n],
+                         Vector3d(world_x[n], world_y[n], world_z[n]));
+  }
+}
@@ -0,0 +1,93 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#ifndef HeightmapCrop_h
+#define HeightmapCrop_h
+
+#include <cstdint>
+#include <vector>
+
+#include <ignition/math/OrientedBox.hh>
+
+#include <gazebo/common/Mesh.hh>
+#include <gazebo/physics/physics.hh>
+
+// HeightmapCrop builds a closed mesh of the part of the terrain that is inside
+// of a box: its top follows the physics heightmap and all other sides match
+// the box boundaries. Heights are read from the physics heightmap, so this
+// works without a rendering scene, as in gzserver.
+//
+// The top is a grid in the frame of the box with about the spacing of the
+// heightmap, whose vertices are interpolated between the heightmap's. The box
+// is assumed to be upright, only its yaw is followed. The grid's topology never
+// changes, so when the heightmap is edited only the vertices over the edited
+// cells are moved.
+class HeightmapCrop
+{
+public:
+  HeightmapCrop();
+
+  HeightmapCrop(const HeightmapCrop&) = delete;
+  HeightmapCrop& operator=(const HeightmapCrop&) = delete;
+
+  // Finds the heightmap in the world and builds the mesh of it inside of box.
+  // Returns false if the world has no heightmap yet.
+  bool initialize(const gazebo::physics::WorldPtr &world,
+                  const ignition::math::OrientedBoxd &box);
+
+  bool isInitialized(void) const {
+    return m_shape != nullptr;
+  }
+
+  // Moves the vertices over the cells of the heightmap whose heights changed
+  // since the last call. Returns true if any did.
+  bool update(void);
+
+  // the mesh in world coordinates
+  const gazebo::common::Mesh &getMesh(void) const {
+    return m_mesh;
+  }
+
+private:
+  // recomputes the top vertices with the given indices from m_window
+  void updateVertices(const std::vector<uint32_t> &vertices);
+
+  gazebo::physics::HeightmapShapePtr m_shape;
+  ignition::math::OrientedBoxd m_box;
+
+  // heights of the heightmap vertices the top depends on, a window of
+  // m_window_columns by m_window_rows from column m_window_column and row
+  // m_window_row of the heightmap
+  std::vector<float> m_window;
+  int m_window_column;
+  int m_window_row;
+  int m_window_columns;
+  int m_window_rows;
+
+  // top grid of m_columns by m_rows vertices, per vertex: its X and Y in the
+  // frame of the box, the index in m_window of the first vertex of the
+  // heightmap cell it is in, its position in that cell, and 1 if it is off of
+  // the heightmap
+  int m_columns;
+  int m_rows;
+  std::vector<double> m_local_x;
+  std::vector<double> m_local_y;
+  std::vector<int32_t> m_cell;
+  std::vector<float> m_cell_x;
+  std::vector<float> m_cell_y;
+  std::vector<float> m_off_terrain;
+  // heightmap vertex heights plus this are heights in the frame of the box
+  float m_height_offset;
+
+  // outputs of updateVertices in world coordinates, kept to not allocate
+  std::vector<double> m_world_x;
+  std::vector<double> m_world_y;
+  std::vector<double> m_world_z;
+
+  gazebo::common::Mesh m_mesh;
+  // owned by m_mesh
+  gazebo::common::SubMesh *m_submesh;
+};
+
+#endif // HeightmapCrop_h
@@ -0,0 +1,138 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#include "ParticleBedCache.h"
+
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <gazebo/common/Console.hh>
+
+namespace {
+
+// Layout of a bed file: this header followed by the state DemEngine writes.
+// The header is a multiple of 8 bytes long, so the state is aligned where the
+// file is mapped.
+const char FILE_MAGIC[8] = {'O', 'W', 'D', 'E', 'M', 'B', 'E', 'D'};
+const uint32_t FILE_VERSION = 1;
+// written as is, so files from a machine of other endianness are recognized
+const uint32_t FILE_BYTE_ORDER = 0x01020304;
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t key;
+};
+
+}
+
+void BedKey::add(const void *data, size_t size)
+{
+  const auto bytes = static_cast<const unsigned char *>(data);
+  for (size_t i = 0; i < size; ++i) {
+    m_hash ^= bytes[i];
+    m_hash *= 1099511628211ull;
+  }
+}
+
+ParticleBedCache::ParticleBedCache(const std::string &directory)
+  : m_directory(directory)
+{
+}
+
+std::string ParticleBedCache::getPath(uint64_t key) const
+{
+  char name[32];
+  snprintf(name, sizeof(name), "bed_%016" PRIx64 ".bin", key);
+  return m_directory + "/" + name;
+}
+
+bool ParticleBedCache::load(uint64_t key, DemEngine &engine) const
+{
+  if (!isEnabled()) {
+    return false;
+  }
+  auto path = getPath(key);
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    // not relaxed before
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0
+      || static_cast<size_t>(status.st_size) < sizeof(FileHeader)) {
+    close(fd);
+    gzwarn << "ParticleBedCache::load - ignoring truncated " << path
+           << std::endl;
+    return false;
+  }
+  size_t size = status.st_size;
+  void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    gzwarn << "ParticleBedCache::load - cannot map " << path << ": "
+           << strerror(errno) << std::endl;
+    return false;
+  }
+
+  const auto &header = *static_cast<const FileHeader *>(mapping);
+  bool loaded = memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) == 0
+    && header.version == FILE_VERSION && header.byte_order == FILE_BYTE_ORDER
+    && header.key == key
+    && engine.readState(static_cast<const char *>(mapping) + sizeof(FileHeader),
+                        size - sizeof(FileHeader));
+  munmap(mapping, size);
+  if (!loaded) {
+    gzwarn << "ParticleBedCache::load - ignoring " << path
+           << ", which was written by another version or machine" << std::endl;
+  }
+  return loaded;
+}
+
+bool ParticleBedCache::save(uint64_t key, const DemEngine &engine) const
+{
+  if (!isEnabled()) {
+    return false;
+  }
+  if (mkdir(m_directory.c_str(), 0755) != 0 && errno != EEXIST) {
+    gzwarn << "ParticleBedCache::save - cannot create " << m_directory << ": "
+           << strerror(errno) << std::endl;
+    return false;
+  }
+
+  auto path = getPath(key);
+  // unique per process, so that launches saving the same bed do not mix
+  auto temporary = path + "." + std::to_string(getpid()) + ".tmp";
+  {
+    std::ofstream out(temporary, std::ios::binary);
+    FileHeader header;
+    memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    header.version = FILE_VERSION;
+    header.byte_order = FILE_BYTE_ORDER;
+    header.key = key;
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    if (!engine.writeState(out) || !out.flush()) {
+      out.close();
+      unlink(temporary.c_str());
+      gzwarn << "ParticleBedCache::save - cannot write " << temporary
+             << std::endl;
+      return false;
+    }
+  }
+  if (rename(temporary.c_str(), path.c_str()) != 0) {
+    gzwarn << "ParticleBedCache::save - cannot rename " << temporary << " to "
+           << path << ": " << strerror(errno) << std::endl;
+    unlink(temporary.c_str());
+    return false;
+  }
+  return true;
+}
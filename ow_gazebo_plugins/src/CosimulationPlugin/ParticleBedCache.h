@@ -0,0 +1,64 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#ifndef ParticleBedCache_h
+#define ParticleBedCache_h
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "DemEngine.h"
+
+// ParticleBedCache keeps relaxed particle beds in a directory, so that a
+// launch can load the bed an earlier launch relaxed instead of relaxing its
+// own. Beds are stored by a key that identifies everything that went into
+// relaxing them, which callers compute with the BedKey helpers.
+//
+// A bed file is a header followed by the particle state of DemEngine, which
+// is mapped into memory when loaded. Files are written under a temporary
+// name and then renamed, so that no launch ever reads a partial one.
+class ParticleBedCache
+{
+public:
+  // beds are not cached if directory is empty
+  explicit ParticleBedCache(const std::string &directory = std::string());
+
+  bool isEnabled(void) const {
+    return !m_directory.empty();
+  }
+
+  // path of the file of the bed with key
+  std::string getPath(uint64_t key) const;
+
+  // Restores the particles of engine from the bed with key. Returns false if
+  // there is no such bed or it cannot be read.
+  bool load(uint64_t key, DemEngine &engine) const;
+
+  // Saves the particles of engine as the bed with key, creating the directory
+  // if needed. Returns false if they could not be saved.
+  bool save(uint64_t key, const DemEngine &engine) const;
+
+private:
+  std::string m_directory;
+};
+
+// Builds a key out of the values given to it with 64 bit FNV-1a
+class BedKey
+{
+public:
+  void add(const void *data, size_t size);
+  void add(double value) {
+    add(&value, sizeof(value));
+  }
+
+  uint64_t get(void) const {
+    return m_hash;
+  }
+
+private:
+  uint64_t m_hash = 14695981039346656037ull;
+};
+
+#endif // ParticleBedCache_h
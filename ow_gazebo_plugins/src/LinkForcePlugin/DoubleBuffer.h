@@ -0,0 +1,79 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#ifndef DoubleBuffer_h
+#define DoubleBuffer_h
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+
+// Hands a small block of values from writer threads to a reader thread that
+// must never wait. Writers fill the slot that is not published and then
+// publish it by incrementing a sequence number, so a write never touches the
+// slot a reader is copying unless a second write follows it. The reader checks
+// after copying that nothing was published in the meantime. If something was,
+// the read fails and the reader keeps its previous copy instead of retrying, so
+// reading is wait-free. Writers are serialized with each other by a mutex the
+// reader never takes.
+template <typename T>
+class DoubleBuffer
+{
+  static_assert(std::is_trivially_copyable<T>::value,
+                "DoubleBuffer values are copied byte by byte");
+
+public:
+  explicit DoubleBuffer(const T& initial = T())
+  {
+    m_slots[0] = initial;
+    m_slots[1] = initial;
+  }
+
+  DoubleBuffer(const DoubleBuffer&) = delete;
+  DoubleBuffer& operator=(const DoubleBuffer&) = delete;
+
+  // Replaces the published values with what update makes of them. update is
+  // called with a reference to a copy of the current values.
+  template <typename Update>
+  void Modify(Update update)
+  {
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    auto sequence = m_sequence.load(std::memory_order_relaxed);
+    T values = m_slots[sequence & 1];
+    update(values);
+    Write(sequence, values);
+  }
+
+  // Copies the published values into out_values, unless a write raced with
+  // the copy, in which case out_values is left as it was and false returned.
+  bool TryLoad(T& out_values) const
+  {
+    auto sequence = m_sequence.load(std::memory_order_acquire);
+    T values;
+    std::memcpy(&values, &m_slots[sequence & 1], sizeof(T));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (m_sequence.load(std::memory_order_relaxed) != sequence)
+      return false;
+    out_values = values;
+    return true;
+  }
+
+private:
+  void Write(unsigned int sequence, const T& values)
+  {
+    // a reader that sees any of the bytes below also sees that sequence was
+    // published, which is what makes it discard its copy
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&m_slots[(sequence + 1) & 1], &values, sizeof(T));
+    m_sequence.store(sequence + 1, std::memory_order_release);
+  }
+
+  T m_slots[2];
+  // the published slot is m_slots[m_sequence & 1]
+  std::atomic<unsigned int> m_sequence{0};
+  std::mutex m_writeMutex;
+};
+
+#endif // DoubleBuffer_h
@@ -0,0 +1,407 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#include "ForceTable.h"
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <tuple>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+// Layout of a binary table file: the header, followed by the arrays of the
+// table in the order of the counts in the header. All fields are 4 bytes wide,
+// so every array is aligned when the file is mapped.
+const char FILE_MAGIC[8] = {'O', 'W', 'F', 'O', 'R', 'C', 'E', 'T'};
+const uint32_t FILE_VERSION = 1;
+// written as is, so files from a machine of other endianness are recognized
+const uint32_t FILE_BYTE_ORDER = 0x01020304;
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint32_t valueCount;
+  uint32_t materialCount;
+  uint32_t depthCount;
+  uint32_t passCount;
+  uint32_t curveCount;
+  uint32_t entryCount;
+};
+
+struct Row {
+  int32_t material;
+  float depth;
+  int32_t pass;
+  float rho;
+  float values[ForceTable::VALUE_COUNT];
+};
+
+bool ParseInt(const string& cell, int32_t& out_value)
+{
+  char* end;
+  errno = 0;
+  long value = strtol(cell.c_str(), &end, 10);
+  if (end == cell.c_str() || *end != '\0' || errno != 0 || value != static_cast<int32_t>(value))
+    return false;
+  out_value = static_cast<int32_t>(value);
+  return true;
+}
+
+bool ParseFloat(const string& cell, float& out_value)
+{
+  char* end;
+  errno = 0;
+  out_value = strtof(cell.c_str(), &end);
+  return end != cell.c_str() && *end == '\0' && errno == 0 && isfinite(out_value);
+}
+
+// index of a breakpoint in a sorted array, or -1 if it isn't there
+template <typename Array, typename T>
+int FindExact(const Array& breakpoints, T key)
+{
+  auto it = lower_bound(breakpoints.begin(), breakpoints.end(), key);
+  return (it != breakpoints.end() && *it == key) ? static_cast<int>(it - breakpoints.begin()) : -1;
+}
+
+// Finds the breakpoints key lies between. Keys outside of the breakpoints are
+// clamped to the first or last one, in which case both indices are the same.
+void FindInterval(const float* breakpoints, int count, float key,
+                  int& out_lower, int& out_upper, float& out_fraction)
+{
+  auto upper = static_cast<int>(lower_bound(breakpoints, breakpoints + count, key) - breakpoints);
+  if (upper == 0 || upper == count) {
+    out_lower = out_upper = (upper == 0) ? 0 : count - 1;
+    out_fraction = 0.0f;
+    return;
+  }
+  out_lower = upper - 1;
+  out_upper = upper;
+  out_fraction = (key - breakpoints[out_lower]) / (breakpoints[out_upper] - breakpoints[out_lower]);
+}
+
+template <typename T>
+void Unique(vector<T>& values)
+{
+  sort(values.begin(), values.end());
+  values.erase(unique(values.begin(), values.end()), values.end());
+}
+
+}
+
+ForceTable::~ForceTable()
+{
+  Clear();
+}
+
+void ForceTable::Clear()
+{
+  if (m_mapping)
+    munmap(m_mapping, m_mappingSize);
+  m_mapping = nullptr;
+  m_mappingSize = 0;
+  m_mappedFilename.clear();
+  m_ownedMaterials.clear();
+  m_ownedDepths.clear();
+  m_ownedPasses.clear();
+  m_ownedCurves.clear();
+  m_ownedRho.clear();
+  m_ownedValues.clear();
+  ViewOwned();
+}
+
+void ForceTable::ViewOwned()
+{
+  m_materials.Assign(m_ownedMaterials.data(), m_ownedMaterials.size());
+  m_depths.Assign(m_ownedDepths.data(), m_ownedDepths.size());
+  m_passes.Assign(m_ownedPasses.data(), m_ownedPasses.size());
+  m_curves.Assign(m_ownedCurves.data(), m_ownedCurves.size());
+  m_rho.Assign(m_ownedRho.data(), m_ownedRho.size());
+  m_values.Assign(m_ownedValues.data(), m_ownedValues.size());
+}
+
+bool ForceTable::LoadFile(const string& filename, string& out_error)
+{
+  ifstream infile(filename.c_str(), fstream::in | fstream::binary);
+  if (!infile.is_open()) {
+    out_error = "cannot open file: " + filename;
+    return false;
+  }
+
+  char magic[sizeof(FILE_MAGIC)] = {};
+  infile.read(magic, sizeof(magic));
+  if (infile.gcount() == sizeof(magic) && memcmp(magic, FILE_MAGIC, sizeof(magic)) == 0)
+    return MapBinary(filename, out_error);
+
+  infile.clear();
+  infile.seekg(0);
+  return LoadCsv(infile, out_error);
+}
+
+bool ForceTable::LoadCsv(istream& in, string& out_error)
+{
+  Clear();
+
+  vector<Row> rows;
+  string line;
+  int lineNumber = 0;
+  bool header = true;
+  while (getline(in, line)) {
+    ++lineNumber;
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    if (line.empty())
+      continue;
+    if (header) {
+      header = false;
+      continue;
+    }
+
+    vector<string> cells;
+    stringstream lineStream(line);
+    string cell;
+    while (getline(lineStream, cell, ','))
+      cells.push_back(cell);
+    if (cells.size() != 4 + VALUE_COUNT) {
+      out_error = "line " + to_string(lineNumber) + ": expected " + to_string(4 + VALUE_COUNT)
+                  + " columns, found " + to_string(cells.size());
+      return false;
+    }
+
+    Row row;
+    bool valid = ParseInt(cells[0], row.material) && ParseFloat(cells[1], row.depth)
+                 && ParseInt(cells[2], row.pass) && ParseFloat(cells[3], row.rho);
+    for (int i = 0; valid && i < VALUE_COUNT; ++i)
+      valid = ParseFloat(cells[4 + i], row.values[i]);
+    if (!valid) {
+      out_error = "line " + to_string(lineNumber) + ": malformed number in \"" + line + "\"";
+      return false;
+    }
+    rows.push_back(row);
+  }
+  if (rows.empty()) {
+    out_error = "table has no rows";
+    return false;
+  }
+
+  // rows of a curve end up next to each other, in order of rho
+  sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+    return tie(a.material, a.depth, a.pass, a.rho) < tie(b.material, b.depth, b.pass, b.rho);
+  });
+
+  for (const auto& r : rows) {
+    m_ownedMaterials.push_back(r.material);
+    m_ownedDepths.push_back(r.depth);
+    m_ownedPasses.push_back(r.pass);
+  }
+  Unique(m_ownedMaterials);
+  Unique(m_ownedDepths);
+  Unique(m_ownedPasses);
+
+  m_ownedCurves.assign(m_ownedMaterials.size() * m_ownedDepths.size() * m_ownedPasses.size(), Curve{0, 0});
+  m_ownedRho.reserve(rows.size());
+  m_ownedValues.reserve(rows.size() * VALUE_COUNT);
+  for (const auto& r : rows) {
+    auto& curve = m_ownedCurves[(FindExact(m_ownedMaterials, r.material) * m_ownedDepths.size()
+                                 + FindExact(m_ownedDepths, r.depth)) * m_ownedPasses.size()
+                                + FindExact(m_ownedPasses, r.pass)];
+    if (curve.count == 0) {
+      curve.begin = m_ownedRho.size();
+    } else if (m_ownedRho.back() == r.rho) {
+      stringstream key;
+      key << r.material << "," << r.depth << "," << r.pass << "," << r.rho;
+      out_error = "duplicate key = " + key.str();
+      Clear();
+      return false;
+    }
+    ++curve.count;
+    m_ownedRho.push_back(r.rho);
+    m_ownedValues.insert(m_ownedValues.end(), r.values, r.values + VALUE_COUNT);
+  }
+
+  ViewOwned();
+  return true;
+}
+
+bool ForceTable::SaveBinary(ostream& out) const
+{
+  FileHeader header;
+  memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+  header.version = FILE_VERSION;
+  header.byteOrder = FILE_BYTE_ORDER;
+  header.valueCount = VALUE_COUNT;
+  header.materialCount = m_materials.size;
+  header.depthCount = m_depths.size;
+  header.passCount = m_passes.size;
+  header.curveCount = m_curves.size;
+  header.entryCount = m_rho.size;
+
+  auto write = [&out](const void* data, size_t size) {
+    out.write(static_cast<const char*>(data), size);
+  };
+  write(&header, sizeof(header));
+  write(m_materials.data, m_materials.size * sizeof(int32_t));
+  write(m_depths.data, m_depths.size * sizeof(float));
+  write(m_passes.data, m_passes.size * sizeof(int32_t));
+  write(m_curves.data, m_curves.size * sizeof(Curve));
+  write(m_rho.data, m_rho.size * sizeof(float));
+  write(m_values.data, m_values.size * sizeof(float));
+  return static_cast<bool>(out);
+}
+
+bool ForceTable::IsMappedFileModified() const
+{
+  if (!m_mapping)
+    return false;
+  // A file that was replaced by rename is another inode, and the mapping of
+  // the old one stays valid
+  struct stat status;
+  return stat(m_mappedFilename.c_str(), &status) == 0
+         && status.st_dev == m_mappedStatus.st_dev && status.st_ino == m_mappedStatus.st_ino
+         && (status.st_size != m_mappedStatus.st_size
+             || status.st_mtim.tv_sec != m_mappedStatus.st_mtim.tv_sec
+             || status.st_mtim.tv_nsec != m_mappedStatus.st_mtim.tv_nsec);
+}
+
+bool ForceTable::MapBinary(const string& filename, string& out_error)
+{
+  Clear();
+
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    out_error = "cannot open file: " + filename;
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(FileHeader)) {
+    close(fd);
+    out_error = "binary table is truncated: " + filename;
+    return false;
+  }
+  size_t size = status.st_size;
+  void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    out_error = "cannot map file: " + filename + ": " + strerror(errno);
+    return false;
+  }
+  m_mapping = mapping;
+  m_mappingSize = size;
+  m_mappedFilename = filename;
+  m_mappedStatus = status;
+
+  // only the header and the curves are checked, so that loading does not
+  // depend on the number of entries; the compiler validated the rest
+  const auto& header = *static_cast<const FileHeader*>(mapping);
+  if (header.byteOrder != FILE_BYTE_ORDER || header.version != FILE_VERSION
+      || header.valueCount != VALUE_COUNT) {
+    Clear();
+    out_error = "binary table was written for another version or machine: " + filename;
+    return false;
+  }
+  size_t expected = sizeof(FileHeader)
+                    + sizeof(int32_t) * header.materialCount + sizeof(float) * header.depthCount
+                    + sizeof(int32_t) * header.passCount + sizeof(Curve) * header.curveCount
+                    + sizeof(float) * header.entryCount * (1 + VALUE_COUNT);
+  if (size != expected || header.curveCount
+      != static_cast<uint64_t>(header.materialCount) * header.depthCount * header.passCount) {
+    Clear();
+    out_error = "binary table is malformed: " + filename;
+    return false;
+  }
+
+  auto cursor = static_cast<const char*>(mapping) + sizeof(FileHeader);
+  ViewMapped(cursor, header.materialCount, m_materials);
+  ViewMapped(cursor, header.depthCount, m_depths);
+  ViewMapped(cursor, header.passCount, m_passes);
+  ViewMapped(cursor, header.curveCount, m_curves);
+  ViewMapped(cursor, header.entryCount, m_rho);
+  ViewMapped(cursor, header.entryCount * VALUE_COUNT, m_values);
+
+  for (const auto& curve : m_curves)
+    if (static_cast<uint64_t>(curve.begin) + curve.count > header.entryCount) {
+      Clear();
+      out_error = "binary table is malformed: " + filename;
+      return false;
+    }
+
+  return true;
+}
+
+bool ForceTable::GetForces(int material, float depth, int pass, float rho,
+                           Interpolation interpolation, float out_forces[VALUE_COUNT],
+                           LookupIndices* out_indices) const
+{
+  auto material_index = FindExact(m_materials, material);
+  auto pass_index = FindExact(m_passes, pass);
+  if (material_index < 0 || pass_index < 0)
+    return false;
+
+  fill(out_forces, out_forces + VALUE_COUNT, 0.0f);
+
+  int lower, upper;
+  float fraction;
+  FindInterval(m_depths.data, m_depths.size, depth, lower, upper, fraction);
+  int depth_index, rho_index;
+  if (interpolation == Interpolation::NEAREST) {
+    // ties go to the deeper breakpoint
+    depth_index = fraction < 0.5f ? lower : upper;
+    auto& curve = GetCurve(material_index, depth_index, pass_index);
+    if (curve.count == 0)
+      return false;
+    rho_index = AccumulateCurve(curve, rho, interpolation, 1.0f, out_forces);
+  } else {
+    auto& lower_curve = GetCurve(material_index, lower, pass_index);
+    auto& upper_curve = GetCurve(material_index, upper, pass_index);
+    if (lower_curve.count == 0 || upper_curve.count == 0)
+      return false;
+    depth_index = lower;
+    rho_index = AccumulateCurve(lower_curve, rho, interpolation, 1.0f - fraction, out_forces);
+    if (fraction > 0.0f)
+      AccumulateCurve(upper_curve, rho, interpolation, fraction, out_forces);
+  }
+
+  if (out_indices)
+    *out_indices = {material_index, depth_index, pass_index, rho_index};
+  return true;
+}
+
+bool ForceTable::HasMaterial(int material) const
+{
+  return FindExact(m_materials, material) >= 0;
+}
+
+bool ForceTable::HasPass(int pass) const
+{
+  return FindExact(m_passes, pass) >= 0;
+}
+
+int ForceTable::AccumulateCurve(const Curve& curve, float rho, Interpolation interpolation,
+                                float weight, float out_forces[VALUE_COUNT]) const
+{
+  int lower, upper;
+  float fraction;
+  FindInterval(&m_rho[curve.begin], curve.count, rho, lower, upper, fraction);
+
+  if (interpolation == Interpolation::NEAREST) {
+    lower = upper = (fraction < 0.5f) ? lower : upper;
+    fraction = 0.0f;
+  }
+
+  auto lower_values = &m_values[(curve.begin + lower) * VALUE_COUNT];
+  auto upper_values = &m_values[(curve.begin + upper) * VALUE_COUNT];
+  for (int i = 0; i < VALUE_COUNT; ++i)
+    out_forces[i] += weight * (lower_values[i] + fraction * (upper_values[i] - lower_values[i]));
+  return lower;
+}
@@ -0,0 +1,160 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#ifndef ForceTable_h
+#define ForceTable_h
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+// A force and torque lookup table over (material, depth, pass, rho), compiled
+// from CSV rows into flat arrays so that lookups neither allocate nor chase
+// pointers. Material and pass are categorical and must match exactly. Depth
+// and rho are continuous: the table is indexed by the sorted depth
+// breakpoints, and every (material, depth, pass) cell holds a curve of forces
+// over its own sorted rho breakpoints, since the rows of the table do not
+// share rho values.
+//
+// The arrays can be saved to a binary file, which is memory-mapped when it is
+// loaded instead of being read, so loading it takes the same time no matter
+// how large the table is.
+class ForceTable
+{
+public:
+  enum class Interpolation {
+    NEAREST,  // value of the nearest breakpoints
+    LINEAR    // bilinear in depth and rho
+  };
+
+  static const int VALUE_COUNT = 6;
+
+  // indices of the breakpoints a lookup used, the lower one of the two it
+  // interpolated between, and the rho index is the one within its curve
+  struct LookupIndices {
+    int32_t material;
+    int32_t depth;
+    int32_t pass;
+    int32_t rho;
+  };
+
+  ForceTable() = default;
+  ~ForceTable();
+  ForceTable(const ForceTable&) = delete;
+  ForceTable& operator=(const ForceTable&) = delete;
+
+  // Loads a binary table if the file is one, or parses it as CSV otherwise.
+  // Replaces any previous contents. On failure, out_error describes why.
+  bool LoadFile(const std::string& filename, std::string& out_error);
+
+  // Parses rows of m,d,p,rho,Fx,Fy,Fz,Tx,Ty,Tz following a header line.
+  // Every cell must be a number and every key unique. Replaces any previous
+  // contents. On failure, out_error describes the first problem found.
+  bool LoadCsv(std::istream& in, std::string& out_error);
+
+  // Writes the table in the binary format LoadFile maps.
+  bool SaveBinary(std::ostream& out) const;
+
+  // Outside of the depth and rho breakpoints the values at the nearest
+  // breakpoints are used. Returns false if there is no data for the material
+  // and pass. Fills out_indices if it is given.
+  bool GetForces(int material, float depth, int pass, float rho,
+                 Interpolation interpolation, float out_forces[VALUE_COUNT],
+                 LookupIndices* out_indices = nullptr) const;
+
+  // True if the table holds forces for the material or pass respectively,
+  // with any of the other keys.
+  bool HasMaterial(int material) const;
+  bool HasPass(int pass) const;
+
+  // True if the table is mapped from a file that was rewritten in place since,
+  // instead of being replaced by a new file. Reading it may then crash.
+  bool IsMappedFileModified() const;
+
+  size_t GetEntryCount() const
+  {
+    return m_rho.size;
+  }
+
+private:
+  struct Curve {
+    uint32_t begin;
+    uint32_t count;
+  };
+
+  // an array that is either owned by the table or part of a mapped file
+  template <typename T>
+  struct ArrayView {
+    const T* data = nullptr;
+    size_t size = 0;
+
+    const T* begin() const { return data; }
+    const T* end() const { return data + size; }
+    const T& operator[](size_t i) const { return data[i]; }
+
+    void Assign(const T* new_data, size_t new_size)
+    {
+      data = new_data;
+      size = new_size;
+    }
+  };
+
+  bool MapBinary(const std::string& filename, std::string& out_error);
+
+  void Clear();
+
+  // points a view at count elements of a mapped file and advances the cursor
+  template <typename T>
+  static void ViewMapped(const char*& cursor, size_t count, ArrayView<T>& out_view)
+  {
+    out_view.Assign(reinterpret_cast<const T*>(cursor), count);
+    cursor += count * sizeof(T);
+  }
+
+  // points the views at the owned arrays
+  void ViewOwned();
+
+  const Curve& GetCurve(int material_index, int depth_index, int pass_index) const
+  {
+    return m_curves[(material_index * m_depths.size + depth_index) * m_passes.size + pass_index];
+  }
+
+  // evaluates a curve at rho into out_forces, weighted by weight and added
+  // returns: the index of the rho breakpoint used within the curve
+  int AccumulateCurve(const Curve& curve, float rho, Interpolation interpolation,
+                      float weight, float out_forces[VALUE_COUNT]) const;
+
+  // breakpoints of each axis, sorted
+  ArrayView<int32_t> m_materials;
+  ArrayView<float> m_depths;
+  ArrayView<int32_t> m_passes;
+
+  // one curve per (material, depth, pass), row-major in that order
+  ArrayView<Curve> m_curves;
+  // rho breakpoints of all curves, the breakpoints of a curve are contiguous
+  ArrayView<float> m_rho;
+  // VALUE_COUNT values for each entry of m_rho
+  ArrayView<float> m_values;
+
+  // storage of tables parsed from CSV
+  std::vector<int32_t> m_ownedMaterials;
+  std::vector<float> m_ownedDepths;
+  std::vector<int32_t> m_ownedPasses;
+  std::vector<Curve> m_ownedCurves;
+  std::vector<float> m_ownedRho;
+  std::vector<float> m_ownedValues;
+
+  // memory mapping of binary tables
+  void* m_mapping = nullptr;
+  size_t m_mappingSize = 0;
+  // the mapped file and its status when it was mapped
+  std::string m_mappedFilename;
+  struct stat m_mappedStatus = {};
+};
+
+#endif // ForceTable_h
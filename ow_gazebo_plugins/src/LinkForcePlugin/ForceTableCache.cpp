@@ -0,0 +1,72 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#include "ForceTableCache.h"
+#include <climits>
+#include <cstdlib>
+#include <sys/stat.h>
+
+using namespace std;
+
+mutex ForceTableCache::s_mutex;
+map<string, weak_ptr<ForceTableCache::Entry>> ForceTableCache::s_entries;
+
+shared_ptr<ForceTableCache::Entry> ForceTableCache::Acquire(const string& filename,
+                                                            string& out_error)
+{
+  char path[PATH_MAX];
+  if (!realpath(filename.c_str(), path)) {
+    out_error = "cannot open file: " + filename;
+    return nullptr;
+  }
+
+  lock_guard<mutex> lock(s_mutex);
+
+  // forget entries nobody uses anymore
+  for (auto it = s_entries.begin(); it != s_entries.end();) {
+    if (it->second.expired())
+      it = s_entries.erase(it);
+    else
+      ++it;
+  }
+
+  // the last user may have let go of the entry since the sweep
+  auto it = s_entries.find(path);
+  auto entry = it != s_entries.end() ? it->second.lock() : nullptr;
+  if (entry)
+    return Update(*entry, out_error) ? entry : nullptr;
+
+  entry = make_shared<Entry>();
+  entry->m_path = path;
+  if (!Update(*entry, out_error))
+    return nullptr;
+  s_entries[path] = entry;
+  return entry;
+}
+
+bool ForceTableCache::Reload(Entry& entry, string& out_error)
+{
+  lock_guard<mutex> lock(s_mutex);
+  return Update(entry, out_error);
+}
+
+bool ForceTableCache::Update(Entry& entry, string& out_error)
+{
+  struct stat status;
+  if (stat(entry.m_path.c_str(), &status) != 0) {
+    out_error = "cannot open file: " + entry.m_path;
+    return false;
+  }
+  if (entry.Get() && entry.m_seconds == status.st_mtim.tv_sec
+      && entry.m_nanoseconds == status.st_mtim.tv_nsec)
+    return true;
+
+  auto table = make_shared<ForceTable>();
+  if (!table->LoadFile(entry.m_path, out_error))
+    return false;
+  entry.m_seconds = status.st_mtim.tv_sec;
+  entry.m_nanoseconds = status.st_mtim.tv_nsec;
+  atomic_store(&entry.m_table, shared_ptr<const ForceTable>(move(table)));
+  return true;
+}
@@ -0,0 +1,70 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#ifndef ForceTableCache_h
+#define ForceTableCache_h
+
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "ForceTable.h"
+
+// Process-wide cache of loaded force tables, so that plugin instances that use
+// the same lookup table share one immutable copy of it. Tables are shared per
+// canonical path through an entry that holds the current table of the file.
+// Reloading an entry replaces its table for every instance that holds the
+// entry, while lookups that are using the old table keep it until they let go
+// of it. The cache does not keep entries alive by itself.
+class ForceTableCache
+{
+public:
+  class Entry
+  {
+  public:
+    // the current table, safe to call while the entry is reloaded
+    std::shared_ptr<const ForceTable> Get() const
+    {
+      return std::atomic_load(&m_table);
+    }
+
+    const std::string& GetPath() const
+    {
+      return m_path;
+    }
+
+  private:
+    friend class ForceTableCache;
+
+    std::string m_path;
+    // modification time of the file the current table was loaded from
+    time_t m_seconds = 0;
+    long m_nanoseconds = 0;
+    // only accessed with std::atomic_load and std::atomic_store
+    std::shared_ptr<const ForceTable> m_table;
+  };
+
+  // Returns the entry of filename, loading its table unless another instance
+  // already did. An entry whose file changed on disk is reloaded. Returns null
+  // and describes why in out_error on failure.
+  static std::shared_ptr<Entry> Acquire(const std::string& filename,
+                                        std::string& out_error);
+
+  // Loads the file of entry again if it changed on disk, and swaps the new
+  // table into the entry. On failure the entry keeps its table, and out_error
+  // describes why.
+  static bool Reload(Entry& entry, std::string& out_error);
+
+private:
+  // loads the file of entry if its modification time differs from the one of
+  // the current table, must be called with s_mutex held
+  static bool Update(Entry& entry, std::string& out_error);
+
+  static std::mutex s_mutex;
+  // keyed by canonical path
+  static std::map<std::string, std::weak_ptr<Entry>> s_entries;
+};
+
+#endif // ForceTableCache_h
@@ -0,0 +1,95 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#include "ForceTelemetry.h"
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <vector>
+#include <gazebo/common/Console.hh>
+#include <std_msgs/Float64MultiArray.h>
+
+using namespace std;
+
+// records are written to files as they are in memory
+static_assert(sizeof(ForceTelemetry::Sample) == 72, "telemetry record layout changed");
+
+ForceTelemetry::~ForceTelemetry()
+{
+  if (m_thread.joinable()) {
+    m_stop = true;
+    m_thread.join();
+  }
+  if (m_file)
+    fclose(m_file);
+}
+
+bool ForceTelemetry::Start(size_t capacity, const ros::Publisher& publisher,
+                           const string& filename, string& out_error)
+{
+  if (!filename.empty()) {
+    m_file = fopen(filename.c_str(), "wb");
+    if (!m_file) {
+      out_error = "cannot open file: " + filename + ": " + strerror(errno);
+      return false;
+    }
+  }
+  m_publisher = publisher;
+  m_ring = make_unique<SpscRing<Sample>>(capacity);
+  m_thread = thread(&ForceTelemetry::Drain, this);
+  return true;
+}
+
+void ForceTelemetry::Drain()
+{
+  vector<Sample> samples;
+  std_msgs::Float64MultiArray msg;
+  msg.layout.dim.resize(2);
+  msg.layout.dim[0].label = "sample";
+  msg.layout.dim[1].label = "field";
+  msg.layout.dim[1].size = FIELD_COUNT;
+  msg.layout.dim[1].stride = FIELD_COUNT;
+  uint64_t reportedDropped = 0;
+
+  // the last batch is drained after being asked to stop
+  for (bool stopping = false; !stopping;) {
+    stopping = m_stop;
+    if (!stopping)
+      this_thread::sleep_for(chrono::milliseconds(100));
+
+    samples.clear();
+    Sample sample;
+    while (m_ring->TryPop(sample))
+      samples.push_back(sample);
+
+    auto dropped = m_dropped.load(memory_order_relaxed);
+    if (dropped != reportedDropped) {
+      gzwarn << "ForceTelemetry - dropped " << dropped - reportedDropped
+             << " samples, the buffer is too small." << endl;
+      reportedDropped = dropped;
+    }
+    if (samples.empty())
+      continue;
+
+    if (m_file) {
+      fwrite(samples.data(), sizeof(Sample), samples.size(), m_file);
+      fflush(m_file);
+    }
+
+    if (m_publisher && m_publisher.getNumSubscribers() > 0) {
+      msg.layout.dim[0].size = samples.size();
+      msg.layout.dim[0].stride = samples.size() * FIELD_COUNT;
+      msg.data.clear();
+      for (const auto& s : samples) {
+        msg.data.insert(msg.data.end(), {
+          s.simTime, s.depth, s.rho, double(s.material), double(s.pass),
+          double(s.indices.material), double(s.indices.depth),
+          double(s.indices.pass), double(s.indices.rho)});
+        msg.data.insert(msg.data.end(), s.forces, s.forces + ForceTable::VALUE_COUNT);
+        msg.data.insert(msg.data.end(), {double(s.lookupNanoseconds), double(s.footprintSamples)});
+      }
+      m_publisher.publish(msg);
+    }
+  }
+}
@@ -0,0 +1,78 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#ifndef ForceTelemetry_h
+#define ForceTelemetry_h
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <ros/ros.h>
+#include "ForceTable.h"
+#include "SpscRing.h"
+
+// Records what LinkForcePlugin does in the updates it applies forces in.
+// Samples are handed from the physics thread to a background thread through a
+// lock-free ring buffer, and the background thread publishes them to a ROS
+// topic and/or appends them to a binary file. If the background thread falls
+// behind, samples are dropped rather than slowing down the physics update.
+class ForceTelemetry
+{
+public:
+  struct Sample {
+    double simTime;
+    // depth of the center of gravity below the terrain in m
+    float depth;
+    float rho;
+    int32_t material;
+    int32_t pass;
+    ForceTable::LookupIndices indices;
+    float forces[ForceTable::VALUE_COUNT];
+    // time spent looking up the forces
+    uint32_t lookupNanoseconds;
+    // footprint points that were on the terrain
+    uint32_t footprintSamples;
+  };
+
+  // number of values per sample in published messages
+  static const int FIELD_COUNT = 17;
+
+  ForceTelemetry() = default;
+  ~ForceTelemetry();
+  ForceTelemetry(const ForceTelemetry&) = delete;
+  ForceTelemetry& operator=(const ForceTelemetry&) = delete;
+
+  // Starts the background thread. Samples are published with publisher if it
+  // is valid and written to filename if it is not empty. Returns false and
+  // describes why in out_error if the file cannot be opened.
+  bool Start(size_t capacity, const ros::Publisher& publisher,
+             const std::string& filename, std::string& out_error);
+
+  bool IsEnabled() const
+  {
+    return m_ring != nullptr;
+  }
+
+  // called from the physics thread only
+  void Record(const Sample& sample)
+  {
+    if (!m_ring->TryPush(sample))
+      m_dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+
+private:
+  void Drain();
+
+  std::unique_ptr<SpscRing<Sample>> m_ring;
+  ros::Publisher m_publisher;
+  FILE* m_file = nullptr;
+  std::thread m_thread;
+  std::atomic<bool> m_stop{false};
+  std::atomic<uint64_t> m_dropped{0};
+};
+
+#endif // ForceTelemetry_h
@@ -3,11 +3,13 @@
 // this repository.
 
 #include "LinkForcePlugin.h"
+#include "ForceTableCache.h"
 #include <gazebo/physics/Model.hh>
 #include <gazebo/physics/Link.hh>
-#include <gazebo/rendering/RenderingIface.hh>
-#include <gazebo/rendering/Scene.hh>
-#include <gazebo/rendering/Heightmap.hh>
+#include <gazebo/physics/World.hh>
+#include <chrono>
+#include <cmath>
+#include <std_msgs/Float64MultiArray.h>
 
 using namespace gazebo;
 using namespace std;
@@ -40,63 +42,154 @@ void LinkForcePlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf)
     gzerr << "Load - you must specify a filename in a <lookupTable> element." << endl;
     return;
   }
-  if(!LoadLookupTable(_sdf->Get<string>("lookupTable")))
+  m_lookupTableFilename = _sdf->Get<string>("lookupTable");
+  // Read in force and torque lookup table, either compiled or as CSV, unless
+  // another instance already did
+  string tableError;
+  m_forceTable = ForceTableCache::Acquire(m_lookupTableFilename, tableError);
+  if (!m_forceTable) {
+    gzerr << "Load - " << tableError << endl;
     return;
+  }
+
+  // The terrain is sampled on a grid of footprintSamples by footprintSamples
+  // points across the link's collision footprint, or at its center of gravity
+  // only if it is 1.
+  m_footprintSamples = 3;
+  if (_sdf->HasElement("footprintSamples"))
+    m_footprintSamples = max(1, _sdf->Get<int>("footprintSamples"));
+  m_footprintPoints.resize(m_footprintSamples * m_footprintSamples);
+  m_footprintHeights.resize(m_footprintPoints.size());
+
+  // The terrain may be loaded after this model, OnUpdate retries then
+  m_world = _model->GetWorld();
+  m_terrainSampler.Init(m_world);
+
+  m_interpolation = ForceTable::Interpolation::LINEAR;
+  if (_sdf->HasElement("interpolation")) {
+    string interpolation = _sdf->Get<string>("interpolation");
+    if (interpolation == "nearest")
+      m_interpolation = ForceTable::Interpolation::NEAREST;
+    else if (interpolation != "linear")
+      gzerr << "Load - unknown interpolation " << interpolation << ", using linear." << endl;
+  }
+
+  // Initial excavation conditions, defaults are those forces were looked up
+  // for before they could be changed
+  m_updateInputs.material = _sdf->HasElement("material") ? _sdf->Get<int>("material") : 1;
+  m_updateInputs.pass = _sdf->HasElement("pass") ? _sdf->Get<int>("pass") : 1;
+  m_updateInputs.rho = _sdf->HasElement("rho") ? _sdf->Get<float>("rho") : 0.0002f;
+  Inputs initialInputs = m_updateInputs;
+  m_inputs.Modify([&initialInputs](Inputs& inputs) { inputs = initialInputs; });
+
+  // The table can only be reloaded and the conditions changed while ROS is
+  // running, forces are applied either way.
+  if (ros::isInitialized()) {
+    string prefix = "/link_force/" + _model->GetName() + "/" + linkName;
+    m_nodeHandle = make_unique<ros::NodeHandle>();
+    m_reloadService = m_nodeHandle->advertiseService(
+      prefix + "/reload_lookup_table", &LinkForcePlugin::OnReloadLookupTable, this);
+    m_materialSub = m_nodeHandle->subscribe(prefix + "/material", 1,
+                                            &LinkForcePlugin::OnMaterialMsg, this);
+    m_passSub = m_nodeHandle->subscribe(prefix + "/pass", 1,
+                                        &LinkForcePlugin::OnPassMsg, this);
+    m_rhoSub = m_nodeHandle->subscribe(prefix + "/rho", 1,
+                                       &LinkForcePlugin::OnRhoMsg, this);
+  }
+
+  // Telemetry is published and/or written to a file only when requested
+  if (_sdf->HasElement("telemetry")) {
+    auto telemetry = _sdf->GetElement("telemetry");
+    bool publish = telemetry->HasElement("publish") && telemetry->Get<bool>("publish");
+    if (publish && m_nodeHandle) {
+      m_telemetryPub = m_nodeHandle->advertise<std_msgs::Float64MultiArray>(
+        "/link_force/" + _model->GetName() + "/" + linkName + "/telemetry", 10);
+    } else if (publish) {
+      gzerr << "Load - telemetry cannot be published, ROS is not initialized." << endl;
+    }
+    string file = telemetry->HasElement("file") ? telemetry->Get<string>("file") : "";
+    int capacity = telemetry->HasElement("capacity") ? telemetry->Get<int>("capacity") : 4096;
+    string error;
+    if ((m_telemetryPub || !file.empty())
+        && !m_telemetry.Start(max(1, capacity), m_telemetryPub, file, error))
+      gzerr << "Load - telemetry is disabled, " << error << endl;
+  }
 
   // Listen to the update event. This event is broadcast every sim iteration.
   // If result goes out of scope updates will stop, so it is assigned to a member variable.
   m_updateConnection = event::Events::ConnectBeforePhysicsUpdate(std::bind(&LinkForcePlugin::OnUpdate, this));
 }
 
-bool LinkForcePlugin::LoadLookupTable(string filename)
+bool LinkForcePlugin::OnReloadLookupTable(std_srvs::Trigger::Request& request,
+                                          std_srvs::Trigger::Response& response)
 {
-  ifstream infile(filename.c_str(), fstream::in);
-  if (!infile.is_open()) {
-    gzerr << "LoadLookupTable - cannot open file: " << filename << endl;
-    return false;
-  }
+  // A mapped table that was rewritten in place instead of replaced by rename
+  // may already have been read torn. Reloading maps the new contents, but the
+  // caller is told, since the next such rewrite can crash Gazebo.
+  auto current = m_forceTable->Get();
+  bool modifiedInPlace = current && current->IsMappedFileModified();
+  if (modifiedInPlace)
+    gzerr << "OnReloadLookupTable - " << m_lookupTableFilename
+          << " was rewritten in place while mapped, replace compiled tables by"
+          << " renaming a new file over them instead." << endl;
 
-  // Read in force and torque lookup table
-  CSVRow row;
-  bool first = true;
-  while(infile >> row) {
-    if(first) {
-      first = false;
-      continue;
-    }
+  // Every instance that uses the file gets the new table. The previous table
+  // is released once their physics threads are done with it. If the file has
+  // not changed, the current table stays in use.
+  string error;
+  bool loaded = ForceTableCache::Reload(*m_forceTable, error);
+  if (!loaded)
+    gzerr << "OnReloadLookupTable - " << error << endl;
+  response.success = loaded && !modifiedInPlace;
+  if (!loaded)
+    response.message = "failed to reload " + m_lookupTableFilename
+                       + ", the previous table is still in use: " + error;
+  else if (modifiedInPlace)
+    response.message = "reloaded " + m_lookupTableFilename
+                       + ", but it was rewritten in place while mapped, which can crash"
+                       + " Gazebo; replace compiled tables by rename";
+  else
+    response.message = "reloaded " + m_lookupTableFilename;
+  return true;
+}
 
-    // Store lookup table row in map
-    ForceRow f(row);
-    if(f.m_force_torque.size() != 6) {
-      gzerr << "LoadLookupTable - force/torque vector size = "
-            << f.m_force_torque.size() << ". Should be 6." << endl;
-      continue;
-    }
-    auto& vec = m_forcesMap[f.m_m][f.m_d][f.m_p][f.m_rho];
-    if(vec.size() != 0) {
-      gzerr << "LoadLookupTable - duplicate key = "
-            << f.m_m << ","<< f.m_d << ","<< f.m_p << ","<< f.m_rho << endl;
-      continue;
-    }
-    vec = f.m_force_torque;
+void LinkForcePlugin::OnMaterialMsg(const std_msgs::Int32::ConstPtr& msg)
+{
+  // Forces keep being looked up for the last valid material
+  auto forceTable = m_forceTable->Get();
+  if (forceTable && !forceTable->HasMaterial(msg->data)) {
+    gzerr << "OnMaterialMsg - " << m_lookupTableFilename << " has no forces for material "
+          << msg->data << ", the previous material is still in use." << endl;
+    return;
   }
-  infile.close();
+  m_inputs.Modify([&msg](Inputs& inputs) { inputs.material = msg->data; });
+}
 
-  return true;
+void LinkForcePlugin::OnPassMsg(const std_msgs::Int32::ConstPtr& msg)
+{
+  auto forceTable = m_forceTable->Get();
+  if (forceTable && !forceTable->HasPass(msg->data)) {
+    gzerr << "OnPassMsg - " << m_lookupTableFilename << " has no forces for pass "
+          << msg->data << ", the previous pass is still in use." << endl;
+    return;
+  }
+  m_inputs.Modify([&msg](Inputs& inputs) { inputs.pass = msg->data; });
+}
+
+void LinkForcePlugin::OnRhoMsg(const std_msgs::Float32::ConstPtr& msg)
+{
+  m_inputs.Modify([&msg](Inputs& inputs) { inputs.rho = msg->data; });
 }
 
 void LinkForcePlugin::OnUpdate()
 {
-  // Get heightmap pointer so we can look up its height values.
+  // The terrain is sampled from the physics heightmap, which unlike the
+  // rendered one also exists when Gazebo runs without a GUI.
   // If we stop using a heightmap for terrain, we will need a new solution for this.
-  rendering::ScenePtr scene = rendering::get_scene();
-  if (!scene) {
-    gzerr << "OnUpdate - scene pointer is NULL" << endl;
-    return;
-  }
-  rendering::Heightmap* heightmap = scene->GetHeightmap();
-  if (!heightmap) {
-    gzerr << "OnUpdate - heightmap pointer is NULL" << endl;
+  if (!m_terrainSampler.IsInitialized() && !m_terrainSampler.Init(m_world)) {
+    if (!m_terrainMissingReported)
+      gzerr << "OnUpdate - there is no heightmap in the world" << endl;
+    m_terrainMissingReported = true;
     return;
   }
 
@@ -104,82 +197,80 @@ void LinkForcePlugin::OnUpdate()
   // <link><inertial><origin> part of the URDF.
   ignition::math::Pose3d cogpose = m_link->WorldCoGPose();
 
-  // Get altitude of center of gravity of link. This is not exact because
-  // the link touches the surface before its center of gravity touches.
+  if (m_footprintSamples == 1) {
+    m_footprintPoints[0] = cogpose.Pos();
+  } else {
+    auto footprint = m_link->CollisionBoundingBox();
+    auto step = (footprint.Max() - footprint.Min()) / (m_footprintSamples - 1);
+    for (int i = 0; i < m_footprintSamples; ++i)
+      for (int j = 0; j < m_footprintSamples; ++j)
+        m_footprintPoints[i * m_footprintSamples + j] =
+          footprint.Min() + ignition::math::Vector3d(i * step.X(), j * step.Y(), 0.0);
+  }
+  auto footprintSamples = m_terrainSampler.Sample(m_footprintPoints, m_footprintHeights);
+  if (footprintSamples == 0)
+    return;
+
+  // Get altitude of center of gravity of link above the mean terrain height
+  // across its footprint. This is not exact because the link touches the
+  // surface before its center of gravity touches.
   // TODO: Is this good enough?
-  double altitude = cogpose.Pos().Z() - heightmap->Height(cogpose.Pos().X(), cogpose.Pos().Y());
+  double terrainHeight = 0.0;
+  int sampleCount = 0;
+  for (auto height : m_footprintHeights)
+    if (!isnan(height)) {
+      terrainHeight += height;
+      ++sampleCount;
+    }
+  double altitude = cogpose.Pos().Z() - terrainHeight / sampleCount;
   if(altitude >= 0) {
     return;
   }
 
   // Get force and torque from lookup table here. Altitude (m) is converted to
   // depth (mm).
-  // TODO: Get proper index for material, maybe depth, pass, and maybe rho.
-  // We will likely get them from topics sent by autonomy.
-  std::vector<float> forces;
-  if(!GetForces(1, -altitude, 1, 0.0002f, forces)) {
+  // Material, pass and rho are the latest received, or the previous ones if
+  // they are being changed right now.
+  m_inputs.TryLoad(m_updateInputs);
+  auto forceTable = m_forceTable->Get();
+  ForceTelemetry::Sample sample;
+  chrono::steady_clock::time_point lookupStart;
+  if (m_telemetry.IsEnabled())
+    lookupStart = chrono::steady_clock::now();
+  if(!forceTable->GetForces(m_updateInputs.material, -altitude, m_updateInputs.pass,
+                            m_updateInputs.rho, m_interpolation, sample.forces,
+                            m_telemetry.IsEnabled() ? &sample.indices : nullptr)) {
+    ReportMissingForces(m_updateInputs);
     return;
   }
+  const float* forces = sample.forces;
+
+  if (m_telemetry.IsEnabled()) {
+    sample.lookupNanoseconds = chrono::duration_cast<chrono::nanoseconds>(
+      chrono::steady_clock::now() - lookupStart).count();
+    sample.simTime = m_world->SimTime().Double();
+    sample.depth = -altitude;
+    sample.rho = m_updateInputs.rho;
+    sample.material = m_updateInputs.material;
+    sample.pass = m_updateInputs.pass;
+    sample.footprintSamples = footprintSamples;
+    m_telemetry.Record(sample);
+  }
 
   // Apply force and torque at the link's CoG
   m_link->AddRelativeForce(ignition::math::Vector3d(forces[0], forces[1], forces[2]));
   m_link->AddRelativeTorque(ignition::math::Vector3d(forces[3], forces[4], forces[5]));
 }
 
-bool LinkForcePlugin::GetForces(int material, float depth, int pass, float rho,
-                                std::vector<float>& out_forces)
-{
-  try {
-    // Find this material
-    auto depth_map = m_forcesMap.at(material);
-
-    // Find the nearest map associated with this floating point depth
-    auto pass_map = FindValueForClosestKey(depth_map, depth);
-
-    // Find this pass
-    auto rho_map = pass_map.at(pass);
-
-    // Find the nearest forces vector associated with this floating point rho
-    auto forces = FindValueForClosestKey(rho_map, rho);
-
-    if(forces.size() != 6) {
-      gzerr << "GetForces - forces vector has size = "
-            << forces.size() << ". It should be 6." << endl;
-      return false;
-    }
-
-    out_forces = forces;
-  }
-  catch (const std::out_of_range& oor) {
-    gzerr << "GetForces - Out of range exception: " << oor.what() << endl;
-    return false;
-  }
-  catch ( ... ) {
-    gzerr << "GetForces -  Exception thrown." << endl;
-    return false;
-  }
-
-  return true;
-}
-
-template <typename key_t, typename value_t>
-value_t LinkForcePlugin::FindValueForClosestKey(const std::map<key_t, value_t>& inmap, const key_t& key)
+void LinkForcePlugin::ReportMissingForces(const Inputs& inputs)
 {
-  // Start with last value in map
-  value_t value = inmap.rbegin()->second;
-  // Get lowest match for key, not less than the key
-  auto not_less_than_iter = inmap.lower_bound(key);
-  if(not_less_than_iter != inmap.end()) {
-    if(not_less_than_iter == inmap.begin())
-      value = not_less_than_iter->second;
-    else {  // Find value if key is in between keys in the map
-      auto previous_iter = std::prev(not_less_than_iter);
-      if ((key - previous_iter->first) < (not_less_than_iter->first - key))
-        value = previous_iter->second;
-      else
-        value = not_less_than_iter->second;
-    }
-  }
-
-  return value;
+  // The table may lack a combination of material and pass, or forces at some
+  // depths, which would otherwise be reported every update
+  if (m_missingForcesReported && m_missingForcesInputs.material == inputs.material
+      && m_missingForcesInputs.pass == inputs.pass)
+    return;
+  gzerr << "OnUpdate - no forces for material " << inputs.material
+        << " and pass " << inputs.pass << ", none are applied." << endl;
+  m_missingForcesReported = true;
+  m_missingForcesInputs = inputs;
 }
@@ -5,14 +5,32 @@
 #ifndef LinkForcePlugin_h
 #define LinkForcePlugin_h
 
+#include <memory>
+#include <string>
+#include <vector>
+#include <ros/ros.h>
+#include <std_msgs/Float32.h>
+#include <std_msgs/Int32.h>
+#include <std_srvs/Trigger.h>
 #include <gazebo/common/Plugin.hh>
-#include "ForceRow.h"
+#include "DoubleBuffer.h"
+#include "ForceTable.h"
+#include "ForceTableCache.h"
+#include "ForceTelemetry.h"
+#include "TerrainSampler.h"
 
 
 namespace gazebo {
 
 // This plugin is added to a robot description and applies forces from a
 // specified lookup table to a specified link in the robot.
+//
+// Lookup tables are shared by all instances that use the same file. A table
+// can be reloaded through a ROS service while the simulation runs: the new
+// table is loaded on the service thread and then swapped in atomically for
+// every instance that uses the file, so the physics thread never waits for it
+// and keeps using the old table until the swap. The material, pass and rho forces are looked up for can be changed
+// through ROS topics the same way.
 class LinkForcePlugin : public ModelPlugin
 {
 public:
@@ -22,23 +40,62 @@ public:
   virtual void Load(physics::ModelPtr _model, sdf::ElementPtr _sdf);
 
 private:
-  bool LoadLookupTable(std::string filename);
+  bool OnReloadLookupTable(std_srvs::Trigger::Request& request,
+                           std_srvs::Trigger::Response& response);
+
+  void OnMaterialMsg(const std_msgs::Int32::ConstPtr& msg);
+  void OnPassMsg(const std_msgs::Int32::ConstPtr& msg);
+  void OnRhoMsg(const std_msgs::Float32::ConstPtr& msg);
 
   void OnUpdate();
 
-  bool GetForces(int material, float depth, int pass, float rho,
-                 std::vector<float>& out_forces);
+  // Excavation conditions forces are looked up for
+  struct Inputs {
+    int32_t material;
+    int32_t pass;
+    float rho;
+  };
 
-  // Find a value in a map when there is not necessarily an exact match for the key
-  template <typename key_t, typename value_t>
-  value_t FindValueForClosestKey(const std::map<key_t, value_t>& inmap, const key_t& key);
+  // Reports a lookup without forces, once until material or pass change
+  void ReportMissingForces(const Inputs& inputs);
 
+  physics::WorldPtr m_world;
   physics::LinkPtr m_link;
 
+  TerrainSampler m_terrainSampler;
+  bool m_terrainMissingReported = false;
+  // Points sampled per side of the link's footprint, and the points and
+  // heights of the last update, kept so that updates do not allocate
+  int m_footprintSamples;
+  std::vector<ignition::math::Vector3d> m_footprintPoints;
+  std::vector<double> m_footprintHeights;
+
   // Connection to the update event
   event::ConnectionPtr m_updateConnection;
 
-  std::map<int, std::map<float, std::map<int, std::map<float, std::vector<float> > > > > m_forcesMap;
+  // Shared with the other instances that use the same file, its table is
+  // replaced from the service thread of any of them while the physics thread
+  // reads it
+  std::shared_ptr<ForceTableCache::Entry> m_forceTable;
+  std::string m_lookupTableFilename;
+  ForceTable::Interpolation m_interpolation;
+
+  // Written by the subscriber threads and read by the physics thread, which
+  // keeps using m_updateInputs when it cannot read them without waiting
+  DoubleBuffer<Inputs> m_inputs;
+  Inputs m_updateInputs;
+  bool m_missingForcesReported = false;
+  Inputs m_missingForcesInputs;
+
+  std::unique_ptr<ros::NodeHandle> m_nodeHandle;
+  ros::ServiceServer m_reloadService;
+  ros::Subscriber m_materialSub;
+  ros::Subscriber m_passSub;
+  ros::Subscriber m_rhoSub;
+  ros::Publisher m_telemetryPub;
+
+  // Optional record of the updates forces are applied in
+  ForceTelemetry m_telemetry;
 };
 
 }
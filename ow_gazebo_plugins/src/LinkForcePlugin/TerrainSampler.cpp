@@ -0,0 +1,65 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#include "TerrainSampler.h"
+#include <cmath>
+#include <limits>
+
+using namespace gazebo;
+using namespace std;
+
+bool TerrainSampler::Init(const physics::WorldPtr& world)
+{
+  physics::CollisionPtr heightmapCollision;
+  for (const auto& model : world->Models())
+    for (const auto& link : model->GetLinks())
+      for (const auto& collision : link->GetCollisions()) {
+        auto shape = boost::dynamic_pointer_cast<physics::HeightmapShape>(collision->GetShape());
+        if (shape) {
+          m_shape = shape;
+          heightmapCollision = collision;
+        }
+      }
+  if (!m_shape)
+    return false;
+
+  auto origin = heightmapCollision->WorldPose().Pos() + m_shape->Pos();
+  auto size = m_shape->Size();
+  auto count = m_shape->VertexCount();
+  m_columns = count.X();
+  m_rows = count.Y();
+  m_originX = origin.X() - size.X() / 2.0;
+  m_originY = origin.Y() + size.Y() / 2.0;
+  m_originZ = origin.Z();
+  m_columnsPerMeter = (m_columns - 1) / size.X();
+  m_rowsPerMeter = (m_rows - 1) / size.Y();
+  return true;
+}
+
+size_t TerrainSampler::Sample(const vector<ignition::math::Vector3d>& points,
+                              vector<double>& out_heights) const
+{
+  out_heights.resize(points.size());
+  size_t onTerrain = 0;
+  for (size_t i = 0; i < points.size(); ++i) {
+    double column = (points[i].X() - m_originX) * m_columnsPerMeter;
+    double row = (m_originY - points[i].Y()) * m_rowsPerMeter;
+    if (!(column >= 0.0 && column <= m_columns - 1 && row >= 0.0 && row <= m_rows - 1)) {
+      out_heights[i] = numeric_limits<double>::quiet_NaN();
+      continue;
+    }
+
+    // bilinear between the four surrounding vertices, the last column and row
+    // use the cell before them
+    int c = min(static_cast<int>(column), m_columns - 2);
+    int r = min(static_cast<int>(row), m_rows - 2);
+    double fc = column - c;
+    double fr = row - r;
+    double top = m_shape->GetHeight(c, r) * (1.0 - fc) + m_shape->GetHeight(c + 1, r) * fc;
+    double bottom = m_shape->GetHeight(c, r + 1) * (1.0 - fc) + m_shape->GetHeight(c + 1, r + 1) * fc;
+    out_heights[i] = top * (1.0 - fr) + bottom * fr + m_originZ;
+    ++onTerrain;
+  }
+  return onTerrain;
+}
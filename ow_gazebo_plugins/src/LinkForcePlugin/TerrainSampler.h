@@ -0,0 +1,53 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#ifndef TerrainSampler_h
+#define TerrainSampler_h
+
+#include <vector>
+#include <gazebo/physics/physics.hh>
+
+
+namespace gazebo {
+
+// Samples the height of the terrain from the physics heightmap, so it works
+// without a rendering scene, as in gzserver. Heights are interpolated between
+// the vertices of the heightmap, which include the changes the dynamic terrain
+// plugins make to it.
+class TerrainSampler
+{
+public:
+  // Finds the heightmap in the world and caches how world coordinates map to
+  // its grid. The heightmap is assumed not to move afterwards. Returns false if
+  // the world has no heightmap yet.
+  bool Init(const physics::WorldPtr& world);
+
+  bool IsInitialized() const
+  {
+    return m_shape != nullptr;
+  }
+
+  // Heights of the terrain under the X and Y of each point, written to
+  // out_heights in the same order, NaN where a point is off the terrain.
+  // Returns the number of points that are on the terrain.
+  size_t Sample(const std::vector<ignition::math::Vector3d>& points,
+                std::vector<double>& out_heights) const;
+
+private:
+  physics::HeightmapShapePtr m_shape;
+
+  // world X and Y of the first vertex of the grid; columns run along +X and
+  // rows along -Y from it
+  double m_originX;
+  double m_originY;
+  double m_originZ;
+  double m_columnsPerMeter;
+  double m_rowsPerMeter;
+  int m_columns;
+  int m_rows;
+};
+
+}
+
+#endif // TerrainSampler_h
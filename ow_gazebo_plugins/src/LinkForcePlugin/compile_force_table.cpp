@@ -0,0 +1,63 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+// Validates a CSV force lookup table and compiles it into the binary format
+// that LinkForcePlugin memory-maps.
+
+#include "ForceTable.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+  if (argc != 3) {
+    cerr << "usage: compile_force_table INPUT_CSV OUTPUT_FILE" << endl;
+    return 1;
+  }
+
+  ifstream infile(argv[1], fstream::in);
+  if (!infile.is_open()) {
+    cerr << "cannot open file: " << argv[1] << endl;
+    return 1;
+  }
+
+  ForceTable table;
+  string error;
+  if (!table.LoadCsv(infile, error)) {
+    cerr << argv[1] << ": " << error << endl;
+    return 1;
+  }
+
+  // A Gazebo process may have the output mapped, and truncating a mapped file
+  // crashes it on its next lookup. The table is written under a temporary
+  // name instead and renamed over the output, which leaves existing mappings
+  // of the old file intact.
+  string output = argv[2];
+  string temporary = output + "." + to_string(getpid()) + ".tmp";
+  {
+    ofstream outfile(temporary, fstream::out | fstream::binary | fstream::trunc);
+    if (!outfile.is_open() || !table.SaveBinary(outfile) || !outfile.flush()) {
+      outfile.close();
+      unlink(temporary.c_str());
+      cerr << "cannot write file: " << temporary << endl;
+      return 1;
+    }
+  }
+  if (rename(temporary.c_str(), output.c_str()) != 0) {
+    cerr << "cannot rename " << temporary << " to " << output << ": "
+         << strerror(errno) << endl;
+    unlink(temporary.c_str());
+    return 1;
+  }
+
+  cout << "compiled " << table.GetEntryCount() << " entries into " << argv[2] << endl;
+  return 0;
+}
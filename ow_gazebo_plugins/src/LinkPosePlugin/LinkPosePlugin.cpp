@@ -0,0 +1,94 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#include "LinkPosePlugin.h"
+#include <gazebo/physics/Model.hh>
+#include <gazebo/physics/Link.hh>
+#include <gazebo/physics/World.hh>
+#include <geometry_msgs/PoseStamped.h>
+
+using namespace gazebo;
+using namespace std;
+
+GZ_REGISTER_MODEL_PLUGIN(LinkPosePlugin)
+
+LinkPosePlugin::LinkPosePlugin() :
+  ModelPlugin()
+{
+}
+
+LinkPosePlugin::~LinkPosePlugin()
+{
+}
+
+void LinkPosePlugin::Load(physics::ModelPtr _model, sdf::ElementPtr _sdf)
+{
+  if (!ros::isInitialized()) {
+    gzerr << "Load - ROS is not initialized." << endl;
+    return;
+  }
+
+  m_world = _model->GetWorld();
+
+  // Topics default to /link_poses/<model name>/<link name>
+  string topicPrefix = "/link_poses/" + _model->GetName();
+  if (_sdf->HasElement("topicPrefix"))
+    topicPrefix = _sdf->Get<string>("topicPrefix");
+
+  m_nodeHandle = make_unique<ros::NodeHandle>();
+
+  for (auto elem = _sdf->GetElementImpl("link"); elem;
+       elem = elem->GetNextElement("link")) {
+    string linkName = elem->Get<string>();
+    physics::LinkPtr link = _model->GetLink(linkName);
+    if (!link) {
+      gzerr << "Load - specified link " << linkName << " is invalid." << endl;
+      continue;
+    }
+    m_links.push_back({link, m_nodeHandle->advertise<geometry_msgs::PoseStamped>(
+      topicPrefix + "/" + linkName, 1)});
+  }
+  if (m_links.empty()) {
+    gzerr << "Load - you must specify at least one valid <link> element." << endl;
+    return;
+  }
+
+  if (_sdf->HasElement("updateRate")) {
+    double rate = _sdf->Get<double>("updateRate");
+    if (rate > 0.0)
+      m_period = common::Time(1.0 / rate);
+  }
+
+  // Publish after physics so that the poses are those of the current step.
+  m_updateConnection = event::Events::ConnectWorldUpdateEnd(std::bind(&LinkPosePlugin::OnUpdate, this));
+}
+
+void LinkPosePlugin::OnUpdate()
+{
+  common::Time now = m_world->SimTime();
+  // Time goes backwards when the world is reset
+  if (now < m_lastPublishTime)
+    m_lastPublishTime = common::Time::Zero;
+  if (m_lastPublishTime != common::Time::Zero && now - m_lastPublishTime < m_period)
+    return;
+  m_lastPublishTime = now;
+
+  geometry_msgs::PoseStamped msg;
+  msg.header.stamp = ros::Time(now.sec, now.nsec);
+  msg.header.frame_id = "world";
+  for (auto& relayed : m_links) {
+    // Nobody has to pay for poses nobody listens to
+    if (relayed.publisher.getNumSubscribers() == 0)
+      continue;
+    ignition::math::Pose3d pose = relayed.link->WorldPose();
+    msg.pose.position.x = pose.Pos().X();
+    msg.pose.position.y = pose.Pos().Y();
+    msg.pose.position.z = pose.Pos().Z();
+    msg.pose.orientation.x = pose.Rot().X();
+    msg.pose.orientation.y = pose.Rot().Y();
+    msg.pose.orientation.z = pose.Rot().Z();
+    msg.pose.orientation.w = pose.Rot().W();
+    relayed.publisher.publish(msg);
+  }
+}
@@ -0,0 +1,52 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#ifndef LinkPosePlugin_h
+#define LinkPosePlugin_h
+
+#include <memory>
+#include <vector>
+#include <ros/ros.h>
+#include <gazebo/common/Plugin.hh>
+
+
+namespace gazebo {
+
+// This plugin is added to a robot description and publishes the world poses of
+// a few specified links of the robot, each on its own topic. Unlike
+// /gazebo/link_states, the size of the messages does not depend on how many
+// other links are in the world.
+class LinkPosePlugin : public ModelPlugin
+{
+public:
+  LinkPosePlugin();
+  ~LinkPosePlugin();
+
+  virtual void Load(physics::ModelPtr _model, sdf::ElementPtr _sdf);
+
+private:
+  void OnUpdate();
+
+  struct RelayedLink {
+    physics::LinkPtr link;
+    ros::Publisher publisher;
+  };
+
+  physics::WorldPtr m_world;
+
+  std::unique_ptr<ros::NodeHandle> m_nodeHandle;
+  std::vector<RelayedLink> m_links;
+
+  // Minimum simulation time between two publications, zero to publish on every
+  // world update
+  common::Time m_period;
+  common::Time m_lastPublishTime;
+
+  // Connection to the update event
+  event::ConnectionPtr m_updateConnection;
+};
+
+}
+
+#endif // LinkPosePlugin_h
@@ -0,0 +1,64 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#ifndef SpscRing_h
+#define SpscRing_h
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Fixed capacity queue between exactly one producer thread and one consumer
+// thread that never locks or allocates once constructed. Each side only
+// writes its own index, so neither ever waits for the other; the producer
+// finds the queue full instead.
+template <typename T>
+class SpscRing
+{
+public:
+  // the capacity is rounded up to a power of two
+  explicit SpscRing(size_t capacity)
+  {
+    size_t size = 1;
+    while (size < capacity)
+      size *= 2;
+    m_items.resize(size);
+    m_mask = size - 1;
+  }
+
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  // producer only, returns false and drops the item if the queue is full
+  bool TryPush(const T& item)
+  {
+    auto head = m_head.load(std::memory_order_relaxed);
+    if (head - m_tail.load(std::memory_order_acquire) > m_mask)
+      return false;
+    m_items[head & m_mask] = item;
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // consumer only, returns false if the queue is empty
+  bool TryPop(T& out_item)
+  {
+    auto tail = m_tail.load(std::memory_order_relaxed);
+    if (tail == m_head.load(std::memory_order_acquire))
+      return false;
+    out_item = m_items[tail & m_mask];
+    m_tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  std::vector<T> m_items;
+  size_t m_mask;
+  // total pushed and popped, on separate cache lines so that the two threads
+  // do not invalidate each other's
+  alignas(64) std::atomic<size_t> m_head{0};
+  alignas(64) std::atomic<size_t> m_tail{0};
+};
+
+#endif // SpscRing_h
@@ -15,7 +15,6 @@ import geometry_msgs.msg
 from math import pi
 from std_msgs.msg import String
 from moveit_commander.conversions import pose_to_list
-from gazebo_msgs.msg import LinkStates
 import math
 import constants
 from sensor_msgs.msg import JointState
@@ -56,24 +55,18 @@ class LinkStateSubscriber:
     self._buffer = tf2_ros.Buffer()
     self._listener = tf2_ros.TransformListener(self._buffer)
     self._link_value = None
-    self.subscriber = rospy.Subscriber("/gazebo/link_states", LinkStates, self._handle_link_states)
+    self.subscriber = rospy.Subscriber("/link_poses/lander/l_scoop", geometry_msgs.msg.PoseStamped, self._handle_link_states)
     
     
   def _handle_link_states(self, data):
-    # position of the end of scoop can be obtained either from raw Gazebo readings
-    # of Link states or from tf2. TF2 method is commented out . Link State method is 
-    # being used in the current implementation
+    # position of the end of scoop can be obtained either from the pose Gazebo
+    # publishes for the link or from tf2. TF2 method is commented out . The link
+    # pose method is being used in the current implementation
       
     """
-    :type data: gazebo_msgs.msg._LinkStates.LinkStates
+    :type data: geometry_msgs.msg.PoseStamped
     """
-    try:
-     idx = data.name.index("lander::l_scoop")
-    except ValueError:
-      rospy.logerr_throttle(
-          1, "LanderInterface: lander::l_scoop_tip not found in link_states")
-      return
-    self._link_value = (data.pose[idx].position)
+    self._link_value = data.pose.position
     
     
     #try:
@@ -5,10 +5,18 @@
 #ifndef REGOLITH_SPAWNER_H
 #define REGOLITH_SPAWNER_H
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include <ros/ros.h>
 #include <tf/tf.h>
 
-#include "gazebo_msgs/LinkStates.h"
+#include "geometry_msgs/PoseStamped.h"
 #include "ow_dynamic_terrain/modified_terrain_diff.h"
 #include "ow_lander/DigLinearActionResult.h"
 #include "ow_lander/DigCircularActionResult.h"
@@ -18,9 +26,9 @@ class RegolithSpawner
 {
 public:
   RegolithSpawner()  = delete;
-  ~RegolithSpawner() = default;
+  ~RegolithSpawner();
   RegolithSpawner(const RegolithSpawner&) = delete;
-  RegolithSpawner& operator=(const RegolithSpawner&) = default;
+  RegolithSpawner& operator=(const RegolithSpawner&) = delete;
 
   RegolithSpawner(ros::NodeHandle* nh);
 
@@ -28,9 +36,16 @@ public:
   // NOTE: this must be called before any other functions
   bool initialize();
 
-  // spawn the regolith model just above the tip of the scoop and apply a force
-  // that keeps it in the scoop during the remainder of scooping operation
-  bool spawnRegolithInScoop(bool with_pushback);
+  // The following queue a request for the worker thread and return
+  // immediately, so topic callbacks are never held up by service calls.
+  // Requests are processed in order; a request of the same type as the last
+  // one still waiting in the queue is merged into it.
+
+  // spawn regolith models just above the tip of a tool and apply a force
+  // that keeps them in the tool during the remainder of scooping operation
+  // returns: false if no tool of that link name is configured
+  bool spawnRegolithInScoop(const std::string &tool_link_name, int count,
+                            bool with_pushback);
 
   // clears all artificial forces still being applied to regolith models
   void clearAllPsuedoForces();
@@ -38,15 +53,13 @@ public:
   // deletes all regolith models
   void removeAllRegolithModels();
 
-  // saves the orientation of scoop to a member variable
-  void onLinkStatesMsg(const gazebo_msgs::LinkStates::ConstPtr &msg);
-
-  // computes the volume displaced from a modified terrain diff image and
-  // and spawns reoglith if it surpasses the spawn threshold
+  // computes the volume displaced from a modified terrain diff image, adds it
+  // to the tool nearest to the modification, and spawns one reoglith model in
+  // that tool for each time its volume surpasses the spawn threshold
   void onModDiffVisualMsg(const ow_dynamic_terrain::modified_terrain_diff::ConstPtr &msg);
 
   // both call clearAllPsuedoForces at the end of a dig and reset the tracked
-  // volume to zero
+  // volume of every tool to zero, as the results do not identify a tool
   void onDigLinearResultMsg(const ow_lander::DigLinearActionResult::ConstPtr &msg);
   void onDigCircularResultMsg(const ow_lander::DigCircularActionResult::ConstPtr &msg);
 
@@ -54,40 +67,143 @@ public:
   void onDeliverResultMsg(const ow_lander::DeliverActionResult::ConstPtr &msg);
 
 private:
+  // a tool that digs regolith, such as a scoop, and the volume it has
+  // displaced since it last spawned regolith
+  struct Tool {
+    // Gazebo link name of the tool particles will spawn in
+    std::string link_name;
+    // a vector that describes the forward direction of the tool
+    tf::Vector3 forward;
+    // an offset relative to the tool's frame where regolith will be spawned
+    tf::Vector3 spawn_offset;
+    // regolith will spawn once this amount of volume is displaced
+    double spawn_threshold;
+    // width of the square layers regolith is laid out in when several models
+    // are spawned at once
+    double spawn_layer_width;
+    // terrain modifications farther than this from the tool (horizontally)
+    // are not attributed to it
+    double attribution_radius;
+    ros::Subscriber pose_sub;
+
+    // guards the members below, which change as messages arrive
+    std::mutex mutex;
+    // sum of volume displaced since previous reoglith spawning
+    double volume_displaced;
+    // pose of the tool in Gazebo, valid once has_pose is set
+    tf::Vector3 position;
+    tf::Quaternion orientation;
+    bool has_pose;
+  };
+
+  // reads the tools parameter, or configures the scoop of the lander if the
+  // parameter is not set
+  bool loadTools();
+
+  // saves the pose of a tool
+  void onToolPoseMsg(Tool *tool, const geometry_msgs::PoseStamped::ConstPtr &msg);
+
+  // force that pushes models toward the back of a tool, given its current
+  // orientation; the tool's mutex must be held
+  tf::Vector3 computePushbackForce(const Tool &tool) const;
+
+  void queueSpawn(const Tool &tool, int count, const tf::Vector3 &pushback_force);
+
+  void resetVolumeDisplaced();
+
+  // a request waiting in the queue of the worker thread
+  struct Request {
+    enum class Type { SPAWN, CLEAR_FORCES, REMOVE_ALL } type;
+    // tool models are spawned in
+    const Tool *tool;
+    // number of models to spawn
+    int count;
+    tf::Vector3 pushback_force;
+    // when the oldest of the requests merged into this one was queued
+    std::chrono::steady_clock::time_point queued;
+  };
+
+  void queueRequest(const Request &request);
+
+  void processRequests();
+
+  void publishQueueStats(double latency);
+
+  // positions of the models of a spawn relative to the tool
+  void getSpawnPositions(const Tool &tool, int count,
+                         std::vector<tf::Vector3> &out_positions);
+
+  // spawns regolith through the batched services of RegolithWorldPlugin
+  bool spawnWithWorldPlugin(const Tool &tool, int count,
+                            const tf::Vector3 &pushback_force);
+
+  // spawns regolith through the gazebo_ros services, one call per model and
+  // one per force, when the world does not load RegolithWorldPlugin
+  bool spawnWithGazeboServices(const Tool &tool, int count,
+                               const tf::Vector3 &pushback_force);
+
+  bool clearForces();
+
+  bool removeModels();
+
   // ROS interfaces
   std::unique_ptr<ros::NodeHandle> m_node_handle;
+  ros::ServiceClient m_spawn_regolith;
+  ros::ServiceClient m_remove_regolith;
+  ros::ServiceClient m_clear_regolith_forces;
   ros::ServiceClient m_gz_spawn_model;
   ros::ServiceClient m_gz_delete_model;
   ros::ServiceClient m_gz_apply_wrench;
   ros::ServiceClient m_gz_clear_wrench;
-  ros::Subscriber m_link_states;
   ros::Subscriber m_mod_diff_visual;
   ros::Subscriber m_dig_linear_result;
   ros::Subscriber m_dig_circular_result;
   ros::Subscriber m_deliver_result;
 
-  // sum of volume displaced since previous reoglith spawning
-  double m_volume_displaced;
-  // orientation of scoop in Gazebo
-  tf::Quaternion m_scoop_orientation;
-
-  // regolith will spawn once this amount of volume is displaced
+  ros::Publisher m_queue_stats_pub;
+
+  // true if the world provides the RegolithWorldPlugin services
+  bool m_use_world_plugin;
+  // removes all regolith models upon completion of a delivery, off by default
+  // when the world plugin retires models with its lifecycle policies
+  bool m_remove_on_deliver;
+
+  // request queue and the worker thread that makes the service calls
+  std::deque<Request> m_requests;
+  std::mutex m_requests_mutex;
+  std::condition_variable m_requests_cv;
+  std::thread m_worker;
+  bool m_stop_worker;
+
+  // queue statistics, only accessed while holding m_requests_mutex
+  uint64_t m_queued_count;
+  uint64_t m_merged_count;
+  uint64_t m_processed_count;
+  double m_mean_latency;
+  double m_max_latency;
+
+  // tools regolith is spawned in, the vector is not modified after
+  // initialization so it may be read from any thread
+  std::vector<std::unique_ptr<Tool>> m_tools;
+
+  // defaults for tools that do not set their own
   double m_spawn_threshold;
-  // Gazebo link name of the scoop particles will spawn in
-  std::string m_scoop_link_name;
-  // a vector that describes the forward direction of the scoop
-  tf::Vector3 m_scoop_forward;
-  // an offset relative to the scoop's frame where regolith will be spawned
-  tf::Vector3 m_scoop_spawn_offset;
+  double m_spawn_layer_width;
 
   // regolith model that spawns in the scoop when digging occurs
   std::string m_model_uri;
   std::string m_model_sdf;
   std::string m_model_link_name;
+  float m_model_radius;
   // magnitude of the force that pushes each model into the back of the scoop
   float m_psuedo_force_mag;
+  // model names are the prefix followed by a count, only used when spawning
+  // through the gazebo_ros services
+  std::string m_model_name_prefix;
+  unsigned int m_spawn_count;
 
-  // keeps track of all regolith models and links present in the simulation
+  // keeps track of all regolith models and links present in the simulation,
+  // only accessed by the worker thread
   struct Regolith {
     std::string model_name;
     std::string body_name;
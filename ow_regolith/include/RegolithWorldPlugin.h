@@ -0,0 +1,234 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#ifndef REGOLITH_WORLD_PLUGIN_H
+#define REGOLITH_WORLD_PLUGIN_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <ros/ros.h>
+#include <ros/callback_queue.h>
+
+#include <gazebo/common/Plugin.hh>
+#include <gazebo/physics/physics.hh>
+
+#include "ow_regolith/SpawnRegolith.h"
+#include "ow_regolith/RemoveRegolith.h"
+#include "ow_regolith/ClearRegolithForces.h"
+
+namespace ow_regolith {
+
+// Spawns, pushes and removes regolith models from within the Gazebo process.
+// Model SDF is loaded and parsed once per URI, and every request handles a
+// whole batch of models, so spawning a scoop full of regolith costs a single
+// ROS round trip instead of two per model.
+//
+// Models are never deleted. Removed models are parked out of the world with
+// physics disabled and are teleported back in by later spawns, so the number
+// of models Gazebo creates is bounded by the most that were ever in the world
+// at once. A pool of models can be created up front so that spawning never has
+// to wait for Gazebo to create one.
+//
+// Optionally, models that come to rest away from the scoop are consolidated:
+// they are parked and their volume is deposited into the dynamic terrain, which
+// keeps the number of bodies the physics engine simulates bounded. Models can
+// also be retired based on where they are: outside of the workspace, below the
+// terrain, or within regions such as the sample dock.
+//
+// Optionally, models spawned into the scoop are carried kinematically instead
+// of being pushed into it: they stop being simulated and are moved along with
+// the scoop every update until it tilts far enough to pour them out.
+class RegolithWorldPlugin : public gazebo::WorldPlugin
+{
+public:
+  RegolithWorldPlugin() = default;
+  ~RegolithWorldPlugin();
+  RegolithWorldPlugin(const RegolithWorldPlugin&) = delete;
+  RegolithWorldPlugin& operator=(const RegolithWorldPlugin&) = delete;
+
+  void Load(gazebo::physics::WorldPtr world, sdf::ElementPtr sdf) override;
+
+private:
+  // model template for an URI, it is loaded and parsed on first use only
+  struct ModelTemplate {
+    sdf::SDFPtr sdf;
+    std::string link_name;
+    float radius;
+  };
+
+  struct Regolith {
+    std::string uri;
+    std::string model_name;
+    gazebo::physics::ModelPtr model;
+    gazebo::physics::LinkPtr link;
+    ignition::math::Vector3d pseudo_force;
+    // consecutive updates the model has been at rest for
+    unsigned int rest_count;
+    // true while the model is part of a payload
+    bool carried;
+  };
+
+  // models carried by a link, with their poses relative to it
+  struct Payload {
+    gazebo::physics::LinkPtr carrier;
+    std::vector<Regolith *> members;
+    std::vector<ignition::math::Pose3d> offsets;
+  };
+
+  // a model inserted into the world that the world has yet to create
+  struct PendingModel {
+    std::string link_name;
+    Regolith regolith;
+    // park the model once created instead of making it active
+    bool park;
+  };
+
+  // services the ROS callback queue, resolves models the world has created
+  // since the last update and applies the pseudo forces
+  void onUpdate();
+
+  bool onSpawnRegolith(SpawnRegolith::Request &request,
+                       SpawnRegolith::Response &response);
+
+  bool onRemoveRegolith(RemoveRegolith::Request &request,
+                        RemoveRegolith::Response &response);
+
+  bool onClearRegolithForces(ClearRegolithForces::Request &request,
+                             ClearRegolithForces::Response &response);
+
+  // model_xml is parsed instead of loading the model at the URI if it's given
+  const ModelTemplate *getModelTemplate(const std::string &uri,
+                                        const std::string &model_xml = "");
+
+  // inserts a new copy of a model template into the world
+  // returns: the scoped name of the link of the new model
+  std::string insertModel(const std::string &uri,
+                          const ModelTemplate &model_template,
+                          const ignition::math::Pose3d &pose,
+                          const ignition::math::Vector3d &pseudo_force,
+                          bool park);
+
+  // parks an active model and makes it available for reuse
+  // returns: the iterator following the retired model
+  std::map<std::string, Regolith>::iterator
+  retire(std::map<std::string, Regolith>::iterator it);
+
+  // moves a model out of the world and stops simulating it
+  void park(const Regolith &regolith);
+
+  bool isParked(const std::string &link_name) const;
+
+  // parks models that have been at rest away from the keep out link for long
+  // enough and deposits their volume into the terrain where they were
+  void consolidateSettledModels();
+
+  // retires the models that are outside of the workspace, below the terrain,
+  // or within a retirement region
+  void applyLifecyclePolicies();
+
+  // height of the collision terrain at a point, false if it's off the terrain
+  bool getTerrainHeight(double x, double y, double &out_height);
+
+  // moves a parked model to a pose and resumes simulating it
+  void unpark(const Regolith &regolith, const ignition::math::Pose3d &pose);
+
+  // adds a model to the payload of a link and stops simulating it, the model
+  // must be at the pose it is carried at
+  void carry(Regolith &regolith, const gazebo::physics::LinkPtr &carrier,
+             const ignition::math::Pose3d &offset);
+
+  // moves carried models along with their carriers, and releases the whole
+  // payload of a carrier that tilted past the release angle
+  void updatePayloads();
+
+  // removes a model from the payload it is part of, if any
+  void dropFromPayload(Regolith &regolith);
+
+  void publishPoolStats();
+
+  gazebo::physics::WorldPtr m_world;
+  gazebo::event::ConnectionPtr m_update_connection;
+
+  std::unique_ptr<ros::NodeHandle> m_node_handle;
+  ros::CallbackQueue m_callback_queue;
+  ros::ServiceServer m_spawn_srv;
+  ros::ServiceServer m_remove_srv;
+  ros::ServiceServer m_clear_forces_srv;
+  ros::Publisher m_pool_stats_pub;
+  ros::Publisher m_modify_terrain_pub;
+
+  std::map<std::string, ModelTemplate> m_templates;
+
+  // regolith models in the world, keyed by the scoped name of their link; the
+  // link is null until the world has created the model
+  std::map<std::string, Regolith> m_regolith;
+  // parked regolith models available for reuse, keyed by model URI
+  std::map<std::string, std::vector<Regolith>> m_parked;
+  std::vector<PendingModel> m_pending;
+
+  // where parked models are kept
+  ignition::math::Pose3d m_park_pose;
+
+  // consolidation settings, consolidation is disabled when the count is zero
+  unsigned int m_consolidation_rest_count = 0;
+  double m_rest_linear_velocity;
+  double m_rest_angular_velocity;
+  // models closer than the keep out radius to this entity are never
+  // consolidated, which is meant to exclude models that are in the scoop
+  std::string m_keep_out_entity;
+  double m_keep_out_radius;
+  double m_deposit_radius;
+  // volume deposited into the terrain for each model, zero to use the volume
+  // of the model's collision
+  double m_deposit_volume;
+  uint64_t m_consolidated = 0;
+
+  // lifecycle settings, policies are applied every m_lifecycle_period updates
+  // and not at all if it is zero
+  unsigned int m_lifecycle_period = 0;
+  unsigned int m_lifecycle_counter = 0;
+  bool m_workspace_enabled = false;
+  ignition::math::Vector3d m_workspace_min;
+  ignition::math::Vector3d m_workspace_max;
+  bool m_below_terrain_enabled = false;
+  double m_below_terrain_margin;
+  // an axis aligned box in the frame of an entity, or the world if empty
+  struct RetirementRegion {
+    std::string name;
+    std::string frame;
+    ignition::math::Vector3d min;
+    ignition::math::Vector3d max;
+  };
+  std::vector<RetirementRegion> m_retirement_regions;
+  gazebo::physics::HeightmapShapePtr m_heightmap_shape;
+  gazebo::physics::CollisionPtr m_heightmap_collision;
+  uint64_t m_retired = 0;
+
+  // carried payload settings, models are pushed into the scoop instead when
+  // carrying is disabled
+  bool m_carry_enabled = false;
+  // direction in the carrier's frame that points up when it is level
+  ignition::math::Vector3d m_carry_up_axis;
+  // angle between the up axis and the world's vertical beyond which a
+  // payload is released
+  double m_carry_release_angle;
+  // payloads keyed by the scoped name of their carrier
+  std::map<std::string, Payload> m_payloads;
+  uint64_t m_released = 0;
+
+  unsigned int m_spawn_count = 0;
+
+  // pool statistics
+  unsigned int m_high_water_mark = 0;
+  uint64_t m_reused = 0;
+  uint64_t m_created = 0;
+  double m_last_spawn_duration = 0.0;
+};
+
+} // namespace ow_regolith
+
+#endif // REGOLITH_WORLD_PLUGIN_H
@@ -25,6 +25,10 @@ bool getModelLinkName(const sdf::SDFPtr &sdf, std::string &out_name);
 // get the mass of the first link of the model
 bool getModelLinkMass(const sdf::SDFPtr &sdf, float &out_mass);
 
+// get the radius of a sphere that bounds the first collision of the first link
+// of the model, only sphere and box geometries are supported
+bool getModelLinkRadius(const sdf::SDFPtr &sdf, float &out_radius);
+
 }
 
 #endif // SDF_UTILITY_H
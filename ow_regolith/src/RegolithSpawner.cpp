@@ -5,8 +5,8 @@
 // TODO:
 //  1. Support sloped scooping.
 //  2. Work around reliance on action callbacks from ow_lander.
-//  3. Delete particles based on where they are and what they are doing. Try and
-//     avoid use of the deliver result callback.
+//  3. Retire models without the deliver result callback when the world does
+//     not load the world plugin.
 
 #include "RegolithSpawner.h"
 
@@ -14,6 +14,8 @@
 
 #define _USE_MATH_DEFINES
 #include <cmath>
+#include <algorithm>
+#include <limits>
 
 #include <sensor_msgs/image_encodings.h>
 #include <cv_bridge/cv_bridge.h>
@@ -23,10 +25,15 @@
 #include <gazebo_msgs/DeleteModel.h>
 #include <gazebo_msgs/ApplyBodyWrench.h>
 #include <gazebo_msgs/BodyRequest.h>
-#include <gazebo_msgs/LinkStates.h>
+
+#include "ow_regolith/SpawnRegolith.h"
+#include "ow_regolith/RemoveRegolith.h"
+#include "ow_regolith/ClearRegolithForces.h"
+#include "ow_regolith/RegolithQueueStats.h"
 
 using namespace ow_dynamic_terrain;
 using namespace ow_lander;
+using namespace ow_regolith;
 using namespace gazebo_msgs;
 using namespace sensor_msgs;
 using namespace cv_bridge;
@@ -40,12 +47,11 @@ using std::stringstream;
 using std::acos;
 using std::cos;
 using std::unique_ptr;
-using std::find;
-using std::distance;
-using std::begin;
-using std::end;
 
 // service paths used in class
+const static std::string SRV_SPAWN_REGOLITH        = "/ow_regolith/spawn_regolith";
+const static std::string SRV_REMOVE_REGOLITH       = "/ow_regolith/remove_regolith";
+const static std::string SRV_CLEAR_REGOLITH_FORCES = "/ow_regolith/clear_regolith_forces";
 const static std::string SRV_GET_PHYS_PROPS  = "/gazebo/get_physics_properties";
 const static std::string SRV_SPAWN_MODEL     = "/gazebo/spawn_sdf_model";
 const static std::string SRV_DELETE_MODEL    = "/gazebo/delete_model";
@@ -53,11 +59,12 @@ const static std::string SRV_APPLY_WRENCH    = "/gazebo/apply_body_wrench";
 const static std::string SRV_CLEAR_WRENCH    = "/gazebo/clear_body_wrenches";
 
 // topic paths used in class
-const static std::string TOPIC_LINK_STATES           = "/gazebo/link_states";
+const static std::string TOPIC_LINK_POSES            = "/link_poses";
 const static std::string TOPIC_MODIFY_TERRAIN_VISUAL = "/ow_dynamic_terrain/modification_differential/visual";
 const static std::string TOPIC_DIG_LINEAR_RESULT     = "/DigLinear/result";
 const static std::string TOPIC_DIG_CIRCULAR_RESULT   = "/DigCircular/result";
 const static std::string TOPIC_DELIVER_RESULT        = "/Deliver/result";
+const static std::string TOPIC_QUEUE_STATS           = "/regolith_node/queue_stats";
 
 template <class T>
 static bool createRosServiceClient(unique_ptr<ros::NodeHandle> &nh,
@@ -91,18 +98,81 @@ static bool callRosService(ros::ServiceClient &srv, T &msg)
   return true;
 }
 
+// reads an [x, y, z] list from a tool's parameters
+static bool getVector3Param(XmlRpc::XmlRpcValue &param, const string &key,
+                            Vector3 &out_vector)
+{
+  if (!param.hasMember(key))
+    return true;
+  auto &value = param[key];
+  if (value.getType() != XmlRpc::XmlRpcValue::TypeArray || value.size() != 3) {
+    ROS_ERROR("Tool parameter %s must be a list of 3 numbers", key.c_str());
+    return false;
+  }
+  double xyz[3];
+  for (auto i = 0; i < 3; ++i) {
+    if (value[i].getType() == XmlRpc::XmlRpcValue::TypeInt) {
+      xyz[i] = static_cast<int>(value[i]);
+    } else if (value[i].getType() == XmlRpc::XmlRpcValue::TypeDouble) {
+      xyz[i] = static_cast<double>(value[i]);
+    } else {
+      ROS_ERROR("Tool parameter %s must be a list of 3 numbers", key.c_str());
+      return false;
+    }
+  }
+  out_vector.setValue(xyz[0], xyz[1], xyz[2]);
+  return true;
+}
+
+// reads a number from a tool's parameters
+static bool getDoubleParam(XmlRpc::XmlRpcValue &param, const string &key,
+                           double &out_value)
+{
+  if (!param.hasMember(key))
+    return true;
+  auto &value = param[key];
+  if (value.getType() == XmlRpc::XmlRpcValue::TypeInt) {
+    out_value = static_cast<int>(value);
+  } else if (value.getType() == XmlRpc::XmlRpcValue::TypeDouble) {
+    out_value = static_cast<double>(value);
+  } else {
+    ROS_ERROR("Tool parameter %s must be a number", key.c_str());
+    return false;
+  }
+  return true;
+}
+
 RegolithSpawner::RegolithSpawner(ros::NodeHandle* nh)
   : m_node_handle(nh), 
-    m_volume_displaced(0.0),
-    m_scoop_forward(1.0, 0.0, 0.0),
-    m_scoop_spawn_offset(0.0, 0.0, -0.05),
-    m_scoop_link_name("lander::l_scoop_tip")
+    m_use_world_plugin(false),
+    m_remove_on_deliver(false),
+    m_stop_worker(false),
+    m_queued_count(0),
+    m_merged_count(0),
+    m_processed_count(0),
+    m_mean_latency(0.0),
+    m_max_latency(0.0),
+    m_spawn_count(0)
 {
   // get node parameters
   if (!m_node_handle->getParam("spawn_volume_threshold", m_spawn_threshold))
     ROS_ERROR("Regolith node requires the spawn_volume_threshold parameter.");
   if (!m_node_handle->getParam("regolith_model_uri", m_model_uri))
     ROS_ERROR("Regolith node requires the regolith_model_uri paramter.");
+  m_node_handle->param("spawn_layer_width", m_spawn_layer_width, 0.05);
+  m_node_handle->param("model_name_prefix", m_model_name_prefix,
+                       string("regolith_"));
+}
+
+RegolithSpawner::~RegolithSpawner()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_requests_mutex);
+    m_stop_worker = true;
+  }
+  m_requests_cv.notify_one();
+  if (m_worker.joinable())
+    m_worker.join();
 }
 
 bool RegolithSpawner::initialize()
@@ -113,6 +183,9 @@ bool RegolithSpawner::initialize()
   constexpr auto MAX_SCOOP_INCLINATION_RAD = MAX_SCOOP_INCLINATION_DEG * M_PI / 180.0f; // radians
   constexpr auto PSUEDO_FORCE_WEIGHT_FACTOR = 1.0f / cos(MAX_SCOOP_INCLINATION_RAD);
 
+  if (!loadTools())
+    return false;
+
   // load SDF model
   if (!getSdfFromUri(m_model_uri, m_model_sdf)) {
     ROS_ERROR("Failed to load SDF for regolith model");
@@ -122,7 +195,8 @@ bool RegolithSpawner::initialize()
   auto sdf = parseSdf(m_model_sdf);
   float model_mass;
   if (!getModelLinkMass(sdf, model_mass) ||
-      !getModelLinkName(sdf, m_model_link_name)) {
+      !getModelLinkName(sdf, m_model_link_name) ||
+      !getModelLinkRadius(sdf, m_model_radius)) {
     ROS_ERROR("Failed to acquire regolith model SDF parameters");
     return false;
   }
@@ -132,39 +206,82 @@ bool RegolithSpawner::initialize()
   if (!createRosServiceClient<GetPhysicsProperties>(m_node_handle,
                                                     SRV_GET_PHYS_PROPS,
                                                     gz_get_phys_prop,
-                                                    false)  ||
-      !createRosServiceClient<SpawnModel>(          m_node_handle,
-                                                    SRV_SPAWN_MODEL,
-                                                    m_gz_spawn_model,
-                                                    false)   ||
-      !createRosServiceClient<DeleteModel>(         m_node_handle,
-                                                    SRV_DELETE_MODEL,
-                                                    m_gz_delete_model,
-                                                    false)   ||
-      !createRosServiceClient<ApplyBodyWrench>(     m_node_handle,
-                                                    SRV_APPLY_WRENCH,
-                                                    m_gz_apply_wrench,
-                                                    false)   ||
-      !createRosServiceClient<BodyRequest>(         m_node_handle,
-                                                    SRV_CLEAR_WRENCH,
-                                                    m_gz_clear_wrench,
-                                                    false))
-  {
+                                                    false)) {
     ROS_ERROR("Failed to connect to all required ROS services");
     return false;
   }
 
+  // the world is loaded by the time Gazebo's services are up, so if the
+  // regolith plugin is part of it, its services exist as well
+  m_use_world_plugin = ros::service::exists(SRV_SPAWN_REGOLITH, false);
+  if (m_use_world_plugin) {
+    if (!createRosServiceClient<SpawnRegolith>(      m_node_handle,
+                                                     SRV_SPAWN_REGOLITH,
+                                                     m_spawn_regolith,
+                                                     false)   ||
+        !createRosServiceClient<RemoveRegolith>(     m_node_handle,
+                                                     SRV_REMOVE_REGOLITH,
+                                                     m_remove_regolith,
+                                                     false)   ||
+        !createRosServiceClient<ClearRegolithForces>(m_node_handle,
+                                                     SRV_CLEAR_REGOLITH_FORCES,
+                                                     m_clear_regolith_forces,
+                                                     false))
+    {
+      ROS_ERROR("Failed to connect to all required ROS services");
+      return false;
+    }
+  } else {
+    ROS_WARN("World does not load RegolithWorldPlugin, regolith will be "
+             "spawned one model at a time through Gazebo's services");
+    if (!createRosServiceClient<SpawnModel>(     m_node_handle,
+                                                 SRV_SPAWN_MODEL,
+                                                 m_gz_spawn_model,
+                                                 false)   ||
+        !createRosServiceClient<DeleteModel>(    m_node_handle,
+                                                 SRV_DELETE_MODEL,
+                                                 m_gz_delete_model,
+                                                 false)   ||
+        !createRosServiceClient<ApplyBodyWrench>(m_node_handle,
+                                                 SRV_APPLY_WRENCH,
+                                                 m_gz_apply_wrench,
+                                                 false)   ||
+        !createRosServiceClient<BodyRequest>(    m_node_handle,
+                                                 SRV_CLEAR_WRENCH,
+                                                 m_gz_clear_wrench,
+                                                 false))
+    {
+      ROS_ERROR("Failed to connect to all required ROS services");
+      return false;
+    }
+  }
+
+  // the world plugin's lifecycle policies retire models, without it nothing
+  // but the completion of a delivery removes them
+  m_node_handle->param("remove_on_deliver", m_remove_on_deliver,
+                       !m_use_world_plugin);
+
   // subscribe to all ROS topics
-  m_link_states         = m_node_handle->subscribe(
-    TOPIC_LINK_STATES, 1, &RegolithSpawner::onLinkStatesMsg, this);
+  for (auto &tool : m_tools) {
+    // pose topics follow the convention of LinkPosePlugin
+    auto topic = tool->link_name;
+    for (auto pos = topic.find("::"); pos != string::npos; pos = topic.find("::"))
+      topic.replace(pos, 2, "/");
+    tool->pose_sub      = m_node_handle->subscribe<geometry_msgs::PoseStamped>(
+      TOPIC_LINK_POSES + "/" + topic, 1,
+      boost::bind(&RegolithSpawner::onToolPoseMsg, this, tool.get(), _1));
+  }
+  // one differential is published per update and group of adjacent edits, a
+  // larger queue keeps those of simultaneous edits by distant tools
   m_mod_diff_visual     = m_node_handle->subscribe(
-    TOPIC_MODIFY_TERRAIN_VISUAL, 1, &RegolithSpawner::onModDiffVisualMsg, this);
+    TOPIC_MODIFY_TERRAIN_VISUAL, 10, &RegolithSpawner::onModDiffVisualMsg, this);
   m_dig_linear_result   = m_node_handle->subscribe(
     TOPIC_DIG_LINEAR_RESULT, 1, &RegolithSpawner::onDigLinearResultMsg, this);
   m_dig_circular_result = m_node_handle->subscribe(
     TOPIC_DIG_CIRCULAR_RESULT, 1, &RegolithSpawner::onDigCircularResultMsg, this);
-  m_deliver_result      = m_node_handle->subscribe(
-    TOPIC_DELIVER_RESULT, 1, &RegolithSpawner::onDeliverResultMsg, this);
+  if (m_remove_on_deliver)
+    m_deliver_result    = m_node_handle->subscribe(
+      TOPIC_DELIVER_RESULT, 1, &RegolithSpawner::onDeliverResultMsg, this);
 
   // query gazebo for the gravity vector
   GetPhysicsProperties msg;
@@ -178,89 +295,353 @@ bool RegolithSpawner::initialize()
   // psuedo force magnitude = model's weight X weight factor
   m_psuedo_force_mag = model_mass * gravity.length() * PSUEDO_FORCE_WEIGHT_FACTOR;
 
+  m_queue_stats_pub = m_node_handle->advertise<RegolithQueueStats>(
+    TOPIC_QUEUE_STATS, 1);
+  m_worker = std::thread(&RegolithSpawner::processRequests, this);
+
   return true;
 }
 
-bool RegolithSpawner::spawnRegolithInScoop(bool with_pushback)
+bool RegolithSpawner::loadTools()
 {
-  ROS_INFO("Spawning regolith");
-
-  // spawn model
-  static auto spawn_count = 0;
-  stringstream model_name;
-  model_name << "regolith_" << spawn_count++;
-
-  SpawnModel spawn_msg;
-  
-  spawn_msg.request.model_name                  = model_name.str();
-  spawn_msg.request.model_xml                   = m_model_sdf;
-  spawn_msg.request.robot_namespace             = "/regolith";
-  spawn_msg.request.reference_frame             = m_scoop_link_name;
+  XmlRpc::XmlRpcValue tools;
+  if (!m_node_handle->getParam("tools", tools)) {
+    // without a tools parameter the node serves the scoop of the lander
+    tools.setSize(1);
+    tools[0]["link"] = string("lander::l_scoop_tip");
+  }
+  if (tools.getType() != XmlRpc::XmlRpcValue::TypeArray || tools.size() == 0) {
+    ROS_ERROR("Regolith node parameter tools must be a non-empty list");
+    return false;
+  }
 
-  spawn_msg.request.initial_pose.orientation.x  = 0.0;
-  spawn_msg.request.initial_pose.orientation.y  = 0.0;
-  spawn_msg.request.initial_pose.orientation.z  = 0.0;
-  spawn_msg.request.initial_pose.orientation.w  = 0.0;
+  for (auto i = 0; i < tools.size(); ++i) {
+    auto &param = tools[i];
+    if (param.getType() != XmlRpc::XmlRpcValue::TypeStruct
+        || !param.hasMember("link")
+        || param["link"].getType() != XmlRpc::XmlRpcValue::TypeString) {
+      ROS_ERROR("Each regolith tool requires a link parameter");
+      return false;
+    }
 
-  spawn_msg.request.initial_pose.position.x     = m_scoop_spawn_offset.getX();
-  spawn_msg.request.initial_pose.position.y     = m_scoop_spawn_offset.getY();
-  spawn_msg.request.initial_pose.position.z     = m_scoop_spawn_offset.getZ();
+    auto tool = std::make_unique<Tool>();
+    tool->link_name          = static_cast<string>(param["link"]);
+    tool->forward            = Vector3(1.0, 0.0, 0.0);
+    tool->spawn_offset       = Vector3(0.0, 0.0, -0.05);
+    tool->spawn_threshold    = m_spawn_threshold;
+    tool->spawn_layer_width  = m_spawn_layer_width;
+    tool->attribution_radius = 0.3;
+    tool->volume_displaced   = 0.0;
+    tool->has_pose           = false;
+    if (!getVector3Param(param, "forward", tool->forward)
+        || !getVector3Param(param, "spawn_offset", tool->spawn_offset)
+        || !getDoubleParam(param, "spawn_volume_threshold", tool->spawn_threshold)
+        || !getDoubleParam(param, "spawn_layer_width", tool->spawn_layer_width)
+        || !getDoubleParam(param, "attribution_radius", tool->attribution_radius))
+      return false;
+    // layers of spawned models are stacked along the offset
+    if (tool->spawn_offset.isZero()) {
+      ROS_ERROR("Regolith tool %s requires a non-zero spawn_offset",
+                tool->link_name.c_str());
+      return false;
+    }
+    m_tools.push_back(std::move(tool));
+  }
+  return true;
+}
 
-  if (!callRosService(m_gz_spawn_model, spawn_msg))
+bool RegolithSpawner::spawnRegolithInScoop(const string &tool_link_name,
+                                           int count, bool with_pushback)
+{
+  auto it = std::find_if(m_tools.begin(), m_tools.end(),
+    [&tool_link_name](const std::unique_ptr<Tool> &tool) {
+      return tool->link_name == tool_link_name;
+    });
+  if (it == m_tools.end()) {
+    ROS_ERROR("No regolith tool is configured for %s", tool_link_name.c_str());
     return false;
+  }
+  auto &tool = **it;
 
-  // if no pushback is desired, we're done
-  if (!with_pushback)
-    return true;
+  Vector3 pushback_force(0.0, 0.0, 0.0);
+  if (with_pushback) {
+    std::lock_guard<std::mutex> lock(tool.mutex);
+    pushback_force = computePushbackForce(tool);
+  }
+  queueSpawn(tool, count, pushback_force);
+  return true;
+}
 
-  // compute scooping direction from scoop orientation
-  Vector3 scooping_vec(tf::quatRotate(m_scoop_orientation, m_scoop_forward));
+Vector3 RegolithSpawner::computePushbackForce(const Tool &tool) const
+{
+  // compute scooping direction from tool orientation
+  Vector3 scooping_vec(tf::quatRotate(tool.orientation, tool.forward));
   // flatten scooping direction against X-Y plane
   scooping_vec.setZ(0.0);
   // define pushback direction as opposite to the scooping direction
   Vector3 pushback_vec(-scooping_vec.normalize());
+  return m_psuedo_force_mag * pushback_vec;
+}
 
-  // apply psuedo force to keep model in the scoop
-  stringstream body_name;
-  body_name << model_name.str() << "::" << m_model_link_name;
+void RegolithSpawner::queueSpawn(const Tool &tool, int count,
+                                 const Vector3 &pushback_force)
+{
+  ROS_INFO("Spawning %d regolith in %s", count, tool.link_name.c_str());
+  queueRequest({Request::Type::SPAWN, &tool, count, pushback_force,
+                std::chrono::steady_clock::now()});
+}
 
-  ApplyBodyWrench wrench_msg;
-  
-  tf::vector3TFToMsg(m_psuedo_force_mag * pushback_vec, 
-                     wrench_msg.request.wrench.force);
+void RegolithSpawner::clearAllPsuedoForces()
+{
+  queueRequest({Request::Type::CLEAR_FORCES, nullptr, 0, Vector3(0.0, 0.0, 0.0),
+                std::chrono::steady_clock::now()});
+}
 
-  wrench_msg.request.body_name         = body_name.str();
-  
-  // Choose a long ros duration (1 year), to delay the automatic disable of wrench force.
-  auto one_year_in_seconds = std::chrono::duration_cast<std::chrono::seconds>(1h*24*365).count();
-  wrench_msg.request.duration          = ros::Duration(one_year_in_seconds);
+void RegolithSpawner::removeAllRegolithModels()
+{
+  queueRequest({Request::Type::REMOVE_ALL, nullptr, 0, Vector3(0.0, 0.0, 0.0),
+                std::chrono::steady_clock::now()});
+}
 
-  wrench_msg.request.reference_point.x = 0.0;
-  wrench_msg.request.reference_point.y = 0.0;
-  wrench_msg.request.reference_point.z = 0.0;
+void RegolithSpawner::queueRequest(const Request &request)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_requests_mutex);
+    ++m_queued_count;
+    if (!m_requests.empty() && m_requests.back().type == request.type
+        && m_requests.back().tool == request.tool) {
+      // spawns in the same tool add up and use the latest force, a clear or
+      // remove that is already waiting covers this one as well
+      if (request.type == Request::Type::SPAWN) {
+        m_requests.back().count += request.count;
+        m_requests.back().pushback_force = request.pushback_force;
+      }
+      ++m_merged_count;
+      return;
+    }
+    m_requests.push_back(request);
+  }
+  m_requests_cv.notify_one();
+}
 
-  wrench_msg.request.wrench.torque.x   = 0.0;
-  wrench_msg.request.wrench.torque.y   = 0.0;
-  wrench_msg.request.wrench.torque.z   = 0.0;
+void RegolithSpawner::processRequests()
+{
+  std::unique_lock<std::mutex> lock(m_requests_mutex);
+  while (true) {
+    m_requests_cv.wait(lock, [this]() {
+      return m_stop_worker || !m_requests.empty();
+    });
+    if (m_stop_worker)
+      return;
+
+    auto request = m_requests.front();
+    m_requests.pop_front();
+    lock.unlock();
+
+    switch (request.type) {
+      case Request::Type::SPAWN:
+        if (!(m_use_world_plugin
+              ? spawnWithWorldPlugin(*request.tool, request.count,
+                                     request.pushback_force)
+              : spawnWithGazeboServices(*request.tool, request.count,
+                                        request.pushback_force)))
+          ROS_ERROR("Failed to spawn regolith in %s",
+                    request.tool->link_name.c_str());
+        break;
+      case Request::Type::CLEAR_FORCES:
+        if (!clearForces())
+          ROS_WARN("Failed to clear force on all regolith models");
+        // when the world plugin retires models on its own, there is no need
+        // to keep track of them once they are released
+        if (!m_remove_on_deliver)
+          m_active_models.clear();
+        break;
+      case Request::Type::REMOVE_ALL:
+        if (!removeModels())
+          ROS_WARN("Failed to delete all regolith models");
+        break;
+    }
 
-  m_active_models.push_back({model_name.str(), body_name.str()});
+    lock.lock();
+    publishQueueStats(std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - request.queued).count());
+  }
+}
 
-  return callRosService(m_gz_apply_wrench, wrench_msg);
+void RegolithSpawner::publishQueueStats(double latency)
+{
+  ++m_processed_count;
+  m_mean_latency += (latency - m_mean_latency) / m_processed_count;
+  m_max_latency = std::max(m_max_latency, latency);
+
+  RegolithQueueStats msg;
+  msg.stamp         = ros::Time::now();
+  msg.depth         = m_requests.size();
+  msg.queued        = m_queued_count;
+  msg.merged        = m_merged_count;
+  msg.processed     = m_processed_count;
+  msg.last_latency  = latency;
+  msg.mean_latency  = m_mean_latency;
+  msg.max_latency   = m_max_latency;
+  m_queue_stats_pub.publish(msg);
 }
 
+void RegolithSpawner::getSpawnPositions(const Tool &tool, int count,
+                                        std::vector<Vector3> &out_positions)
+{
+  // Models are laid out in square layers that are perpendicular to the spawn
+  // offset, which points along the Z axis of the tool. Layers are filled one
+  // after the other, starting at the spawn offset and moving further along it.
+  // Neighbors are a little more than one diameter apart, so models never
+  // overlap no matter how many are spawned at once.
+  constexpr auto CLEARANCE_FACTOR = 1.05;
+  auto spacing = 2.0 * m_model_radius * CLEARANCE_FACTOR;
+  auto per_row = std::max(1, static_cast<int>(tool.spawn_layer_width / spacing));
+  auto per_layer = per_row * per_row;
+  auto layer_step = tool.spawn_offset.normalized() * spacing;
+  auto center = (per_row - 1) / 2.0;
+
+  out_positions.clear();
+  for (auto i = 0; i < count; ++i) {
+    auto layer = i / per_layer;
+    auto row = (i % per_layer) / per_row;
+    auto column = i % per_row;
+    out_positions.push_back(tool.spawn_offset + layer_step * layer
+      + Vector3((column - center) * spacing, (row - center) * spacing, 0.0));
+  }
+}
 
-void RegolithSpawner::clearAllPsuedoForces()
+bool RegolithSpawner::spawnWithWorldPlugin(const Tool &tool, int count,
+                                           const Vector3 &pushback_force)
 {
+  SpawnRegolith msg;
+
+  msg.request.model_uri       = m_model_uri;
+  msg.request.reference_frame = tool.link_name;
+
+  std::vector<Vector3> positions;
+  getSpawnPositions(tool, count, positions);
+  for (auto &position : positions) {
+    msg.request.positions.emplace_back();
+    tf::pointTFToMsg(position, msg.request.positions.back());
+  }
+
+  tf::vector3TFToMsg(pushback_force, msg.request.pseudo_force);
+
+  if (!callRosService(m_spawn_regolith, msg) || !msg.response.success)
+    return false;
+
+  for (auto &link_name : msg.response.link_names)
+    m_active_models.push_back(
+      {link_name.substr(0, link_name.find("::")), link_name});
+
+  return true;
+}
+
+bool RegolithSpawner::spawnWithGazeboServices(const Tool &tool, int count,
+                                              const Vector3 &pushback_force)
+{
+  std::vector<Vector3> positions;
+  getSpawnPositions(tool, count, positions);
+
+  auto success = true;
+  for (auto &position : positions) {
+    // spawn model
+    stringstream model_name;
+    model_name << m_model_name_prefix << m_spawn_count++;
+
+    SpawnModel spawn_msg;
+
+    spawn_msg.request.model_name                  = model_name.str();
+    spawn_msg.request.model_xml                   = m_model_sdf;
+    spawn_msg.request.robot_namespace             = "/regolith";
+    spawn_msg.request.reference_frame             = tool.link_name;
+
+    spawn_msg.request.initial_pose.orientation.x  = 0.0;
+    spawn_msg.request.initial_pose.orientation.y  = 0.0;
+    spawn_msg.request.initial_pose.orientation.z  = 0.0;
+    spawn_msg.request.initial_pose.orientation.w  = 0.0;
+
+    spawn_msg.request.initial_pose.position.x     = position.getX();
+    spawn_msg.request.initial_pose.position.y     = position.getY();
+    spawn_msg.request.initial_pose.position.z     = position.getZ();
+
+    if (!callRosService(m_gz_spawn_model, spawn_msg)) {
+      success = false;
+      continue;
+    }
+
+    stringstream body_name;
+    body_name << model_name.str() << "::" << m_model_link_name;
+    m_active_models.push_back({model_name.str(), body_name.str()});
+
+    // if no pushback is desired, we're done
+    if (pushback_force.isZero())
+      continue;
+
+    // apply psuedo force to keep model in the scoop
+    ApplyBodyWrench wrench_msg;
+
+    tf::vector3TFToMsg(pushback_force, wrench_msg.request.wrench.force);
+
+    wrench_msg.request.body_name         = body_name.str();
+
+    // Choose a long ros duration (1 year), to delay the automatic disable of wrench force.
+    auto one_year_in_seconds = std::chrono::duration_cast<std::chrono::seconds>(1h*24*365).count();
+    wrench_msg.request.duration          = ros::Duration(one_year_in_seconds);
+
+    wrench_msg.request.reference_point.x = 0.0;
+    wrench_msg.request.reference_point.y = 0.0;
+    wrench_msg.request.reference_point.z = 0.0;
+
+    wrench_msg.request.wrench.torque.x   = 0.0;
+    wrench_msg.request.wrench.torque.y   = 0.0;
+    wrench_msg.request.wrench.torque.z   = 0.0;
+
+    if (!callRosService(m_gz_apply_wrench, wrench_msg))
+      success = false;
+  }
+  return success;
+}
+
+bool RegolithSpawner::clearForces()
+{
+  if (m_use_world_plugin) {
+    ClearRegolithForces msg;
+    for (auto &regolith : m_active_models)
+      msg.request.link_names.push_back(regolith.body_name);
+    return callRosService(m_clear_regolith_forces, msg) && msg.response.success;
+  }
+
+  auto success = true;
   BodyRequest msg;
   for (auto &regolith : m_active_models) {
     msg.request.body_name = regolith.body_name;
-    if (!callRosService(m_gz_clear_wrench, msg))
+    if (!callRosService(m_gz_clear_wrench, msg)) {
       ROS_WARN("Failed to clear force on %s", regolith.body_name.c_str());
+      success = false;
+    }
   }
+  return success;
 }
 
-void RegolithSpawner::removeAllRegolithModels()
+bool RegolithSpawner::removeModels()
 {
+  if (m_use_world_plugin) {
+    RemoveRegolith msg;
+    for (auto &regolith : m_active_models)
+      msg.request.link_names.push_back(regolith.body_name);
+    if (!callRosService(m_remove_regolith, msg))
+      return false;
+    // the plugin does not know of models that are listed as not removed, so
+    // there is nothing left to retry for them
+    for (auto &link_name : msg.response.not_removed)
+      ROS_WARN("Failed to delete model of %s", link_name.c_str());
+    m_active_models.clear();
+    return true;
+  }
+
+  auto success = true;
   auto it = m_active_models.begin();
   while (it != m_active_models.end()) {
     DeleteModel msg;
@@ -269,21 +650,20 @@ void RegolithSpawner::removeAllRegolithModels()
       it = m_active_models.erase(it);
     } else {
       ROS_WARN("Failed to delete model %s", it->model_name.c_str());
+      success = false;
       ++it;
     }
   }
+  return success;
 }
 
-void RegolithSpawner::onLinkStatesMsg(const LinkStates::ConstPtr &msg) 
+void RegolithSpawner::onToolPoseMsg(Tool *tool,
+                                    const geometry_msgs::PoseStamped::ConstPtr &msg)
 {
-  auto name_it = find(begin(msg->name), end(msg->name), m_scoop_link_name);
-  if (name_it == end(msg->name)) {
-    ROS_WARN("Failed to find %s in link states", m_scoop_link_name.c_str());      
-    return;
-  }
-
-  auto pose_it = begin(msg->pose) + distance(begin(msg->name), name_it);
-  tf::quaternionMsgToTF(pose_it->orientation, m_scoop_orientation);
+  std::lock_guard<std::mutex> lock(tool->mutex);
+  tf::pointMsgToTF(msg->pose.position, tool->position);
+  tf::quaternionMsgToTF(msg->pose.orientation, tool->orientation);
+  tool->has_pose = true;
 }
 
 void RegolithSpawner::onModDiffVisualMsg(const modified_terrain_diff::ConstPtr& msg)
@@ -307,30 +687,67 @@ void RegolithSpawner::onModDiffVisualMsg(const modified_terrain_diff::ConstPtr&
   auto pixel_area = (msg->height / rows) * (msg->width / cols);
 
   // estimate the total volume displaced using a Riemann sum over the image
+  auto volume_displaced = 0.0;
   for (auto y = 0; y < rows; ++y)
     for (auto x = 0; x < cols; ++x)
-      m_volume_displaced += -image_handle->image.at<float>(y, x) * pixel_area;
-
-  if (m_volume_displaced >= m_spawn_threshold) {
-    // deduct threshold from tracked volume
-    m_volume_displaced -= m_spawn_threshold;
-    // spawn a regolith model
-    if (!spawnRegolithInScoop(true))
-      ROS_ERROR("Failed to spawn regolith in scoop");
+      volume_displaced += -image_handle->image.at<float>(y, x) * pixel_area;
+
+  // attribute the modification to the nearest tool that is close enough to
+  // have made it
+  Tool *nearest = nullptr;
+  auto nearest_distance = std::numeric_limits<double>::max();
+  for (auto &tool : m_tools) {
+    std::lock_guard<std::mutex> lock(tool->mutex);
+    if (!tool->has_pose)
+      continue;
+    auto distance = std::hypot(tool->position.getX() - msg->position.x,
+                               tool->position.getY() - msg->position.y);
+    if (distance <= tool->attribution_radius && distance < nearest_distance) {
+      nearest = tool.get();
+      nearest_distance = distance;
+    }
+  }
+  if (!nearest) {
+    ROS_DEBUG("No regolith tool is near the terrain modification");
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(nearest->mutex);
+  nearest->volume_displaced += volume_displaced;
+  if (nearest->volume_displaced < nearest->spawn_threshold)
+    return;
+  // spawn every model owed at once, a fast dig may displace the volume of
+  // several in a single modification
+  auto count = nearest->spawn_threshold > 0.0
+    ? static_cast<int>(nearest->volume_displaced / nearest->spawn_threshold) : 1;
+  // deduct threshold from tracked volume for each model
+  nearest->volume_displaced -= count * nearest->spawn_threshold;
+  // the force is computed now, while the tool orientation is current
+  auto pushback_force = computePushbackForce(*nearest);
+  lock.unlock();
+
+  queueSpawn(*nearest, count, pushback_force);
+}
+
+void RegolithSpawner::resetVolumeDisplaced()
+{
+  // reset to avoid carrying over volume from one digging event to the next
+  for (auto &tool : m_tools) {
+    std::lock_guard<std::mutex> lock(tool->mutex);
+    tool->volume_displaced = 0.0;
   }
 }
 
 void RegolithSpawner::onDigLinearResultMsg(const DigLinearActionResult::ConstPtr &msg)
 {
   clearAllPsuedoForces();
-  // reset to avoid carrying over volume from one digging event to the next
-  m_volume_displaced = 0.0;
+  resetVolumeDisplaced();
 }
 
 void RegolithSpawner::onDigCircularResultMsg(const DigCircularActionResult::ConstPtr &msg)
 {
   clearAllPsuedoForces();
-  m_volume_displaced = 0.0;
+  resetVolumeDisplaced();
 }
 
 void RegolithSpawner::onDeliverResultMsg(const DeliverActionResult::ConstPtr &msg)
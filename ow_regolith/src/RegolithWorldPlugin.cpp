@@ -0,0 +1,680 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+#include "RegolithWorldPlugin.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <set>
+#include <sstream>
+
+#include "ow_dynamic_terrain/modify_terrain_circle.h"
+#include "ow_regolith/RegolithPoolStats.h"
+
+#include "sdf_utility.h"
+
+using namespace ow_regolith;
+using namespace gazebo;
+using namespace sdf_utility;
+
+using ignition::math::Pose3d;
+using ignition::math::Quaterniond;
+using ignition::math::Vector3d;
+
+using std::string;
+using std::stringstream;
+using std::make_unique;
+using std::remove_if;
+
+GZ_REGISTER_WORLD_PLUGIN(RegolithWorldPlugin)
+
+const static std::string PLUGIN_NAME = "RegolithWorldPlugin";
+
+// service paths advertised by the plugin
+const static std::string SRV_SPAWN_REGOLITH        = "/ow_regolith/spawn_regolith";
+const static std::string SRV_REMOVE_REGOLITH       = "/ow_regolith/remove_regolith";
+const static std::string SRV_CLEAR_REGOLITH_FORCES = "/ow_regolith/clear_regolith_forces";
+
+// topic paths used in class
+const static std::string TOPIC_POOL_STATS     = "/ow_regolith/regolith_pool_stats";
+const static std::string TOPIC_MODIFY_TERRAIN = "/ow_dynamic_terrain/modify_terrain_circle";
+
+// parked models are kept well below any terrain
+const static Pose3d DEFAULT_PARK_POSE(0.0, 0.0, -1000.0, 0.0, 0.0, 0.0);
+
+RegolithWorldPlugin::~RegolithWorldPlugin()
+{
+  m_update_connection.reset();
+  m_callback_queue.clear();
+  if (m_node_handle)
+    m_node_handle->shutdown();
+}
+
+void RegolithWorldPlugin::Load(physics::WorldPtr world, sdf::ElementPtr sdf)
+{
+  if (!ros::isInitialized()) {
+    gzerr << PLUGIN_NAME << ": ROS not initialized! The plugin won't load"
+          << std::endl;
+    return;
+  }
+
+  m_world = world;
+
+  m_park_pose = sdf->HasElement("park_pose")
+    ? sdf->Get<Pose3d>("park_pose") : DEFAULT_PARK_POSE;
+
+  m_node_handle = make_unique<ros::NodeHandle>(PLUGIN_NAME);
+  m_node_handle->setCallbackQueue(&m_callback_queue);
+
+  m_spawn_srv = m_node_handle->advertiseService(
+    SRV_SPAWN_REGOLITH, &RegolithWorldPlugin::onSpawnRegolith, this);
+  m_remove_srv = m_node_handle->advertiseService(
+    SRV_REMOVE_REGOLITH, &RegolithWorldPlugin::onRemoveRegolith, this);
+  m_clear_forces_srv = m_node_handle->advertiseService(
+    SRV_CLEAR_REGOLITH_FORCES, &RegolithWorldPlugin::onClearRegolithForces, this);
+  m_pool_stats_pub = m_node_handle->advertise<RegolithPoolStats>(
+    TOPIC_POOL_STATS, 1, true);
+
+  // consolidation of models that have settled outside of the scoop
+  if (sdf->HasElement("consolidation_rest_steps")) {
+    auto get_or = [&sdf](const char *name, auto default_value) {
+      return sdf->HasElement(name)
+        ? sdf->Get<decltype(default_value)>(name) : default_value;
+    };
+    m_consolidation_rest_count = sdf->Get<unsigned int>("consolidation_rest_steps");
+    m_rest_linear_velocity  = get_or("rest_linear_velocity", 0.005);
+    m_rest_angular_velocity = get_or("rest_angular_velocity", 0.05);
+    m_keep_out_entity       = get_or("keep_out_entity", string("lander::l_scoop_tip"));
+    m_keep_out_radius       = get_or("keep_out_radius", 0.2);
+    m_deposit_radius        = get_or("deposit_radius", 0.0);
+    m_deposit_volume        = get_or("deposit_volume", 0.0);
+    m_modify_terrain_pub = m_node_handle->advertise<
+      ow_dynamic_terrain::modify_terrain_circle>(TOPIC_MODIFY_TERRAIN, 10);
+  }
+
+  // policies that retire models based on where they are
+  if (sdf->HasElement("lifecycle_period")) {
+    m_lifecycle_period = sdf->Get<unsigned int>("lifecycle_period");
+    if (sdf->HasElement("workspace")) {
+      auto workspace = sdf->GetElement("workspace");
+      m_workspace_min = workspace->Get<Vector3d>("min");
+      m_workspace_max = workspace->Get<Vector3d>("max");
+      m_workspace_enabled = true;
+    }
+    if (sdf->HasElement("below_terrain_margin")) {
+      m_below_terrain_margin = sdf->Get<double>("below_terrain_margin");
+      m_below_terrain_enabled = true;
+    }
+    for (auto region = sdf->GetElementImpl("retirement_region"); region;
+         region = region->GetNextElement("retirement_region")) {
+      m_retirement_regions.push_back({
+        region->Get<string>("name"),
+        region->HasElement("frame") ? region->Get<string>("frame") : "",
+        region->Get<Vector3d>("min"), region->Get<Vector3d>("max")
+      });
+    }
+  }
+
+  // models spawned into the scoop are carried with it, rather than pushed
+  if (sdf->HasElement("carry_payload")) {
+    auto carry_payload = sdf->GetElement("carry_payload");
+    m_carry_enabled = true;
+    m_carry_up_axis = carry_payload->HasElement("up_axis")
+      ? carry_payload->Get<Vector3d>("up_axis").Normalize()
+      : Vector3d(0.0, 0.0, -1.0);
+    m_carry_release_angle = carry_payload->HasElement("release_angle")
+      ? carry_payload->Get<double>("release_angle") : 1.4;
+  }
+
+  // create the pool up front, so spawns are served by models that already
+  // exist in the world
+  if (sdf->HasElement("pool_model_uri") && sdf->HasElement("pool_size")) {
+    auto uri = sdf->Get<string>("pool_model_uri");
+    auto model_template = getModelTemplate(uri);
+    if (model_template) {
+      auto pool_size = sdf->Get<int>("pool_size");
+      for (auto i = 0; i < pool_size; ++i)
+        insertModel(uri, *model_template, m_park_pose, Vector3d::Zero, true);
+    }
+  }
+  publishPoolStats();
+
+  // requests are serviced on the world update thread, which makes it safe to
+  // touch the world from service callbacks
+  m_update_connection = event::Events::ConnectWorldUpdateBegin(
+    [this](const common::UpdateInfo &) { onUpdate(); });
+}
+
+void RegolithWorldPlugin::onUpdate()
+{
+  m_callback_queue.callAvailable();
+
+  // the world creates inserted models at the end of a step, so models can
+  // only be resolved during the following updates
+  auto parked_count = 0;
+  auto resolved = [this, &parked_count](PendingModel &pending) {
+    auto &regolith = pending.regolith;
+    regolith.model = m_world->ModelByName(regolith.model_name);
+    if (!regolith.model)
+      return false;
+    regolith.link = regolith.model->GetLink(pending.link_name);
+    if (!regolith.link) {
+      gzerr << PLUGIN_NAME << ": model " << regolith.model_name
+            << " has no link " << pending.link_name << std::endl;
+      // the model can never be used, so stop tracking it
+      auto it = m_regolith.find(pending.link_name);
+      if (!pending.park && it != m_regolith.end()) {
+        dropFromPayload(it->second);
+        m_regolith.erase(it);
+      }
+      return true;
+    }
+    if (pending.park) {
+      park(regolith);
+      m_parked[regolith.uri].push_back(regolith);
+      ++parked_count;
+    } else {
+      // keep the pseudo force, it may have been cleared in the meantime
+      auto &active = m_regolith.at(pending.link_name);
+      active.model = regolith.model;
+      active.link = regolith.link;
+      // the payload already tracks the model, it only has to stop simulating
+      if (active.carried) {
+        active.link->SetCollideMode("none");
+        active.link->SetGravityMode(false);
+        active.link->SetEnabled(false);
+      }
+    }
+    return true;
+  };
+  m_pending.erase(remove_if(m_pending.begin(), m_pending.end(), resolved),
+                  m_pending.end());
+  if (parked_count > 0)
+    publishPoolStats();
+
+  if (!m_payloads.empty())
+    updatePayloads();
+
+  // force accumulators are reset every step, so the force is reapplied
+  for (auto &entry : m_regolith) {
+    auto &regolith = entry.second;
+    if (regolith.link && !regolith.carried &&
+        regolith.pseudo_force != Vector3d::Zero)
+      regolith.link->AddForce(regolith.pseudo_force);
+  }
+
+  if (m_consolidation_rest_count > 0)
+    consolidateSettledModels();
+
+  if (m_lifecycle_period > 0 && ++m_lifecycle_counter >= m_lifecycle_period) {
+    m_lifecycle_counter = 0;
+    applyLifecyclePolicies();
+  }
+}
+
+void RegolithWorldPlugin::applyLifecyclePolicies()
+{
+  std::set<string> retiring;
+
+  // regions whose frame does not exist are skipped
+  std::vector<const RetirementRegion *> regions;
+  std::vector<Pose3d> region_poses;
+  for (const auto &region : m_retirement_regions) {
+    auto frame_pose = Pose3d::Zero;
+    if (!region.frame.empty()) {
+      auto frame = m_world->EntityByName(region.frame);
+      if (!frame)
+        continue;
+      frame_pose = frame->WorldPose();
+    }
+    regions.push_back(&region);
+    region_poses.push_back(frame_pose);
+  }
+
+  for (const auto &entry : m_regolith) {
+    if (!entry.second.link)
+      continue;
+    auto position = entry.second.link->WorldPose().Pos();
+
+    // models that left the workspace have been flung away or fell through
+    // the terrain and will not come back on their own
+    if (m_workspace_enabled &&
+        (position.X() < m_workspace_min.X() || position.X() > m_workspace_max.X() ||
+         position.Y() < m_workspace_min.Y() || position.Y() > m_workspace_max.Y() ||
+         position.Z() < m_workspace_min.Z() || position.Z() > m_workspace_max.Z()))
+      retiring.insert(entry.first);
+
+    // carried models go wherever the scoop goes, which includes into the
+    // terrain while digging
+    double terrain_height;
+    if (m_below_terrain_enabled && !entry.second.carried &&
+        getTerrainHeight(position.X(), position.Y(), terrain_height) &&
+        position.Z() < terrain_height - m_below_terrain_margin)
+      retiring.insert(entry.first);
+
+    for (size_t i = 0; i < regions.size(); ++i) {
+      const auto &region = *regions[i];
+      auto local = region_poses[i].Rot().RotateVectorReverse(
+        position - region_poses[i].Pos());
+      if (local.X() >= region.min.X() && local.X() <= region.max.X() &&
+          local.Y() >= region.min.Y() && local.Y() <= region.max.Y() &&
+          local.Z() >= region.min.Z() && local.Z() <= region.max.Z())
+        retiring.insert(entry.first);
+    }
+  }
+
+  if (retiring.empty())
+    return;
+
+  for (const auto &name : retiring)
+    retire(m_regolith.find(name));
+  m_retired += retiring.size();
+  publishPoolStats();
+}
+
+bool RegolithWorldPlugin::getTerrainHeight(double x, double y,
+                                           double &out_height)
+{
+  if (!m_heightmap_shape) {
+    for (const auto &model : m_world->Models())
+      for (const auto &link : model->GetLinks())
+        for (const auto &collision : link->GetCollisions()) {
+          auto shape = boost::dynamic_pointer_cast<physics::HeightmapShape>(
+            collision->GetShape());
+          if (shape) {
+            m_heightmap_shape = shape;
+            m_heightmap_collision = collision;
+          }
+        }
+    if (!m_heightmap_shape)
+      return false;
+  }
+
+  // heightmap rows run from the far to the near edge along the Y axis
+  auto origin = m_heightmap_collision->WorldPose().Pos()
+    + m_heightmap_shape->Pos();
+  auto size = m_heightmap_shape->Size();
+  auto count = m_heightmap_shape->VertexCount();
+  auto column = std::lround((x - origin.X() + size.X() / 2.0) / size.X()
+                            * (count.X() - 1));
+  auto row = std::lround((origin.Y() + size.Y() / 2.0 - y) / size.Y()
+                         * (count.Y() - 1));
+  if (column < 0 || column >= count.X() || row < 0 || row >= count.Y())
+    return false;
+
+  out_height = m_heightmap_shape->GetHeight(column, row) + origin.Z();
+  return true;
+}
+
+void RegolithWorldPlugin::consolidateSettledModels()
+{
+  auto keep_out = m_world->EntityByName(m_keep_out_entity);
+  auto consolidated_count = 0;
+
+  auto it = m_regolith.begin();
+  while (it != m_regolith.end()) {
+    auto &regolith = it->second;
+    // models that are still being pushed or carried are in the scoop by
+    // definition
+    if (!regolith.link || regolith.carried ||
+        regolith.pseudo_force != Vector3d::Zero) {
+      ++it;
+      continue;
+    }
+
+    auto at_rest =
+      regolith.link->WorldLinearVel().Length() < m_rest_linear_velocity &&
+      regolith.link->WorldAngularVel().Length() < m_rest_angular_velocity;
+    regolith.rest_count = at_rest ? regolith.rest_count + 1 : 0;
+
+    auto position = regolith.link->WorldPose().Pos();
+    if (regolith.rest_count < m_consolidation_rest_count ||
+        (keep_out && position.Distance(keep_out->WorldPose().Pos())
+                       < m_keep_out_radius)) {
+      ++it;
+      continue;
+    }
+
+    // a hard edged disc added to the terrain that holds the volume of the model
+    const auto &model_template = m_templates.at(regolith.uri);
+    auto radius = m_deposit_radius > 0.0
+      ? m_deposit_radius : 2.0 * model_template.radius;
+    auto volume = m_deposit_volume > 0.0 ? m_deposit_volume
+      : 4.0 / 3.0 * IGN_PI * std::pow(model_template.radius, 3);
+
+    ow_dynamic_terrain::modify_terrain_circle msg;
+    msg.position.x   = position.X();
+    msg.position.y   = position.Y();
+    msg.position.z   = 0.0;
+    msg.outer_radius = radius;
+    msg.inner_radius = radius;
+    msg.weight       = volume / (IGN_PI * radius * radius);
+    msg.merge_method = "add";
+    msg.falloff      = "hard";
+    m_modify_terrain_pub.publish(msg);
+
+    it = retire(it);
+    ++consolidated_count;
+  }
+
+  if (consolidated_count > 0) {
+    m_consolidated += consolidated_count;
+    publishPoolStats();
+  }
+}
+
+bool RegolithWorldPlugin::onSpawnRegolith(SpawnRegolith::Request &request,
+                                          SpawnRegolith::Response &response)
+{
+  auto start = std::chrono::steady_clock::now();
+
+  response.success = false;
+
+  auto model_template = getModelTemplate(request.model_uri, request.model_xml);
+  if (!model_template)
+    return true;
+
+  auto frame_pose = Pose3d::Zero;
+  physics::EntityPtr frame;
+  if (!request.reference_frame.empty() && request.reference_frame != "world") {
+    frame = m_world->EntityByName(request.reference_frame);
+    if (!frame) {
+      gzerr << PLUGIN_NAME << ": reference frame " << request.reference_frame
+            << " does not exist" << std::endl;
+      return true;
+    }
+    frame_pose = frame->WorldPose();
+  }
+
+  Vector3d pseudo_force(request.pseudo_force.x, request.pseudo_force.y,
+                        request.pseudo_force.z);
+
+  // models that would be pushed into a link are carried by it instead
+  physics::LinkPtr carrier;
+  if (m_carry_enabled && pseudo_force != Vector3d::Zero)
+    carrier = boost::dynamic_pointer_cast<physics::Link>(frame);
+
+  auto &parked = m_parked[request.model_uri];
+  for (const auto &position : request.positions) {
+    Pose3d pose(frame_pose.Pos() + frame_pose.Rot().RotateVector(
+                  Vector3d(position.x, position.y, position.z)),
+                Quaterniond::Identity);
+
+    if (parked.empty()) {
+      auto link_name = insertModel(request.model_uri, *model_template, pose,
+                                   pseudo_force, false);
+      if (carrier)
+        carry(m_regolith.at(link_name), carrier, pose - frame_pose);
+      response.link_names.push_back(link_name);
+      ++m_created;
+      continue;
+    }
+
+    auto regolith = parked.back();
+    parked.pop_back();
+    auto link_name = regolith.link->GetScopedName();
+    if (carrier) {
+      // a carried model is never simulated, so it stays parked and only moves
+      regolith.model->SetWorldPose(pose);
+      regolith.pseudo_force = pseudo_force;
+      carry(m_regolith[link_name] = regolith, carrier, pose - frame_pose);
+    } else {
+      unpark(regolith, pose);
+      regolith.pseudo_force = pseudo_force;
+      m_regolith[link_name] = regolith;
+    }
+    response.link_names.push_back(link_name);
+    ++m_reused;
+  }
+
+  m_high_water_mark = std::max(m_high_water_mark,
+                               static_cast<unsigned int>(m_regolith.size()));
+  m_last_spawn_duration = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  publishPoolStats();
+
+  response.success = true;
+  return true;
+}
+
+bool RegolithWorldPlugin::onRemoveRegolith(RemoveRegolith::Request &request,
+                                           RemoveRegolith::Response &response)
+{
+  for (const auto &link_name : request.link_names) {
+    auto it = m_regolith.find(link_name);
+    if (it == m_regolith.end()) {
+      // models that were consolidated are already out of the world
+      if (!isParked(link_name))
+        response.not_removed.push_back(link_name);
+      continue;
+    }
+    if (!it->second.link) {
+      // park it as soon as the world creates it
+      for (auto &pending : m_pending)
+        if (pending.link_name == link_name)
+          pending.park = true;
+      dropFromPayload(it->second);
+      m_regolith.erase(it);
+      continue;
+    }
+    retire(it);
+  }
+  publishPoolStats();
+
+  response.success = response.not_removed.empty();
+  return true;
+}
+
+bool RegolithWorldPlugin::onClearRegolithForces(
+  ClearRegolithForces::Request &request,
+  ClearRegolithForces::Response &response)
+{
+  response.success = true;
+  for (const auto &link_name : request.link_names) {
+    auto it = m_regolith.find(link_name);
+    if (it == m_regolith.end()) {
+      if (isParked(link_name))
+        continue;
+      gzwarn << PLUGIN_NAME << ": " << link_name
+             << " is not a regolith link" << std::endl;
+      response.success = false;
+      continue;
+    }
+    it->second.pseudo_force = Vector3d::Zero;
+  }
+  return true;
+}
+
+const RegolithWorldPlugin::ModelTemplate *
+RegolithWorldPlugin::getModelTemplate(const string &uri,
+                                      const string &model_xml)
+{
+  auto it = m_templates.find(uri);
+  if (it != m_templates.end())
+    return &it->second;
+
+  auto sdf_text = model_xml;
+  if (sdf_text.empty() && !getSdfFromUri(uri, sdf_text)) {
+    gzerr << PLUGIN_NAME << ": failed to load SDF for " << uri << std::endl;
+    return nullptr;
+  }
+
+  ModelTemplate model_template;
+  model_template.sdf = parseSdf(sdf_text);
+  if (!getModelLinkName(model_template.sdf, model_template.link_name) ||
+      !getModelLinkRadius(model_template.sdf, model_template.radius)) {
+    gzerr << PLUGIN_NAME << ": " << uri << " is not a valid regolith model"
+          << std::endl;
+    return nullptr;
+  }
+  // the model pose is replaced for every copy, so make sure there is one
+  model_template.sdf->Root()->GetElement("model")->GetElement("pose");
+
+  return &(m_templates[uri] = model_template);
+}
+
+string RegolithWorldPlugin::insertModel(const string &uri,
+                                        const ModelTemplate &model_template,
+                                        const Pose3d &pose,
+                                        const Vector3d &pseudo_force,
+                                        bool park)
+{
+  stringstream model_name;
+  model_name << "regolith_" << m_spawn_count++;
+
+  // only the name and pose differ between copies of the template
+  sdf::SDF model_sdf;
+  model_sdf.Root(model_template.sdf->Root()->Clone());
+  auto model = model_sdf.Root()->GetElement("model");
+  model->GetAttribute("name")->Set(model_name.str());
+  model->GetElement("pose")->Set(pose);
+  m_world->InsertModelSDF(model_sdf);
+
+  auto link_name = model_name.str() + "::" + model_template.link_name;
+  Regolith regolith{uri, model_name.str(), nullptr, nullptr, pseudo_force, 0,
+                    false};
+  if (!park)
+    m_regolith[link_name] = regolith;
+  m_pending.push_back({link_name, regolith, park});
+  return link_name;
+}
+
+std::map<string, RegolithWorldPlugin::Regolith>::iterator
+RegolithWorldPlugin::retire(std::map<string, Regolith>::iterator it)
+{
+  auto &regolith = it->second;
+  regolith.rest_count = 0;
+  dropFromPayload(regolith);
+  park(regolith);
+  m_parked[regolith.uri].push_back(regolith);
+  return m_regolith.erase(it);
+}
+
+void RegolithWorldPlugin::park(const Regolith &regolith)
+{
+  regolith.link->SetCollideMode("none");
+  regolith.link->SetGravityMode(false);
+  regolith.model->SetWorldPose(m_park_pose);
+  regolith.model->ResetPhysicsStates();
+  regolith.link->SetEnabled(false);
+}
+
+void RegolithWorldPlugin::unpark(const Regolith &regolith, const Pose3d &pose)
+{
+  regolith.model->SetWorldPose(pose);
+  regolith.model->ResetPhysicsStates();
+  regolith.link->SetCollideMode("all");
+  regolith.link->SetGravityMode(true);
+  regolith.link->SetEnabled(true);
+}
+
+void RegolithWorldPlugin::carry(Regolith &regolith,
+                                const physics::LinkPtr &carrier,
+                                const Pose3d &offset)
+{
+  auto &payload = m_payloads[carrier->GetScopedName()];
+  payload.carrier = carrier;
+  payload.members.push_back(&regolith);
+  payload.offsets.push_back(offset);
+  regolith.carried = true;
+  // models the world has yet to create stop simulating once they are resolved
+  if (regolith.link) {
+    regolith.link->SetCollideMode("none");
+    regolith.link->SetGravityMode(false);
+    regolith.model->ResetPhysicsStates();
+    regolith.link->SetEnabled(false);
+  }
+}
+
+void RegolithWorldPlugin::updatePayloads()
+{
+  auto released_count = 0;
+
+  auto it = m_payloads.begin();
+  while (it != m_payloads.end()) {
+    auto &payload = it->second;
+    auto carrier_pose = payload.carrier->WorldPose();
+
+    auto up = carrier_pose.Rot().RotateVector(m_carry_up_axis);
+    auto tilt = std::acos(ignition::math::clamp(up.Z(), -1.0, 1.0));
+    if (tilt <= m_carry_release_angle) {
+      for (size_t i = 0; i < payload.members.size(); ++i)
+        if (payload.members[i]->model)
+          payload.members[i]->model->SetWorldPose(
+            payload.offsets[i] + carrier_pose);
+      ++it;
+      continue;
+    }
+
+    // pour out the payload, every model leaves with the velocity the carrier
+    // has where the model was carried
+    for (size_t i = 0; i < payload.members.size(); ++i) {
+      auto &regolith = *payload.members[i];
+      regolith.carried = false;
+      if (!regolith.model)
+        continue;
+      unpark(regolith, payload.offsets[i] + carrier_pose);
+      regolith.link->SetLinearVel(
+        payload.carrier->WorldLinearVel(payload.offsets[i].Pos()));
+    }
+    released_count += payload.members.size();
+    it = m_payloads.erase(it);
+  }
+
+  if (released_count > 0) {
+    m_released += released_count;
+    publishPoolStats();
+  }
+}
+
+void RegolithWorldPlugin::dropFromPayload(Regolith &regolith)
+{
+  if (!regolith.carried)
+    return;
+  regolith.carried = false;
+  for (auto it = m_payloads.begin(); it != m_payloads.end(); ++it) {
+    auto &members = it->second.members;
+    auto member = std::find(members.begin(), members.end(), &regolith);
+    if (member == members.end())
+      continue;
+    auto index = member - members.begin();
+    members.erase(member);
+    it->second.offsets.erase(it->second.offsets.begin() + index);
+    if (members.empty())
+      m_payloads.erase(it);
+    return;
+  }
+}
+
+bool RegolithWorldPlugin::isParked(const string &link_name) const
+{
+  for (const auto &entry : m_parked)
+    for (const auto &regolith : entry.second)
+      if (regolith.link && regolith.link->GetScopedName() == link_name)
+        return true;
+  return false;
+}
+
+void RegolithWorldPlugin::publishPoolStats()
+{
+  RegolithPoolStats msg;
+  msg.stamp               = ros::Time::now();
+  msg.models              = m_spawn_count;
+  msg.active              = m_regolith.size();
+  msg.parked              = 0;
+  for (const auto &entry : m_parked)
+    msg.parked += entry.second.size();
+  msg.high_water_mark     = m_high_water_mark;
+  msg.reused              = m_reused;
+  msg.created             = m_created;
+  msg.consolidated        = m_consolidated;
+  msg.retired             = m_retired;
+  msg.carried             = 0;
+  for (const auto &entry : m_payloads)
+    msg.carried += entry.second.members.size();
+  msg.released            = m_released;
+  msg.last_spawn_duration = m_last_spawn_duration;
+  m_pool_stats_pub.publish(msg);
+}
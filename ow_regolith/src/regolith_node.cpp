@@ -23,7 +23,9 @@ int main(int argc, char* argv[])
     return 1;
   }
 
-  ros::spin();
+  // callbacks of different tools may run concurrently
+  ros::MultiThreadedSpinner spinner;
+  spinner.spin();
 
   return 0;
 }
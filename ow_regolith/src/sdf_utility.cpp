@@ -96,3 +96,30 @@ bool sdf_utility::getModelLinkMass(const SDFPtr &sdf, float &out_mass)
   out_mass = link_mass;
   return true;
 }
+
+bool sdf_utility::getModelLinkRadius(const SDFPtr &sdf, float &out_radius)
+{
+  ElementPtr link;
+  if (!getModelLink(sdf, link))
+    return false;
+  auto collision = link->GetElementImpl("collision");
+  if (!collision) {
+    ROS_ERROR("Unable to acquire collision element from SDF");
+    return false;
+  }
+  auto geometry = collision->GetElementImpl("geometry");
+  if (!geometry) {
+    ROS_ERROR("Unable to acquire geometry element from SDF");
+    return false;
+  }
+  if (auto sphere = geometry->GetElementImpl("sphere")) {
+    out_radius = sphere->Get<double>("radius");
+    return true;
+  }
+  if (auto box = geometry->GetElementImpl("box")) {
+    out_radius = box->Get<ignition::math::Vector3d>("size").Length() / 2.0;
+    return true;
+  }
+  ROS_ERROR("Collision geometry of link is neither a sphere nor a box");
+  return false;
+}
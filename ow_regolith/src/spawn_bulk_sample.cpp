@@ -0,0 +1,272 @@
+// The Notices and Disclaimers for Ocean Worlds Autonomy Testbed for Exploration
+// Research and Simulation can be found in README.md in the root directory of
+// this repository.
+
+// Spawns a bulk sample of regolith into the scoop in a single request to
+// RegolithWorldPlugin, or one model at a time through Gazebo's services if the
+// world does not load it. See USAGE below.
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+#include <ros/ros.h>
+#include <tf/tf.h>
+#include <gazebo_msgs/SpawnModel.h>
+
+#include "ow_regolith/SpawnRegolith.h"
+
+#include "sdf_utility.h"
+
+using namespace ow_regolith;
+using namespace sdf_utility;
+
+using tf::Vector3;
+
+using std::string;
+using std::vector;
+
+const static string USAGE = R"(rosrun ow_regolith spawn_bulk_sample RSDF_FILE DIAMETER TOTAL_MASS [OPTIONS]
+    Generates an SDF model from RSDF_FILE and spawns some number of copies of
+    it into the Gazebo sim just above the scoop's opening, all at once. The
+    number of models spawned will have a mass that sums to as near to the
+    TOTAL_MASS as possible. The provided RSDF_FILE should be in the Embedded
+    Ruby format, and should accept a diameter argument, which is assigned the
+    value of DIAMETER. The bulk material properties of the model should be
+    specified in the RSDF_FILE.
+
+    If the world loads the RegolithWorldPlugin (libow_regolith_world.so), all
+    models are spawned in a single request to it. Otherwise they are spawned
+    one at a time through Gazebo's services, which takes much longer.
+
+    RSDF_FILE   An Embedded Ruby SDF file that accepts a diameter argument.
+    DIAMETER    The diameter of the resulting the SDF model. If RDSF_FILE
+                specifies a shape besides a sphere, this can tought of as an
+                approximate model size.
+    TOTAL_MASS  The target total mass of all models that will be spawned.
+
+    -t, --test      Calculate and print relevant values, but stop short of
+                    spawning models into the Gazebo.
+    -s, --settled   Close pack the models so they are spawned already resting
+                    on each other, instead of in a loose grid they fall from.
+    -w, --width W   Width in meters of the square layers models are laid out
+                    in (default 0.05).)";
+
+const static string SRV_SPAWN_REGOLITH    = "/ow_regolith/spawn_regolith";
+const static string SRV_SPAWN_MODEL       = "/gazebo/spawn_sdf_model";
+const static string SPAWN_REFERENCE_FRAME = "lander::l_scoop_tip";
+const static Vector3 SPAWN_OFFSET(0.0, 0.0, -0.05);
+
+// renders an Embedded Ruby SDF file with the erb command
+static bool renderRsdf(const string &rsdf_file, double diameter,
+                       string &out_sdf_text)
+{
+  auto command = "erb diameter=" + std::to_string(diameter)
+    + " '" + rsdf_file + "'";
+  auto pipe = popen(command.c_str(), "r");
+  if (!pipe)
+    return false;
+  char buffer[4096];
+  size_t read_count;
+  out_sdf_text.clear();
+  while ((read_count = fread(buffer, 1, sizeof(buffer), pipe)) > 0)
+    out_sdf_text.append(buffer, read_count);
+  return pclose(pipe) == 0 && !out_sdf_text.empty();
+}
+
+// The plugin caches the parsed model by its URI, so the URI must identify the
+// file, the size, and the version of the file the model was rendered from
+static string getTemplateUri(const string &rsdf_file, double diameter)
+{
+  char path[PATH_MAX];
+  string uri = realpath(rsdf_file.c_str(), path) ? path : rsdf_file;
+  uri += "?diameter=" + std::to_string(diameter);
+  struct stat status;
+  if (stat(rsdf_file.c_str(), &status) == 0)
+    uri += "&mtime=" + std::to_string(status.st_mtim.tv_sec) + "."
+      + std::to_string(status.st_mtim.tv_nsec);
+  return uri;
+}
+
+// spawns the models one at a time through gazebo_ros, for worlds that do not
+// load RegolithWorldPlugin
+static bool spawnWithGazeboServices(ros::NodeHandle &nh,
+                                    const string &sdf_text,
+                                    const vector<Vector3> &positions)
+{
+  auto spawn_model = nh.serviceClient<gazebo_msgs::SpawnModel>(SRV_SPAWN_MODEL);
+  auto name_prefix = "bulk_sample_"
+    + std::to_string(ros::WallTime::now().toNSec() / 1000000) + "_";
+  gazebo_msgs::SpawnModel msg;
+  msg.request.model_xml       = sdf_text;
+  msg.request.robot_namespace = "/regolith";
+  msg.request.reference_frame = SPAWN_REFERENCE_FRAME;
+  tf::quaternionTFToMsg(tf::Quaternion::getIdentity(),
+                        msg.request.initial_pose.orientation);
+  for (size_t i = 0; i < positions.size(); ++i) {
+    msg.request.model_name = name_prefix + std::to_string(i);
+    tf::pointTFToMsg(positions[i], msg.request.initial_pose.position);
+    if (!spawn_model.call(msg) || !msg.response.success) {
+      ROS_ERROR("Failed to spawn model %zu of the bulk sample", i);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Positions of count models relative to the scoop. Models are laid out in
+// square layers that are perpendicular to the spawn offset, the first layer at
+// the offset and every following one further along it. Loose layers are simple
+// square grids with some room between neighbors. Settled layers are hexagonal
+// close packed, each sitting in the hollows of the one below, so that the
+// models are at rest against each other.
+static void getBulkPositions(int count, double diameter, double width,
+                             bool settled, vector<Vector3> &out_positions)
+{
+  constexpr auto LOOSE_CLEARANCE_FACTOR   = 1.05;
+  // just enough room that the contact solver does not push neighbors apart
+  constexpr auto SETTLED_CLEARANCE_FACTOR = 1.005;
+
+  auto spacing = diameter
+    * (settled ? SETTLED_CLEARANCE_FACTOR : LOOSE_CLEARANCE_FACTOR);
+  auto row_step   = settled ? spacing * std::sqrt(3.0) / 2.0 : spacing;
+  auto layer_step = settled ? spacing * std::sqrt(2.0 / 3.0) : spacing;
+
+  // odd rows and odd layers of a close packing are shifted, leave room for it
+  auto shift = settled ? spacing / 2.0 : 0.0;
+  auto per_row = std::max(1, static_cast<int>((width - shift) / spacing));
+  auto rows    = std::max(1, static_cast<int>((width - shift) / row_step));
+  auto per_layer = per_row * rows;
+  auto direction = SPAWN_OFFSET.normalized();
+  auto center_x = (per_row - 1) * spacing / 2.0;
+  auto center_y = (rows - 1) * row_step / 2.0;
+
+  out_positions.clear();
+  for (auto i = 0; i < count; ++i) {
+    auto layer  = i / per_layer;
+    auto row    = (i % per_layer) / per_row;
+    auto column = i % per_row;
+    auto x = column * spacing - center_x;
+    auto y = row * row_step - center_y;
+    if (settled) {
+      // the shift of odd layers is equivalent to flipping which rows are shifted
+      x += ((row + layer) % 2) * spacing / 2.0;
+      y += (layer % 2) * row_step / 3.0;
+    }
+    out_positions.push_back(SPAWN_OFFSET + direction * (layer * layer_step)
+                            + Vector3(x, y, 0.0));
+  }
+}
+
+int main(int argc, char* argv[])
+{
+  ros::init(argc, argv, "spawn_bulk_sample", ros::init_options::AnonymousName);
+
+  auto test = false;
+  auto settled = false;
+  auto width = 0.05;
+  vector<string> arguments;
+  for (auto i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg == "-t" || arg == "--test") {
+      test = true;
+    } else if (arg == "-s" || arg == "--settled") {
+      settled = true;
+    } else if ((arg == "-w" || arg == "--width") && i + 1 < argc) {
+      width = std::atof(argv[++i]);
+    } else {
+      arguments.push_back(arg);
+    }
+  }
+  if (arguments.size() != 3) {
+    std::cerr << "Incorrect number of arguments!" << std::endl
+              << USAGE << std::endl;
+    return 1;
+  }
+
+  auto rsdf_file   = arguments[0];
+  auto diameter    = std::atof(arguments[1].c_str());
+  auto target_mass = std::atof(arguments[2].c_str());
+  if (diameter <= 0.0 || target_mass <= 0.0 || width <= 0.0) {
+    std::cerr << "DIAMETER, TOTAL_MASS and width must be positive" << std::endl;
+    return 1;
+  }
+
+  string sdf_text;
+  if (!renderRsdf(rsdf_file, diameter, sdf_text)) {
+    std::cerr << "Failed to render " << rsdf_file << " with erb" << std::endl;
+    return 1;
+  }
+  float mass_per_model;
+  if (!getModelLinkMass(parseSdf(sdf_text), mass_per_model)
+      || mass_per_model <= 0.0f) {
+    std::cerr << "Failed to acquire the mass of the generated model"
+              << std::endl;
+    return 1;
+  }
+
+  auto spawn_count = static_cast<int>(std::lround(target_mass / mass_per_model));
+  auto actual_mass = spawn_count * mass_per_model;
+
+  vector<Vector3> positions;
+  getBulkPositions(spawn_count, diameter, width, settled, positions);
+
+  printf("Bulk material properties specified from ................. %s\n", rsdf_file.c_str());
+  printf("Target mass is .......................................... %f kg\n", target_mass);
+  printf("Model diameter (size) is ................................ %f m\n", diameter);
+  printf("Mass per model is ....................................... %f kg\n", mass_per_model);
+  printf("Total models that will spawn is ......................... %d\n", spawn_count);
+  printf("Totaling to a mass of ................................... %f kg\n", actual_mass);
+  printf("This total mass value differs from the target mass by ... %f kg\n", actual_mass - target_mass);
+  if (!positions.empty())
+    printf("Height of the sample above the spawn offset is .......... %f m\n",
+           (positions.back() - SPAWN_OFFSET).dot(SPAWN_OFFSET.normalized()));
+
+  if (test) {
+    printf("This is just a test. Skipping spawn step.\n");
+    return 0;
+  }
+
+  ros::NodeHandle nh;
+  // the world is loaded by the time Gazebo's services are up, so if the
+  // regolith plugin is part of it, its service exists as well
+  if (!ros::service::waitForService(SRV_SPAWN_MODEL, ros::Duration(5.0))) {
+    ROS_ERROR("Timed out waiting for service %s to advertise, is Gazebo "
+              "running?", SRV_SPAWN_MODEL.c_str());
+    return 1;
+  }
+  if (!ros::service::exists(SRV_SPAWN_REGOLITH, false)) {
+    ROS_WARN("World does not load RegolithWorldPlugin, models will be "
+             "spawned one at a time through Gazebo's services");
+    printf("Spawning models into Gazebo world one at a time...\n");
+    if (!spawnWithGazeboServices(nh, sdf_text, positions))
+      return 1;
+    printf("All %zu models have been spawned\n", positions.size());
+    return 0;
+  }
+  auto spawn_regolith = nh.serviceClient<SpawnRegolith>(SRV_SPAWN_REGOLITH);
+
+  SpawnRegolith msg;
+  msg.request.model_uri       = getTemplateUri(rsdf_file, diameter);
+  msg.request.model_xml       = sdf_text;
+  msg.request.reference_frame = SPAWN_REFERENCE_FRAME;
+  for (auto &position : positions) {
+    msg.request.positions.emplace_back();
+    tf::pointTFToMsg(position, msg.request.positions.back());
+  }
+
+  printf("Spawning models into Gazebo world...\n");
+  if (!spawn_regolith.call(msg) || !msg.response.success) {
+    ROS_ERROR("Failed to spawn the bulk sample");
+    return 1;
+  }
+  printf("All %zu models have been spawned\n", msg.response.link_names.size());
+
+  return 0;
+}